@@ -0,0 +1,187 @@
+#include "BakedHeightField.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cfloat>
+
+BakedHeightField::BakedHeightField()
+{
+}
+
+void BakedHeightField::Clear()
+{
+    grid.Clear();
+}
+
+bool BakedHeightField::Bake(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& vertexNormals,
+    const std::vector<unsigned int>& indices, int columns, int rows)
+{
+    if (columns < 2 || rows < 2)
+    {
+        std::cerr << "Error: A baked height field needs at least 2 x 2 samples" << std::endl;
+        return false;
+    }
+    if (indices.size() < 3 || vertexNormals.size() != vertices.size())
+    {
+        std::cerr << "Error: No triangulation to bake" << std::endl;
+        return false;
+    }
+
+    glm::vec2 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+    for (const glm::vec3& vertex : vertices)
+    {
+        boundsMin = glm::min(boundsMin, glm::vec2(vertex.x, vertex.z));
+        boundsMax = glm::max(boundsMax, glm::vec2(vertex.x, vertex.z));
+    }
+    glm::vec2 extent = boundsMax - boundsMin;
+    if (!(extent.x > 0.0f && extent.y > 0.0f))
+    {
+        std::cerr << "Error: The triangulation must span an area in x and z to be baked" << std::endl;
+        return false;
+    }
+
+    grid.Reset(boundsMin, extent / glm::vec2(static_cast<float>(columns - 1), static_cast<float>(rows - 1)), columns, rows, CHANNEL_COUNT);
+    glm::vec2 origin = grid.GetOrigin();
+    glm::vec2 spacing = grid.GetSpacing();
+    std::vector<float>& heights = grid.Channel(HEIGHT);
+    std::vector<float>& normalX = grid.Channel(NORMAL_X);
+    std::vector<float>& normalY = grid.Channel(NORMAL_Y);
+    std::vector<float>& normalZ = grid.Channel(NORMAL_Z);
+
+    // Hver trd gr gjennom alle trekantene, men skriver bare radene i sin egen stripe
+    size_t triangleCount = indices.size() / 3;
+    parallelFor(rows, threadCount(), [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t n = 0; n < triangleCount; ++n)
+        {
+            unsigned int ia = indices[n * 3], ib = indices[n * 3 + 1], ic = indices[n * 3 + 2];
+            const glm::vec3& a = vertices[ia];
+            const glm::vec3& b = vertices[ib];
+            const glm::vec3& c = vertices[ic];
+
+            float rowMin = (std::min(a.z, std::min(b.z, c.z)) - origin.y) / spacing.y;
+            float rowMax = (std::max(a.z, std::max(b.z, c.z)) - origin.y) / spacing.y;
+            int firstRow = static_cast<int>(std::ceil(std::max(rowMin, static_cast<float>(begin)) - 1e-4f));
+            int lastRow = static_cast<int>(std::floor(std::min(rowMax, static_cast<float>(end - 1)) + 1e-4f));
+            if (firstRow > lastRow)
+            {
+                continue;
+            }
+            float columnMin = (std::min(a.x, std::min(b.x, c.x)) - origin.x) / spacing.x;
+            float columnMax = (std::max(a.x, std::max(b.x, c.x)) - origin.x) / spacing.x;
+            int firstColumn = static_cast<int>(std::ceil(std::max(columnMin, 0.0f) - 1e-4f));
+            int lastColumn = static_cast<int>(std::floor(std::min(columnMax, static_cast<float>(columns - 1)) + 1e-4f));
+
+            // Loddrette trekanter dekker ingen punkter i x og z
+            float area = (b.x - a.x) * (c.z - a.z) - (c.x - a.x) * (b.z - a.z);
+            if (std::abs(area) < 1e-12f)
+            {
+                continue;
+            }
+            float inverseArea = 1.0f / area;
+
+            for (int row = firstRow; row <= lastRow; ++row)
+            {
+                float z = origin.y + spacing.y * row;
+                for (int column = firstColumn; column <= lastColumn; ++column)
+                {
+                    float x = origin.x + spacing.x * column;
+                    float wb = ((x - a.x) * (c.z - a.z) - (c.x - a.x) * (z - a.z)) * inverseArea;
+                    float wc = ((b.x - a.x) * (z - a.z) - (x - a.x) * (b.z - a.z)) * inverseArea;
+                    float wa = 1.0f - wb - wc;
+                    // Litt slingringsmonn s punkter p kanten mellom to trekanter ikke faller mellom begge
+                    const float margin = -1e-5f;
+                    if (wa < margin || wb < margin || wc < margin)
+                    {
+                        continue;
+                    }
+
+                    glm::vec3 normal = wa * vertexNormals[ia] + wb * vertexNormals[ib] + wc * vertexNormals[ic];
+                    float length = glm::length(normal);
+                    normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+                    size_t index = grid.Index(column, row);
+                    heights[index] = wa * a.y + wb * b.y + wc * c.y;
+                    normalX[index] = normal.x;
+                    normalY[index] = normal.y;
+                    normalZ[index] = normal.z;
+                }
+            }
+        }
+    });
+    return true;
+}
+
+float BakedHeightField::HeightAt(float x, float z, HeightInterpolation interpolation) const
+{
+    return grid.Sample(HEIGHT, x, z, interpolation);
+}
+
+glm::vec3 BakedHeightField::NormalAt(float x, float z, HeightInterpolation interpolation) const
+{
+    glm::vec3 normal(grid.Sample(NORMAL_X, x, z, interpolation), grid.Sample(NORMAL_Y, x, z, interpolation),
+        grid.Sample(NORMAL_Z, x, z, interpolation));
+    float length = glm::length(normal);
+    return length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+void BakedHeightField::HeightsAt(const float* x, const float* z, size_t count, float* output, HeightInterpolation interpolation) const
+{
+    if (grid.IsEmpty())
+    {
+        std::fill(output, output + count, std::numeric_limits<float>::quiet_NaN());
+        return;
+    }
+
+    const int channels[1] = { HEIGHT };
+    grid.SampleBatch(x, z, count, channels, 1, interpolation, [output](size_t offset, size_t lanes, float* const* values)
+    {
+        std::copy(values[0], values[0] + lanes, output + offset);
+    });
+}
+
+void BakedHeightField::NormalsAt(const float* x, const float* z, size_t count, glm::vec3* output, HeightInterpolation interpolation) const
+{
+    if (grid.IsEmpty())
+    {
+        std::fill(output, output + count, glm::vec3(0.0f, 1.0f, 0.0f));
+        return;
+    }
+
+    const int channels[3] = { NORMAL_X, NORMAL_Y, NORMAL_Z };
+    grid.SampleBatch(x, z, count, channels, 3, interpolation, [output](size_t offset, size_t lanes, float* const* values)
+    {
+        for (size_t k = 0; k < lanes; ++k)
+        {
+            glm::vec3 normal(values[0][k], values[1][k], values[2][k]);
+            float length = glm::length(normal);
+            output[offset + k] = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    });
+}
+
+bool BakedHeightField::IsEmpty() const
+{
+    return grid.IsEmpty();
+}
+
+int BakedHeightField::GetColumns() const
+{
+    return grid.GetColumns();
+}
+
+int BakedHeightField::GetRows() const
+{
+    return grid.GetRows();
+}
+
+const glm::vec2& BakedHeightField::GetOrigin() const
+{
+    return grid.GetOrigin();
+}
+
+const glm::vec2& BakedHeightField::GetSpacing() const
+{
+    return grid.GetSpacing();
+}
@@ -0,0 +1,51 @@
+#ifndef BAKEDHEIGHTFIELD_H
+#define BAKEDHEIGHTFIELD_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "BakedGrid.h"
+
+// Hyden og normalen til en triangulering samplet i et BakedGrid over x og z, s et oppslag under simuleringen
+// bare er noen f minnelesinger i stedet for  lete etter trekanten under punktet. Der ingen trekant dekker
+// x og z (hull og utenfor Delaunay-trianguleringen) er verdiene NaN
+class BakedHeightField
+{
+public:
+    BakedHeightField();
+
+    // columns x rows punkter over boksen til hjrnene i x og z. Hver trekant blir rastrert i punktene den dekker,
+    // med hyden og hjrnenormalene interpolert barysentrisk. Hver trd tar en stripe med rader
+    bool Bake(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& vertexNormals,
+        const std::vector<unsigned int>& indices, int columns, int rows);
+    void Clear();
+
+    float HeightAt(float x, float z, HeightInterpolation interpolation = BILINEAR_INTERPOLATION) const;
+    glm::vec3 NormalAt(float x, float z, HeightInterpolation interpolation = BILINEAR_INTERPOLATION) const; // Normalisert
+
+    // Som over for count punkter, SimdFloat::Width om gangen og i parallell for store batcher
+    void HeightsAt(const float* x, const float* z, size_t count, float* heights,
+        HeightInterpolation interpolation = BILINEAR_INTERPOLATION) const;
+    void NormalsAt(const float* x, const float* z, size_t count, glm::vec3* normals,
+        HeightInterpolation interpolation = BILINEAR_INTERPOLATION) const;
+
+    bool IsEmpty() const;
+    int GetColumns() const;
+    int GetRows() const;
+    const glm::vec2& GetOrigin() const; // x og z til punkt (0, 0)
+    const glm::vec2& GetSpacing() const; // Avstanden mellom punktene i x og z
+
+private:
+    enum Channel
+    {
+        HEIGHT,
+        NORMAL_X,
+        NORMAL_Y,
+        NORMAL_Z,
+        CHANNEL_COUNT
+    };
+
+    BakedGrid grid;
+};
+
+#endif // !BAKEDHEIGHTFIELD_H
@@ -0,0 +1,482 @@
+#include "DelaunayTriangulation.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+// Med frre punkter enn dette per stripe lnner det seg ikke  dele opp
+static const size_t minPointsPerStrip = 50000;
+
+// > 0 nr a, b, c gr mot klokka
+static double orient(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c)
+{
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+// > 0 nr d ligger inne i den omskrevne sirkelen til a, b, c (a, b, c mot klokka)
+static double inCircle(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c, const glm::dvec2& d)
+{
+    double adx = a.x - d.x, ady = a.y - d.y;
+    double bdx = b.x - d.x, bdy = b.y - d.y;
+    double cdx = c.x - d.x, cdy = c.y - d.y;
+
+    double aLift = adx * adx + ady * ady;
+    double bLift = bdx * bdx + bdy * bdy;
+    double cLift = cdx * cdx + cdy * cdy;
+
+    return aLift * (bdx * cdy - cdx * bdy) + bLift * (cdx * ady - adx * cdy) + cLift * (adx * bdy - bdx * ady);
+}
+
+// Posisjonen langs en Hilbert-kurve gjennom et 65536 x 65536 rutenett. Punkter som ligger nr hverandre
+// langs kurven ligger ogs nr hverandre i planet, s hvert nytt punkt havner like ved forrige trekant
+static uint32_t hilbertIndex(uint32_t x, uint32_t y)
+{
+    uint32_t d = 0;
+    for (uint32_t s = 1u << 15; s > 0; s >>= 1)
+    {
+        uint32_t rx = (x & s) > 0 ? 1 : 0;
+        uint32_t ry = (y & s) > 0 ? 1 : 0;
+        d += s * s * ((3 * rx) ^ ry);
+
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = 0xFFFF - x;
+                y = 0xFFFF - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+// Inkrementell Delaunay-triangulering (Bowyer-Watson) med naboinformasjon.
+// De tre frste hjrnene er en stor trekant rundt alle punktene, og blir ikke med i resultatet.
+class IncrementalDelaunay
+{
+public:
+    struct Triangle
+    {
+        int v[3]; // Hjrnene mot klokka, v[0] = -1 betyr at trekanten er slettet
+        int adj[3]; // adj[i] er naboen over kanten som ligger rett overfor v[i]
+    };
+
+    IncrementalDelaunay(const glm::dvec2& min, const glm::dvec2& max, size_t expectedPoints)
+    {
+        glm::dvec2 middle = (min + max) * 0.5;
+        double size = std::max(std::max(max.x - min.x, max.y - min.y), 1.0) * 100.0;
+
+        positions.reserve(expectedPoints + 3);
+        ids.reserve(expectedPoints + 3);
+        triangles.reserve(expectedPoints * 2 + 1);
+
+        addVertex(glm::dvec2(middle.x - size, middle.y - size), 0);
+        addVertex(glm::dvec2(middle.x + size, middle.y - size), 0);
+        addVertex(glm::dvec2(middle.x, middle.y + size), 0);
+
+        Triangle super = { { 0, 1, 2 }, { -1, -1, -1 } };
+        triangles.push_back(super);
+        marks.push_back(0);
+        stamp = 0;
+        last = 0;
+    }
+
+    // Setter inn et punkt. Returnerer false hvis det allerede finnes et punkt p samme sted
+    bool Insert(const glm::dvec2& p, uint32_t id)
+    {
+        int start = Locate(p, last);
+        const Triangle& containing = triangles[start];
+        for (int k = 0; k < 3; ++k)
+        {
+            if (positions[containing.v[k]] == p)
+            {
+                return false;
+            }
+        }
+
+        int vertex = static_cast<int>(positions.size());
+        addVertex(p, id);
+
+        // Hullet er alle trekantene der punktet ligger inne i den omskrevne sirkelen, funnet ved  g fra nabo til nabo
+        ++stamp;
+        cavity.clear();
+        cavity.push_back(start);
+        marks[start] = stamp;
+        for (size_t c = 0; c < cavity.size(); ++c)
+        {
+            const Triangle& t = triangles[cavity[c]];
+            for (int i = 0; i < 3; ++i)
+            {
+                int n = t.adj[i];
+                if (n >= 0 && marks[n] != stamp && inCircle(positions[triangles[n].v[0]], positions[triangles[n].v[1]], positions[triangles[n].v[2]], p) > 0)
+                {
+                    marks[n] = stamp;
+                    cavity.push_back(n);
+                }
+            }
+        }
+
+        // Kantene rundt hullet. Avrundingsfeil kan gi et hull som ikke er stjerneformet sett fra punktet,
+        // da blir trekanten p utsiden av kanten tatt med og kantene funnet p nytt
+        bool grown = true;
+        while (grown)
+        {
+            grown = false;
+            boundary.clear();
+            for (int t : cavity)
+            {
+                for (int i = 0; i < 3; ++i)
+                {
+                    int n = triangles[t].adj[i];
+                    if (n >= 0 && marks[n] == stamp)
+                    {
+                        continue;
+                    }
+
+                    int a = triangles[t].v[(i + 1) % 3];
+                    int b = triangles[t].v[(i + 2) % 3];
+                    if (n >= 0 && orient(positions[a], positions[b], p) <= 0)
+                    {
+                        marks[n] = stamp;
+                        cavity.push_back(n);
+                        grown = true;
+                        break;
+                    }
+                    boundary.push_back({ a, b, n });
+                }
+                if (grown)
+                {
+                    break;
+                }
+            }
+        }
+
+        // Ny vifte av trekanter fra punktet til hver kant. Plassene til de gamle trekantene blir brukt om igjen
+        size_t reused = 0;
+        newTriangles.resize(boundary.size());
+        for (size_t k = 0; k < boundary.size(); ++k)
+        {
+            int slot;
+            if (reused < cavity.size())
+            {
+                slot = cavity[reused++];
+            }
+            else if (!freeTriangles.empty())
+            {
+                slot = freeTriangles.back();
+                freeTriangles.pop_back();
+            }
+            else
+            {
+                slot = static_cast<int>(triangles.size());
+                triangles.push_back(Triangle());
+                marks.push_back(0);
+            }
+            newTriangles[k] = slot;
+        }
+        for (; reused < cavity.size(); ++reused)
+        {
+            triangles[cavity[reused]].v[0] = -1;
+            freeTriangles.push_back(cavity[reused]);
+        }
+
+        for (size_t k = 0; k < boundary.size(); ++k)
+        {
+            const Edge& edge = boundary[k];
+            Triangle& t = triangles[newTriangles[k]];
+            t.v[0] = edge.a;
+            t.v[1] = edge.b;
+            t.v[2] = vertex;
+            t.adj[2] = edge.outside;
+            marks[newTriangles[k]] = 0;
+
+            // Kanten b-p deles med trekanten som starter i b, og p-a med trekanten som slutter i a
+            for (size_t m = 0; m < boundary.size(); ++m)
+            {
+                if (boundary[m].a == edge.b)
+                {
+                    t.adj[0] = newTriangles[m];
+                }
+                if (boundary[m].b == edge.a)
+                {
+                    t.adj[1] = newTriangles[m];
+                }
+            }
+
+            // Naboen p utsiden peker til den nye trekanten over kanten a-b
+            if (edge.outside >= 0)
+            {
+                Triangle& outside = triangles[edge.outside];
+                for (int j = 0; j < 3; ++j)
+                {
+                    if (outside.v[(j + 1) % 3] == edge.b && outside.v[(j + 2) % 3] == edge.a)
+                    {
+                        outside.adj[j] = newTriangles[k];
+                    }
+                }
+            }
+        }
+
+        last = newTriangles[0];
+        return true;
+    }
+
+    // Finner trekanten som inneholder p ved  g mot punktet fra trekant til trekant, med start i start
+    int Locate(const glm::dvec2& p, int start) const
+    {
+        int t = (start >= 0 && start < static_cast<int>(triangles.size()) && triangles[start].v[0] >= 0) ? start : last;
+        for (unsigned int step = 0; ; ++step)
+        {
+            const Triangle& triangle = triangles[t];
+            int next = -1;
+            for (int k = 0; k < 3; ++k)
+            {
+                // Starter p en ny kant hvert steg, s vandringen ikke kan g i ring
+                int i = (k + step) % 3;
+                if (orient(positions[triangle.v[(i + 1) % 3]], positions[triangle.v[(i + 2) % 3]], p) < 0)
+                {
+                    next = triangle.adj[i];
+                    break;
+                }
+            }
+
+            if (next < 0)
+            {
+                return t;
+            }
+            t = next;
+        }
+    }
+
+    bool IsAlive(int t) const
+    {
+        return triangles[t].v[0] >= 0;
+    }
+
+    bool IsReal(int t) const // Ingen av hjrnene er fra den store trekanten rundt
+    {
+        const Triangle& triangle = triangles[t];
+        return triangle.v[0] >= 3 && triangle.v[1] >= 3 && triangle.v[2] >= 3;
+    }
+
+    std::vector<Triangle> triangles;
+    std::vector<glm::dvec2> positions;
+    std::vector<uint32_t> ids; // Indeksen til hvert hjrne i punktskyen
+
+private:
+    struct Edge
+    {
+        int a, b; // Kanten gr fra a til b mot klokka rundt hullet
+        int outside; // Trekanten p utsiden, -1 langs kanten av den store trekanten
+    };
+
+    void addVertex(const glm::dvec2& position, uint32_t id)
+    {
+        positions.push_back(position);
+        ids.push_back(id);
+    }
+
+    std::vector<uint32_t> marks; // Trekanter med marks == stamp er med i hullet
+    uint32_t stamp;
+    int last; // Sist lagde trekant, der neste punkt begynner  lete
+    std::vector<int> freeTriangles;
+    std::vector<int> cavity;
+    std::vector<Edge> boundary;
+    std::vector<int> newTriangles;
+};
+
+// Sorterer punktene langs Hilbert-kurven over bounding boxen og setter dem inn i rekkeflge
+static void insertAlongCurve(IncrementalDelaunay& mesh, const std::vector<glm::vec3>& points, const std::vector<uint32_t>& ids,
+    const glm::dvec2& min, const glm::dvec2& max)
+{
+    glm::dvec2 scale = 65535.0 / glm::max(max - min, glm::dvec2(1e-9));
+
+    std::vector<std::pair<uint32_t, uint32_t>> order(ids.size());
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        const glm::vec3& point = points[ids[i]];
+        uint32_t x = static_cast<uint32_t>((point.x - min.x) * scale.x);
+        uint32_t y = static_cast<uint32_t>((point.z - min.y) * scale.y);
+        order[i] = std::make_pair(hilbertIndex(std::min(x, 0xFFFFu), std::min(y, 0xFFFFu)), ids[i]);
+    }
+    std::sort(order.begin(), order.end());
+
+    for (const auto& entry : order)
+    {
+        const glm::vec3& point = points[entry.second];
+        mesh.Insert(glm::dvec2(point.x, point.z), entry.second);
+    }
+}
+
+// Skriver trekanten med klokka i xz-planet, som i gridtrianguleringen, s normalen peker opp
+static void emitTriangle(const IncrementalDelaunay& mesh, const IncrementalDelaunay::Triangle& triangle, std::vector<unsigned int>& output)
+{
+    output.push_back(mesh.ids[triangle.v[0]]);
+    output.push_back(mesh.ids[triangle.v[2]]);
+    output.push_back(mesh.ids[triangle.v[1]]);
+}
+
+void DelaunayTriangulation::Triangulate(const std::vector<glm::vec3>& points, std::vector<unsigned int>& indices)
+{
+    indices.clear();
+    size_t count = points.size();
+    if (count < 3)
+    {
+        return;
+    }
+
+    glm::dvec2 min(DBL_MAX), max(-DBL_MAX);
+    for (const auto& point : points)
+    {
+        min = glm::min(min, glm::dvec2(point.x, point.z));
+        max = glm::max(max, glm::dvec2(point.x, point.z));
+    }
+
+    unsigned int stripCount = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threadCount(), count / minPointsPerStrip)));
+
+    // Stripegrensene blir valgt fra et histogram over x, s hver stripe fr omtrent like mange punkter
+    const int bins = 4096;
+    double binWidth = std::max(max.x - min.x, 1e-9) / bins;
+    std::vector<size_t> histogram(bins, 0);
+    for (const auto& point : points)
+    {
+        histogram[std::min(bins - 1, static_cast<int>((point.x - min.x) / binWidth))]++;
+    }
+
+    std::vector<double> edges; // Grensene mellom stripene, stripe s har edges[s - 1] <= x < edges[s]
+    size_t accumulated = 0;
+    for (int bin = 0; bin < bins && edges.size() + 1 < stripCount; ++bin)
+    {
+        accumulated += histogram[bin];
+        if (accumulated >= count * (edges.size() + 1) / stripCount)
+        {
+            edges.push_back(min.x + (bin + 1) * binWidth);
+        }
+    }
+    stripCount = static_cast<unsigned int>(edges.size() + 1);
+
+    auto stripOf = [&](double x)
+    {
+        return static_cast<unsigned int>(std::upper_bound(edges.begin(), edges.end(), x) - edges.begin());
+    };
+
+    std::vector<std::vector<uint32_t>> stripPoints(stripCount);
+    for (size_t i = 0; i < count; ++i)
+    {
+        stripPoints[stripOf(points[i].x)].push_back(static_cast<uint32_t>(i));
+    }
+
+    // Triangulerer hver stripe for seg, parallelt
+    std::vector<IncrementalDelaunay> meshes;
+    meshes.reserve(stripCount);
+    for (unsigned int s = 0; s < stripCount; ++s)
+    {
+        meshes.emplace_back(min, max, stripPoints[s].size());
+    }
+
+    std::vector<std::vector<char>> finished(stripCount);
+    std::vector<std::vector<unsigned int>> stripIndices(stripCount);
+    std::vector<char> leftover(stripCount > 1 ? count : 0, 0);
+    const double infinity = std::numeric_limits<double>::infinity();
+
+    parallelFor(stripCount, stripCount, [&](size_t first, size_t, unsigned int)
+    {
+        unsigned int s = static_cast<unsigned int>(first);
+        IncrementalDelaunay& mesh = meshes[s];
+        insertAlongCurve(mesh, points, stripPoints[s], min, max);
+        std::vector<uint32_t>().swap(stripPoints[s]);
+
+        double low = s > 0 ? edges[s - 1] : -infinity;
+        double high = s + 1 < stripCount ? edges[s] : infinity;
+
+        // En trekant er ferdig nr den omskrevne sirkelen ligger helt inne i stripen. Da kan ingen punkter fra
+        // andre striper ligge i sirkelen, s trekanten er med i Delaunay-trianguleringen av alle punktene
+        finished[s].assign(mesh.triangles.size(), 0);
+        for (size_t t = 0; t < mesh.triangles.size(); ++t)
+        {
+            if (!mesh.IsAlive(static_cast<int>(t)))
+            {
+                continue;
+            }
+
+            const IncrementalDelaunay::Triangle& triangle = mesh.triangles[t];
+            bool done = false;
+            if (mesh.IsReal(static_cast<int>(t)))
+            {
+                glm::dvec2 a = mesh.positions[triangle.v[0]];
+                glm::dvec2 b = mesh.positions[triangle.v[1]] - a;
+                glm::dvec2 c = mesh.positions[triangle.v[2]] - a;
+                double d = 2.0 * (b.x * c.y - b.y * c.x);
+                double centerX = a.x + (c.y * glm::dot(b, b) - b.y * glm::dot(c, c)) / d;
+                double centerY = a.y + (b.x * glm::dot(c, c) - c.x * glm::dot(b, b)) / d;
+                double radius = glm::length(glm::dvec2(centerX, centerY) - a);
+                done = centerX - radius > low && centerX + radius < high;
+            }
+
+            if (done)
+            {
+                finished[s][t] = 1;
+                emitTriangle(mesh, triangle, stripIndices[s]);
+            }
+            else if (stripCount > 1)
+            {
+                // Punktene i stripen tilhrer bare denne trden, s ingen andre skriver til de samme plassene
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (triangle.v[k] >= 3)
+                    {
+                        leftover[mesh.ids[triangle.v[k]]] = 1;
+                    }
+                }
+            }
+        }
+    });
+
+    for (auto& strip : stripIndices)
+    {
+        indices.insert(indices.end(), strip.begin(), strip.end());
+        std::vector<unsigned int>().swap(strip);
+    }
+
+    if (stripCount == 1)
+    {
+        return;
+    }
+
+    // Punktene i de uferdige trekantene blir triangulert sammen. Av de nye trekantene blir bare de som ikke
+    // ligger over en ferdig trekant fra stripene brukt, det vil si de som fyller hullene mellom stripene
+    std::vector<uint32_t> leftoverIds;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (leftover[i])
+        {
+            leftoverIds.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    IncrementalDelaunay seams(min, max, leftoverIds.size());
+    insertAlongCurve(seams, points, leftoverIds, min, max);
+
+    std::vector<int> hints(stripCount, -1);
+    for (size_t t = 0; t < seams.triangles.size(); ++t)
+    {
+        if (!seams.IsAlive(static_cast<int>(t)) || !seams.IsReal(static_cast<int>(t)))
+        {
+            continue;
+        }
+
+        const IncrementalDelaunay::Triangle& triangle = seams.triangles[t];
+        glm::dvec2 centroid = (seams.positions[triangle.v[0]] + seams.positions[triangle.v[1]] + seams.positions[triangle.v[2]]) / 3.0;
+        unsigned int s = stripOf(centroid.x);
+        hints[s] = meshes[s].Locate(centroid, hints[s]);
+        if (!finished[s][hints[s]])
+        {
+            emitTriangle(seams, triangle, indices);
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef DELAUNAYTRIANGULATION_H
+#define DELAUNAYTRIANGULATION_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Hvordan PunktSky lager trekantene
+enum TriangulationMode
+{
+    GRID_TRIANGULATION, // Hydekart med ett hjrne midt i hver rute
+    DELAUNAY_TRIANGULATION, // Delaunay-triangulering av alle punktene i xz-planet
+    ADAPTIVE_TRIANGULATION // Store trekanter der hydekartet er flatt og sm der det varierer (RtinMesh)
+};
+
+// 2.5D Delaunay-triangulering av en punktsky. Punktene blir triangulert i xz-planet, og y er bare med som hyde.
+// Punktene blir delt i striper langs x med like mange punkter i hver, sortert langs en Hilbert-kurve og satt inn
+// n og n (Bowyer-Watson) i hver sin stripe parallelt. Trekanter der den omskrevne sirkelen ligger helt inne i
+// stripen er ferdige. Punktene i resten av trekantene, langs kantene mellom stripene, blir triangulert p nytt til slutt.
+class DelaunayTriangulation
+{
+public:
+    // Trekantene peker inn i points og har samme omlpsretning som gridtrianguleringen, s normalene peker opp.
+    // Punkter med samme x og z som et punkt som allerede er satt inn blir hoppet over
+    static void Triangulate(const std::vector<glm::vec3>& points, std::vector<unsigned int>& indices);
+};
+
+#endif // !DELAUNAYTRIANGULATION_H
@@ -0,0 +1,307 @@
+#include "HeightGrid.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+// Hydene blir summert som heltall i enheter av 1/65536 meter. Heltallsaddisjon gir samme sum i hvilken som helst rekkeflge
+static const double heightUnits = 65536.0;
+
+// Atomisk min og max for float, prver p nytt til ingen annen trd har endret verdien i mellomtiden
+static void atomicMin(std::atomic<float>& target, float value)
+{
+    float current = target.load(std::memory_order_relaxed);
+    while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+static void atomicMax(std::atomic<float>& target, float value)
+{
+    float current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+// Atomiske visninger inn i en rute mens den blir fylt. std::atomic uten ls har samme strrelse og representasjon som
+// verdien, og cells ligger i en std::vector som er justert for int64_t
+static_assert(sizeof(std::atomic<int64_t>) == sizeof(int64_t) && sizeof(std::atomic<uint32_t>) == sizeof(uint32_t)
+    && sizeof(std::atomic<float>) == sizeof(float), "Atomic views into HeightCell need lock-free atomics");
+static_assert(offsetof(HeightCell, min) == sizeof(float) && offsetof(HeightCell, count) == 3 * sizeof(float), "Unexpected HeightCell layout");
+
+static std::atomic<int64_t>& sumOf(HeightCell& cell) // mean og min sammen
+{
+    return *reinterpret_cast<std::atomic<int64_t>*>(&cell.mean);
+}
+
+static std::atomic<uint32_t>& countOf(HeightCell& cell)
+{
+    return reinterpret_cast<std::atomic<uint32_t>&>(cell.count);
+}
+
+HeightGrid::HeightGrid()
+{
+    origin = glm::vec2(0.0f);
+    spacing = 1.0f;
+    columns = 0;
+    rows = 0;
+    firstCol = 0;
+    firstRow = 0;
+}
+
+void HeightGrid::Reset(const glm::vec2& gridOrigin, float cellSpacing, int columnCount, int rowCount, int firstColumn, int firstRowIndex)
+{
+    origin = gridOrigin;
+    spacing = cellSpacing;
+    columns = std::max(columnCount, 0);
+    rows = std::max(rowCount, 0);
+    firstCol = firstColumn;
+    firstRow = firstRowIndex;
+
+    HeightCell empty = { 0.0f, FLT_MAX, -FLT_MAX, 0 };
+    cells.assign(static_cast<size_t>(columns) * rows, empty);
+}
+
+void HeightGrid::Accumulate(const glm::vec3* points, size_t count, unsigned int threads)
+{
+    accumulate(count, threads, [points](size_t i) { return points[i]; });
+}
+
+void HeightGrid::Accumulate(const QuantizedPoints& points, const glm::dvec3& relativeTo, unsigned int threads)
+{
+    const glm::ivec3* data = points.GetData().data();
+    glm::dvec3 scale = points.GetScale();
+    glm::dvec3 shift = points.GetOrigin() - relativeTo;
+    accumulate(points.Size(), threads, [=](size_t i) { return glm::vec3(glm::dvec3(data[i]) * scale + shift); });
+}
+
+template <typename PointAt>
+void HeightGrid::accumulate(size_t count, unsigned int threads, PointAt pointAt)
+{
+    size_t cellCount = cells.size();
+    if (cellCount == 0)
+    {
+        return;
+    }
+
+    // Rutene blir fylt p plass med atomiske visninger inn i HeightCell, s det trengs ikke et eget grid med tellere.
+    // Frste gjennomgang summerer hydene som int64 i plassen til mean og min, og teller i count
+    parallelFor(cellCount, threads, [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            cells[i] = { 0.0f, 0.0f, 0.0f, 0 };
+        }
+    });
+
+    parallelFor(count, threads, [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            glm::vec3 point = pointAt(i);
+            glm::ivec2 cell = CellOf(point);
+            if (!Contains(cell.x, cell.y))
+            {
+                continue;
+            }
+
+            HeightCell& target = cells[cellIndex(cell.x, cell.y)];
+            sumOf(target).fetch_add(static_cast<int64_t>(std::llround(static_cast<double>(point.y) * heightUnits)), std::memory_order_relaxed);
+            countOf(target).fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    parallelFor(cellCount, threads, [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            HeightCell& cell = cells[i];
+            int64_t sum = sumOf(cell).load(std::memory_order_relaxed);
+            cell.mean = cell.count > 0 ? static_cast<float>(static_cast<double>(sum) / heightUnits / cell.count) : 0.0f;
+            cell.min = FLT_MAX;
+            cell.max = -FLT_MAX;
+        }
+    });
+
+    // Andre gjennomgang finner min og max, n som plassen deres er ledig
+    parallelFor(count, threads, [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            glm::vec3 point = pointAt(i);
+            glm::ivec2 cell = CellOf(point);
+            if (!Contains(cell.x, cell.y))
+            {
+                continue;
+            }
+
+            HeightCell& target = cells[cellIndex(cell.x, cell.y)];
+            atomicMin(reinterpret_cast<std::atomic<float>&>(target.min), point.y);
+            atomicMax(reinterpret_cast<std::atomic<float>&>(target.max), point.y);
+        }
+    });
+}
+
+void HeightGrid::BuildMesh(int col0, int row0, int col1, int row1, std::vector<glm::vec3>& vertices,
+    std::vector<glm::vec3>& normals, std::vector<unsigned int>& indices) const
+{
+    vertices.clear();
+    normals.clear();
+    indices.clear();
+
+    // Siste firkant som har alle fire hjrnene innenfor gridet
+    int lastCol = firstCol + columns - 2;
+    int lastRow = firstRow + rows - 2;
+
+    // Hjrnene blir lagt til frste gang de blir brukt
+    std::vector<int> vertexOf(cells.size(), -1);
+    auto vertex = [&](int col, int row)
+    {
+        int& id = vertexOf[cellIndex(col, row)];
+        if (id < 0)
+        {
+            id = static_cast<int>(vertices.size());
+            vertices.push_back(CellPosition(col, row));
+        }
+        return static_cast<unsigned int>(id);
+    };
+
+    auto complete = [&](int col, int row)
+    {
+        return HasHeight(col, row) && HasHeight(col + 1, row) && HasHeight(col, row + 1) && HasHeight(col + 1, row + 1);
+    };
+
+    for (int row = std::max(row0, firstRow); row <= std::min(row1, lastRow); ++row)
+    {
+        for (int col = std::max(col0, firstCol); col <= std::min(col1, lastCol); ++col)
+        {
+            if (complete(col, row))
+            {
+                unsigned int topLeft = vertex(col, row);
+                unsigned int topRight = vertex(col + 1, row);
+                unsigned int bottomLeft = vertex(col, row + 1);
+                unsigned int bottomRight = vertex(col + 1, row + 1);
+
+                indices.insert(indices.end(), { topLeft, bottomLeft, topRight, topRight, bottomLeft, bottomRight });
+            }
+        }
+    }
+
+    // Normalene summerer alle trekantene rundt hvert hjrne, ogs de utenfor utsnittet
+    normals.assign(vertices.size(), glm::vec3(0.0f));
+    auto addNormal = [&](int col, int row, const glm::vec3& normal)
+    {
+        int id = vertexOf[cellIndex(col, row)];
+        if (id >= 0)
+        {
+            normals[id] += normal;
+        }
+    };
+
+    for (int row = std::max(row0 - 1, firstRow); row <= std::min(row1 + 1, lastRow); ++row)
+    {
+        for (int col = std::max(col0 - 1, firstCol); col <= std::min(col1 + 1, lastCol); ++col)
+        {
+            if (!complete(col, row))
+            {
+                continue;
+            }
+
+            glm::vec3 topLeft = CellPosition(col, row);
+            glm::vec3 topRight = CellPosition(col + 1, row);
+            glm::vec3 bottomLeft = CellPosition(col, row + 1);
+            glm::vec3 bottomRight = CellPosition(col + 1, row + 1);
+
+            glm::vec3 first = glm::normalize(glm::cross(bottomLeft - topLeft, topRight - topLeft));
+            glm::vec3 second = glm::normalize(glm::cross(bottomLeft - topRight, bottomRight - topRight));
+
+            addNormal(col, row, first);
+            addNormal(col, row + 1, first + second);
+            addNormal(col + 1, row, first + second);
+            addNormal(col + 1, row + 1, second);
+        }
+    }
+
+    for (auto& normal : normals)
+    {
+        normal = glm::normalize(normal);
+    }
+}
+
+void HeightGrid::BuildMesh(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<unsigned int>& indices) const
+{
+    BuildMesh(firstCol, firstRow, firstCol + columns - 2, firstRow + rows - 2, vertices, normals, indices);
+}
+
+glm::ivec2 HeightGrid::CellOf(const glm::vec3& point) const
+{
+    return glm::ivec2(static_cast<int>(std::floor((point.x - origin.x) / spacing)), static_cast<int>(std::floor((point.z - origin.y) / spacing)));
+}
+
+bool HeightGrid::Contains(int col, int row) const
+{
+    return col >= firstCol && col < firstCol + columns && row >= firstRow && row < firstRow + rows;
+}
+
+bool HeightGrid::HasHeight(int col, int row) const
+{
+    return Contains(col, row) && cells[cellIndex(col, row)].count > 0;
+}
+
+const HeightCell& HeightGrid::GetCell(int col, int row) const
+{
+    return cells[cellIndex(col, row)];
+}
+
+glm::vec3 HeightGrid::CellPosition(int col, int row) const
+{
+    return glm::vec3(origin.x + (col + 0.5f) * spacing, cells[cellIndex(col, row)].mean, origin.y + (row + 0.5f) * spacing);
+}
+
+size_t HeightGrid::cellIndex(int col, int row) const
+{
+    return static_cast<size_t>(row - firstRow) * columns + (col - firstCol);
+}
+
+std::vector<HeightCell>& HeightGrid::GetCells()
+{
+    return cells;
+}
+
+const std::vector<HeightCell>& HeightGrid::GetCells() const
+{
+    return cells;
+}
+
+const glm::vec2& HeightGrid::GetOrigin() const
+{
+    return origin;
+}
+
+float HeightGrid::GetSpacing() const
+{
+    return spacing;
+}
+
+int HeightGrid::GetColumns() const
+{
+    return columns;
+}
+
+int HeightGrid::GetRows() const
+{
+    return rows;
+}
+
+int HeightGrid::GetFirstColumn() const
+{
+    return firstCol;
+}
+
+int HeightGrid::GetFirstRow() const
+{
+    return firstRow;
+}
@@ -0,0 +1,70 @@
+#ifndef HEIGHTGRID_H
+#define HEIGHTGRID_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+#include "Parallel.h"
+#include "QuantizedPoints.h"
+
+// Statistikk for alle punktene som havner i n rute
+struct HeightCell
+{
+    float mean; // Gjennomsnittshyden
+    float min;
+    float max;
+    uint32_t count; // 0 betyr at ruten er tom
+};
+
+// Flatt rutenett (rad for rad) der hver rute samler hyden til alle punktene i den.
+// Hydene blir summert som heltall, s resultatet er det samme uansett rekkeflgen p punktene og antall trder.
+// Gridet kan vre et utsnitt av et strre grid, da er kolonner og rader fortsatt i koordinatene til hele gridet.
+class HeightGrid
+{
+public:
+    HeightGrid();
+
+    // Rute (col, row) dekker [origin.x + col * spacing, origin.x + (col + 1) * spacing) i x, og tilsvarende i z
+    void Reset(const glm::vec2& gridOrigin, float cellSpacing, int columnCount, int rowCount, int firstColumn = 0, int firstRow = 0);
+
+    // Regner ut statistikken for alle rutene parallelt fra punktene. Punkter utenfor gridet blir ignorert
+    void Accumulate(const glm::vec3* points, size_t count, unsigned int threads = threadCount());
+    // Som over, men hvert punkt blir gjort om til float relativt til relativeTo der det blir lest, s det trengs ingen float-kopi
+    void Accumulate(const QuantizedPoints& points, const glm::dvec3& relativeTo, unsigned int threads = threadCount());
+
+    // Lager to trekanter for hver firkant fra (col0, row0) til (col1, row1) der alle fire hjrnene har punkter.
+    // Hjrnene ligger midt i rutene med gjennomsnittshyden. Normalene tar med trekantene rundt, s for  f de samme
+    // normalene som hele gridet m utsnittet ha n rute ekstra p lav side og to p hy side
+    void BuildMesh(int col0, int row0, int col1, int row1, std::vector<glm::vec3>& vertices,
+        std::vector<glm::vec3>& normals, std::vector<unsigned int>& indices) const;
+    void BuildMesh(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<unsigned int>& indices) const; // Hele gridet
+
+    glm::ivec2 CellOf(const glm::vec3& point) const; // Ruten et punkt havner i
+    bool Contains(int col, int row) const;
+    bool HasHeight(int col, int row) const; // Ruten er innenfor gridet og har minst ett punkt
+    const HeightCell& GetCell(int col, int row) const;
+    glm::vec3 CellPosition(int col, int row) const; // Midten av ruten med gjennomsnittshyden
+
+    std::vector<HeightCell>& GetCells();
+    const std::vector<HeightCell>& GetCells() const;
+    const glm::vec2& GetOrigin() const;
+    float GetSpacing() const;
+    int GetColumns() const;
+    int GetRows() const;
+    int GetFirstColumn() const;
+    int GetFirstRow() const;
+
+private:
+    size_t cellIndex(int col, int row) const;
+    template <typename PointAt>
+    void accumulate(size_t count, unsigned int threads, PointAt pointAt); // pointAt(i) gir punkt i
+
+    std::vector<HeightCell> cells; // rows * columns ruter, rad for rad
+    glm::vec2 origin; // Hjrnet til rute (0, 0) i x og z
+    float spacing;
+    int columns, rows;
+    int firstCol, firstRow; // Frste rute i utsnittet
+};
+
+#endif // !HEIGHTGRID_H
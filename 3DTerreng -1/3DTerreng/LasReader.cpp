@@ -0,0 +1,242 @@
+#include "LasReader.h"
+#include "Parallel.h"
+
+#include <iostream>
+#include <cstring>
+#include <climits>
+#include <cctype>
+#include <algorithm>
+
+// Minste lengde p et punkt for hvert punktformat (0-10) i LAS 1.4-spesifikasjonen
+static const uint16_t minimumRecordLength[11] = { 20, 28, 26, 34, 57, 63, 30, 36, 38, 59, 67 };
+
+// Leser en verdi fra filen. LAS er little-endian, og verdiene er ikke ndvendigvis justert i minnet
+template <typename T>
+static T readValue(const char* data, size_t offset)
+{
+    T value;
+    std::memcpy(&value, data + offset, sizeof(T));
+    return value;
+}
+
+LasReader::LasReader()
+{
+    versionMajor = 0;
+    versionMinor = 0;
+    pointFormat = 0;
+    recordLength = 0;
+    offsetToPoints = 0;
+    pointCount = 0;
+    scale = glm::dvec3(1.0);
+    offset = glm::dvec3(0.0);
+}
+
+bool LasReader::IsLasFile(const std::string& filename)
+{
+    if (filename.size() < 4)
+    {
+        return false;
+    }
+
+    std::string extension = filename.substr(filename.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".las";
+}
+
+bool LasReader::Open(const std::string& filename)
+{
+    if (!file.Open(filename))
+    {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return false;
+    }
+
+    const char* data = file.Data();
+    size_t size = file.Size();
+
+    // Den offentlige headeren er minst 227 bytes (LAS 1.2)
+    if (size < 227 || std::memcmp(data, "LASF", 4) != 0)
+    {
+        std::cerr << "Error: " << filename << " is not a LAS file" << std::endl;
+        Close();
+        return false;
+    }
+
+    versionMajor = readValue<uint8_t>(data, 24);
+    versionMinor = readValue<uint8_t>(data, 25);
+    uint16_t headerSize = readValue<uint16_t>(data, 94);
+    offsetToPoints = readValue<uint32_t>(data, 96);
+    pointFormat = readValue<uint8_t>(data, 104);
+    recordLength = readValue<uint16_t>(data, 105);
+    pointCount = readValue<uint32_t>(data, 107);
+
+    scale = glm::dvec3(readValue<double>(data, 131), readValue<double>(data, 139), readValue<double>(data, 147));
+    offset = glm::dvec3(readValue<double>(data, 155), readValue<double>(data, 163), readValue<double>(data, 171));
+
+    // LAS 1.4 har et 64-bits punktantall, og det gamle feltet er 0 for punktformat 6-10
+    if (versionMinor >= 4 && headerSize >= 375 && size >= 375)
+    {
+        uint64_t extendedCount = readValue<uint64_t>(data, 247);
+        if (extendedCount > 0)
+        {
+            pointCount = extendedCount;
+        }
+    }
+
+    // De to verste bitene blir brukt av LAZ for  merke komprimerte filer
+    if (pointFormat & 0xC0)
+    {
+        std::cerr << "Error: " << filename << " is compressed (LAZ), which is not supported" << std::endl;
+        Close();
+        return false;
+    }
+
+    if (versionMajor != 1 || versionMinor < 2 || versionMinor > 4)
+    {
+        std::cerr << "Warning: LAS version " << int(versionMajor) << "." << int(versionMinor) << " is not 1.2-1.4, reading it anyway" << std::endl;
+    }
+
+    if (pointFormat > 10 || recordLength < minimumRecordLength[pointFormat])
+    {
+        std::cerr << "Error: Unsupported point format " << int(pointFormat) << " with record length " << recordLength << " in " << filename << std::endl;
+        Close();
+        return false;
+    }
+
+    if (offsetToPoints > size)
+    {
+        std::cerr << "Error: Point data offset is outside of " << filename << std::endl;
+        Close();
+        return false;
+    }
+
+    uint64_t available = (size - offsetToPoints) / recordLength;
+    if (pointCount > available)
+    {
+        std::cerr << "Warning: " << filename << " says it has " << pointCount << " points, but only " << available << " fit in the file" << std::endl;
+        pointCount = available;
+    }
+
+    std::cout << "LAS " << int(versionMajor) << "." << int(versionMinor) << ", point format " << int(pointFormat)
+        << ", point count: " << pointCount << std::endl;
+    return true;
+}
+
+void LasReader::Close()
+{
+    file.Close();
+}
+
+bool LasReader::ReadPoints(std::vector<glm::vec3>& points, glm::dvec3& center)
+{
+    if (!file.IsOpen())
+    {
+        return false;
+    }
+
+    const char* pointData = file.Data() + offsetToPoints;
+    size_t count = static_cast<size_t>(pointCount);
+
+    // Frste runde finner bounding boxen i heltallskoordinater. Headeren sin min/maks blir ikke brukt,
+    // fordi mange verkty skriver den feil
+    unsigned int chunks = threadCount();
+    std::vector<glm::ivec3> chunkMin(chunks, glm::ivec3(INT_MAX));
+    std::vector<glm::ivec3> chunkMax(chunks, glm::ivec3(INT_MIN));
+
+    parallelFor(count, chunks, [&](size_t first, size_t last, unsigned int chunk)
+    {
+        glm::ivec3 min(INT_MAX), max(INT_MIN);
+        for (size_t i = first; i < last; ++i)
+        {
+            const char* record = pointData + i * recordLength;
+            glm::ivec3 p(readValue<int32_t>(record, 0), readValue<int32_t>(record, 4), readValue<int32_t>(record, 8));
+            min = glm::min(min, p);
+            max = glm::max(max, p);
+        }
+        chunkMin[chunk] = min;
+        chunkMax[chunk] = max;
+    });
+
+    glm::ivec3 min(INT_MAX), max(INT_MIN);
+    for (unsigned int c = 0; c < chunks; ++c)
+    {
+        min = glm::min(min, chunkMin[c]);
+        max = glm::max(max, chunkMax[c]);
+    }
+
+    // LAS har Z opp, mens punktskyen har y opp. Aksene blir byttet p samme mte som for tekstfilen (x z y)
+    glm::dvec3 lasCenter = count > 0 ? (glm::dvec3(min) + glm::dvec3(max)) * 0.5 * scale + offset : offset;
+    center = glm::dvec3(lasCenter.x, lasCenter.z, lasCenter.y);
+
+    // Andre runde skalerer punktene og skriver dem rett inn i points
+    points.resize(count);
+    parallelFor(count, chunks, [&](size_t first, size_t last, unsigned int)
+    {
+        for (size_t i = first; i < last; ++i)
+        {
+            const char* record = pointData + i * recordLength;
+            glm::dvec3 p(readValue<int32_t>(record, 0), readValue<int32_t>(record, 4), readValue<int32_t>(record, 8));
+            p = p * scale + offset - lasCenter;
+            points[i] = glm::vec3(static_cast<float>(p.x), static_cast<float>(p.z), static_cast<float>(p.y));
+        }
+    });
+
+    return true;
+}
+
+bool LasReader::ReadQuantized(QuantizedPoints& points)
+{
+    if (!file.IsOpen())
+    {
+        return false;
+    }
+
+    // Byttet om p y og z som for de andre punktene
+    points.SetQuantization(glm::dvec3(offset.x, offset.z, offset.y), glm::dvec3(scale.x, scale.z, scale.y));
+
+    const char* pointData = file.Data() + offsetToPoints;
+    std::vector<glm::ivec3>& data = points.GetData();
+    data.resize(static_cast<size_t>(pointCount));
+    parallelFor(data.size(), [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const char* record = pointData + i * recordLength;
+            data[i] = glm::ivec3(readValue<int32_t>(record, 0), readValue<int32_t>(record, 8), readValue<int32_t>(record, 4));
+        }
+    });
+
+    return true;
+}
+
+bool LasReader::ReadPositions(size_t first, size_t count, glm::dvec3* positions)
+{
+    if (!file.IsOpen() || first + count > pointCount)
+    {
+        return false;
+    }
+
+    const char* pointData = file.Data() + offsetToPoints;
+    parallelFor(count, [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const char* record = pointData + (first + i) * recordLength;
+            glm::dvec3 p(readValue<int32_t>(record, 0), readValue<int32_t>(record, 4), readValue<int32_t>(record, 8));
+            p = p * scale + offset;
+            positions[i] = glm::dvec3(p.x, p.z, p.y);
+        }
+    });
+
+    return true;
+}
+
+uint64_t LasReader::GetPointCount() const
+{
+    return pointCount;
+}
+
+int LasReader::GetPointFormat() const
+{
+    return pointFormat;
+}
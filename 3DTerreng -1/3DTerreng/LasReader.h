@@ -0,0 +1,51 @@
+#ifndef LASREADER_H
+#define LASREADER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "MappedFile.h"
+#include "QuantizedPoints.h"
+
+// Leser binre LAS-filer (versjon 1.2 til 1.4, punktformat 0-10) direkte, uten  g via tekst.
+// Bare posisjonen (X, Y, Z) blir lest. Komprimerte filer (LAZ) stttes ikke.
+class LasReader
+{
+public:
+    LasReader();
+
+    bool Open(const std::string& filename); // pner filen og leser headeren. Returnerer false hvis filen ikke er en gyldig LAS-fil
+    void Close();
+
+    // Leser alle punktene inn i points og sentrerer dem rundt midten av bounding boxen.
+    // Sentreringen skjer i double fr punktene blir gjort om til float, s presisjonen blir ikke borte
+    bool ReadPoints(std::vector<glm::vec3>& points, glm::dvec3& center);
+
+    // Kopierer heltallskoordinatene rett inn i points, med scale og offset fra headeren som quantization
+    bool ReadQuantized(QuantizedPoints& points);
+
+    // Leser punktene [first, first + count) i originale koordinater med y opp. Brukes til  strmme filen i biter
+    bool ReadPositions(size_t first, size_t count, glm::dvec3* positions);
+
+    uint64_t GetPointCount() const; // Antall punkter i filen
+    int GetPointFormat() const;
+
+    static bool IsLasFile(const std::string& filename); // Sjekker filendelsen (.las)
+
+private:
+    MappedFile file;
+
+    uint8_t versionMajor;
+    uint8_t versionMinor;
+    uint8_t pointFormat;
+    uint16_t recordLength; // Antall bytes per punkt
+    uint32_t offsetToPoints; // Hvor punktene starter i filen
+    uint64_t pointCount;
+
+    glm::dvec3 scale; // Koordinat = heltall * scale + offset
+    glm::dvec3 offset;
+};
+
+#endif // !LASREADER_H
@@ -22,6 +22,9 @@ Camera camera(glm::vec3(10.0f, 10.0f, 50.0f));
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
+bool normalKeyPressed = false; // N var nede forrige bilde
+bool pickKeyPressed = false; // P var nede forrige bilde
+bool exportKeyPressed = false; // E var nede forrige bilde
 
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
@@ -76,6 +79,12 @@ int main()
 
 		processInput(window);
 
+		// N slr normalene av og p
+		bool normalKey = glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS;
+		if (normalKey && !normalKeyPressed)
+			punktSky.SetShowNormals(!punktSky.GetShowNormals());
+		normalKeyPressed = normalKey;
+
 		// Render
 		glClearColor(0.5f, 0.3f, 0.8f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -94,10 +103,34 @@ int main()
 		glm::mat4 model = glm::mat4(1.0f);
 		model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
 		shaderProgram.setMat4("model", model);
+
+		// P skriver ut punktet p terrenget midt p skjermen. Strlen fra kameraet blir gjort om til terrengets koordinater
+		bool pickKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+		if (pickKey && !pickKeyPressed)
+		{
+			glm::mat4 inverseModel = glm::inverse(model);
+			glm::vec3 origin = glm::vec3(inverseModel * glm::vec4(camera.Position, 1.0f));
+			glm::vec3 direction = glm::vec3(inverseModel * glm::vec4(camera.Front, 0.0f));
+			RayHit hit;
+			if (punktSky.IntersectRay(origin, direction, hit))
+			{
+				glm::dvec3 point = glm::dvec3(origin + direction * hit.distance) + punktSky.GetCenter();
+				std::cout << "Punkt p terrenget: " << point.x << ", " << point.y << ", " << point.z << std::endl;
+			}
+			else
+				std::cout << "Ingen treff p terrenget" << std::endl;
+		}
+		pickKeyPressed = pickKey;
+
+		// E skriver punktene til en fil som BSpline-prosjektet kan tilpasse en flate til
+		bool exportKey = glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS;
+		if (exportKey && !exportKeyPressed)
+			punktSky.ExportPoints("terreng_punkter.txt");
+		exportKeyPressed = exportKey;
 		
 		// Punktsky
 		punktSky.DrawPunktSky();
-		punktSky.DrawTriangles();
+		punktSky.DrawTriangles(projection, view, model, static_cast<float>(SCR_HEIGHT)); // LOD etter avstanden til kameraet
 		punktSky.DrawNormals();
 		
 		glfwSwapBuffers(window);
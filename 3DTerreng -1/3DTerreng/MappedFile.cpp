@@ -0,0 +1,154 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+    data = nullptr;
+    size = 0;
+    open = false;
+
+#ifdef _WIN32
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = nullptr;
+#else
+    fileDescriptor = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string& filename)
+{
+    Close();
+
+#ifdef _WIN32
+    // FILE_FLAG_SEQUENTIAL_SCAN gir Windows beskjed om  lese fremover i filen
+    fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize))
+    {
+        Close();
+        return false;
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+
+    // Tomme filer kan ikke kartlegges, men er likevel gyldige
+    if (size > 0)
+    {
+        mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mappingHandle == nullptr)
+        {
+            Close();
+            return false;
+        }
+
+        data = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        if (data == nullptr)
+        {
+            Close();
+            return false;
+        }
+    }
+#else
+    fileDescriptor = ::open(filename.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+    {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(fileDescriptor, &status) != 0)
+    {
+        Close();
+        return false;
+    }
+    size = static_cast<size_t>(status.st_size);
+
+    if (size > 0)
+    {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        if (mapping == MAP_FAILED)
+        {
+            Close();
+            return false;
+        }
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapping);
+    }
+#endif
+
+    open = true;
+    return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+    }
+    if (mappingHandle != nullptr)
+    {
+        CloseHandle(mappingHandle);
+        mappingHandle = nullptr;
+    }
+    if (fileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(fileHandle);
+        fileHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (data != nullptr)
+    {
+        munmap(const_cast<char*>(data), size);
+    }
+    if (fileDescriptor >= 0)
+    {
+        ::close(fileDescriptor);
+        fileDescriptor = -1;
+    }
+#endif
+
+    data = nullptr;
+    size = 0;
+    open = false;
+}
+
+const char* MappedFile::Data() const
+{
+    return data;
+}
+
+size_t MappedFile::Size() const
+{
+    return size;
+}
+
+bool MappedFile::IsOpen() const
+{
+    return open;
+}
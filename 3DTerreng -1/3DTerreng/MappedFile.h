@@ -0,0 +1,38 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+// Minnekartlagt fil som bare leses. Innholdet blir lest inn av operativsystemet etter hvert som det brukes,
+// s store filer kan parses uten at hele filen kopieres inn i en buffer frst.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& filename); // Kartlegger filen, returnerer false hvis den ikke kan pnes
+    void Close(); // Frigjr kartleggingen
+
+    const char* Data() const; // Peker til starten av filen (nullptr for tomme filer)
+    size_t Size() const; // Strrelsen p filen i bytes
+    bool IsOpen() const;
+
+private:
+    const char* data;
+    size_t size;
+    bool open;
+
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fileDescriptor;
+#endif
+};
+
+#endif // !MAPPEDFILE_H
@@ -0,0 +1,168 @@
+#include "PointParser.h"
+#include "Parallel.h"
+
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+const char* findLineEnd(const char* p, const char* end)
+{
+    const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return newline != nullptr ? newline : end;
+}
+
+// Hopper over mellomrom p samme mte som >> gjr
+static const char* skipWhitespace(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\v' || *p == '\f'))
+    {
+        ++p;
+    }
+    return p;
+}
+
+// Leser ett tall, og godtar et ledende '+' slik som >> gjr
+template <typename T>
+static const char* parseNumber(const char* p, const char* end, T& value)
+{
+    p = skipWhitespace(p, end);
+    if (p < end && *p == '+')
+    {
+        ++p;
+    }
+
+    std::from_chars_result result = std::from_chars(p, end, value);
+    return result.ec == std::errc() ? result.ptr : nullptr;
+}
+
+// Returnerer false hvis linjen ikke har tre tall
+template <typename Vector>
+static bool parseLine(const char* p, const char* end, Vector& position)
+{
+    p = parseNumber(p, end, position.x);
+    if (p == nullptr)
+    {
+        return false;
+    }
+
+    p = parseNumber(p, end, position.z);
+    if (p == nullptr)
+    {
+        return false;
+    }
+
+    return parseNumber(p, end, position.y) != nullptr;
+}
+
+bool parsePointLine(const char* p, const char* end, glm::vec3& position)
+{
+    return parseLine(p, end, position);
+}
+
+bool parsePointLine(const char* p, const char* end, glm::dvec3& position)
+{
+    return parseLine(p, end, position);
+}
+
+std::vector<PointChunk> splitIntoChunks(const char* begin, const char* end, size_t maxChunks)
+{
+    // Sm filer blir lest av n trd
+    const size_t minChunkSize = 1 << 20;
+    size_t dataSize = static_cast<size_t>(end - begin);
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(maxChunks, dataSize / minChunkSize));
+
+    std::vector<PointChunk> chunks;
+    const char* chunkBegin = begin;
+    for (size_t c = 1; c <= chunkCount && chunkBegin < end; ++c)
+    {
+        const char* chunkEnd = end;
+        if (c < chunkCount)
+        {
+            chunkEnd = findLineEnd(std::max(chunkBegin, begin + dataSize * c / chunkCount), end);
+            chunkEnd = chunkEnd < end ? chunkEnd + 1 : end;
+        }
+
+        PointChunk chunk;
+        chunk.begin = chunkBegin;
+        chunk.end = chunkEnd;
+        chunks.push_back(chunk);
+        chunkBegin = chunkEnd;
+    }
+
+    return chunks;
+}
+
+void countLines(std::vector<PointChunk>& chunks)
+{
+    parallelFor(chunks.size(), static_cast<unsigned int>(chunks.size()), [&](size_t first, size_t last, unsigned int)
+    {
+        for (size_t c = first; c < last; ++c)
+        {
+            PointChunk& chunk = chunks[c];
+            chunk.lineCount = std::count(chunk.begin, chunk.end, '\n');
+            if (chunk.end[-1] != '\n')
+            {
+                chunk.lineCount++; // Siste linje i filen mangler linjeskift
+            }
+        }
+    });
+}
+
+// Felles parser for alle utdataformatene. Linjen blir lest som Position og lagret med store(position)
+template <typename Position, typename Output, typename Store>
+static void parseChunksAs(std::vector<PointChunk>& chunks, Output* output, Store store)
+{
+    parallelFor(chunks.size(), static_cast<unsigned int>(chunks.size()), [&](size_t first, size_t last, unsigned int)
+    {
+        for (size_t c = first; c < last; ++c)
+        {
+            PointChunk& chunk = chunks[c];
+            Output* chunkOutput = output + chunk.firstPoint;
+            size_t localLine = 0;
+
+            for (const char* p = chunk.begin; p < chunk.end; ++localLine)
+            {
+                const char* lineEnd = findLineEnd(p, chunk.end);
+                Position position;
+
+                if (parseLine(p, lineEnd, position))
+                {
+                    // Oppdaterer min- og maksverdier for  finne bounding box
+                    chunk.min = glm::min(chunk.min, glm::dvec3(position));
+                    chunk.max = glm::max(chunk.max, glm::dvec3(position));
+                    chunkOutput[chunk.pointCount++] = store(position);
+                }
+                else
+                {
+                    chunk.errors.emplace_back(localLine, std::string(p, lineEnd));
+                }
+
+                p = lineEnd < chunk.end ? lineEnd + 1 : chunk.end;
+            }
+        }
+    });
+}
+
+void parseChunks(std::vector<PointChunk>& chunks, glm::vec3* output)
+{
+    parseChunksAs<glm::vec3>(chunks, output, [](const glm::vec3& position) { return position; });
+}
+
+void parseChunks(std::vector<PointChunk>& chunks, glm::dvec3* output)
+{
+    parseChunksAs<glm::dvec3>(chunks, output, [](const glm::dvec3& position) { return position; });
+}
+
+void parseChunks(std::vector<PointChunk>& chunks, glm::ivec3* output, const QuantizedPoints& quantization)
+{
+    parseChunksAs<glm::dvec3>(chunks, output, [&](const glm::dvec3& position) { return quantization.Quantize(position); });
+}
+
+void reportErrors(const PointChunk& chunk, size_t firstLineNumber)
+{
+    for (const auto& error : chunk.errors)
+    {
+        std::cerr << "Error: Failed to read coordinates on line " << firstLineNumber + error.first << ": " << error.second << std::endl;
+    }
+}
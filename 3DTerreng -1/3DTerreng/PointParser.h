@@ -0,0 +1,35 @@
+#ifndef POINTPARSER_H
+#define POINTPARSER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <float.h>
+
+#include "QuantizedPoints.h"
+
+// En bit av en tekstfil med punkter ("x z y" per linje) som blir parset av n trd. Biten starter alltid p en ny linje
+struct PointChunk
+{
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    size_t lineCount = 0; // Antall linjer i biten
+    size_t firstPoint = 0; // Hvor i utdataene biten skriver sine punkter
+    size_t pointCount = 0; // Antall punkter som ble lest
+    glm::dvec3 min = glm::dvec3(DBL_MAX);
+    glm::dvec3 max = glm::dvec3(-DBL_MAX);
+    std::vector<std::pair<size_t, std::string>> errors; // Linjer som ikke kunne leses (lokalt linjenummer, innhold)
+};
+
+const char* findLineEnd(const char* p, const char* end); // Finner slutten av linjen som starter i p ('\n' eller end)
+bool parsePointLine(const char* p, const char* end, glm::vec3& position); // Leser n linje med "x z y"
+bool parsePointLine(const char* p, const char* end, glm::dvec3& position); // Samme i double, for koordinater som trenger full presisjon
+
+std::vector<PointChunk> splitIntoChunks(const char* begin, const char* end, size_t maxChunks); // Deler [begin, end) i biter som slutter rett etter et linjeskift
+void countLines(std::vector<PointChunk>& chunks); // Teller linjene i hver bit parallelt
+void parseChunks(std::vector<PointChunk>& chunks, glm::vec3* output); // Parser bitene parallelt, bit c skriver til output + firstPoint
+void parseChunks(std::vector<PointChunk>& chunks, glm::dvec3* output);
+void parseChunks(std::vector<PointChunk>& chunks, glm::ivec3* output, const QuantizedPoints& quantization); // Leser i double og lagrer som heltall
+void reportErrors(const PointChunk& chunk, size_t firstLineNumber); // Skriver ut linjene som ikke kunne leses
+
+#endif // !POINTPARSER_H
@@ -1,46 +1,255 @@
 #include "PunktSky.h"
 
-PunktSky::PunktSky(const std::string& filename) 
+// Omtrent hvor mye minne hvert punkt bruker nr hele punktskyen blir triangulert i minnet.
+// Gridet har ett hjrne per rute, s det er punktet selv som teller mest
+static const uint64_t bytesPerPointInMemory = sizeof(glm::vec3) + sizeof(HeightCell);
+
+// Delaunay-trianguleringen trenger alle punktene som hjrner, med normaler, to trekanter og naboene deres per punkt
+static const uint64_t bytesPerPointDelaunay = 3 * sizeof(glm::vec3) + sizeof(glm::dvec2) + 2 * 6 * sizeof(int) + 6 * sizeof(unsigned int);
+
+// Skriver ut linjene som ikke kunne leses, og flytter punktene fra alle bitene tett sammen i output
+template <typename Point>
+static void mergeChunks(const std::vector<PointChunk>& chunks, std::vector<Point>& output, glm::dvec3& min, glm::dvec3& max)
+{
+    min = glm::dvec3(DBL_MAX);
+    max = glm::dvec3(-DBL_MAX);
+    size_t pointCount = 0;
+    size_t lineNumber = 1;
+    for (const auto& chunk : chunks)
+    {
+        reportErrors(chunk, lineNumber + 1);
+
+        if (pointCount != chunk.firstPoint)
+        {
+            std::copy(output.begin() + chunk.firstPoint, output.begin() + chunk.firstPoint + chunk.pointCount, output.begin() + pointCount);
+        }
+
+        min = glm::min(min, chunk.min);
+        max = glm::max(max, chunk.max);
+        pointCount += chunk.pointCount;
+        lineNumber += chunk.lineCount;
+    }
+    output.resize(pointCount);
+}
+
+// Deler teksten i biter, teller linjene og gir hver bit sin plass i utdataene. Returnerer antall linjer
+static size_t prepareChunks(std::vector<PointChunk>& chunks, const char* begin, const char* end)
+{
+    chunks = splitIntoChunks(begin, end, threadCount() * 4);
+    countLines(chunks);
+
+    size_t lineCount = 0;
+    for (auto& chunk : chunks)
+    {
+        chunk.firstPoint = lineCount;
+        lineCount += chunk.lineCount;
+    }
+    return lineCount;
+}
+
+PunktSky::PunktSky(const std::string& filename, size_t memoryBudget, PointStorage storage, TriangulationMode triangulation) 
+    : storage(storage), triangulation(triangulation)
 {
     VAO = 0;
     VBO = 0;
     EBO = 0;
+    pointVAO = 0;
+    pointVBO = 0;
     normalVAO = 0;
     normalVBO = 0;
+    showNormals = true;
+    normalLinesDirty = true;
+    bvhDirty = true;
+    normalLength = 2.0f;
+    normalLineVertexCount = 0;
+    pointCount = 0;
+
+    gridSpacing = 10.0f;
+    maxError = 0.5f;
+    center = glm::dvec3(0.0);
+    boundsMin = glm::vec3(0.0f);
+    boundsMax = glm::vec3(0.0f);
+
+    uint64_t estimatedPoints = StreamingTerrain::EstimatePointCount(filename);
+    if (triangulation == DELAUNAY_TRIANGULATION && estimatedPoints * bytesPerPointDelaunay > memoryBudget)
+    {
+        std::cerr << "Warning: Too many points for Delaunay triangulation within the memory budget, using the grid instead" << std::endl;
+        this->triangulation = GRID_TRIANGULATION;
+    }
+
+    bool outOfCore = estimatedPoints * bytesPerPointInMemory > memoryBudget;
+    if (this->triangulation == ADAPTIVE_TRIANGULATION && outOfCore)
+    {
+        std::cerr << "Warning: Adaptive triangulation needs the whole height grid in memory, using the grid instead" << std::endl;
+        this->triangulation = GRID_TRIANGULATION;
+    }
+
+    // Hvis kildefilen ikke er endret siden sist, blir terrenget lastet rett fra cachen. En cache bygd flis for flis
+    // har bare hjrnene i rutenettet som punkter, s den blir bare brukt nr terrenget fortsatt m strmmes, og omvendt
+    std::string cachePath = TerrainCache::CachePath(filename);
+    uint64_t sourceHash = 0;
+    uint64_t sourceSize = 0;
+    bool hashed = TerrainCache::HashFile(filename, sourceHash, sourceSize);
 
-    loadAndCenterPoints(filename); // Punktskydata blir lasta inn fra filen og punktene blir sentrert rundt origo
-    generateRegularTriangulation(); // Generer triangulering av punktene
+    TerrainCache cache;
+    if (hashed && cache.Open(cachePath, sourceHash, sourceSize, gridSpacing, storage, this->triangulation, outOfCore))
+    {
+        loadFromCache(cache);
+        return;
+    }
 
+    if (outOfCore)
+    {
+        // For stor for minnet, terrenget blir bygd flis for flis fra disk
+        StreamingTerrain streaming(gridSpacing, memoryBudget, storage == QUANTIZED_POINTS);
+        streaming.Build(filename, vertices, normals, indices, center, boundsMin, boundsMax, &heightGrid);
+        points = vertices; // De opprinnelige punktene ligger ikke i minnet
+    }
+    else
+    {
+        // Punktskydata blir lasta inn fra filen og punktene blir sentrert rundt origo
+        if (storage == QUANTIZED_POINTS)
+        {
+            loadQuantizedPoints(filename);
+        }
+        else if (LasReader::IsLasFile(filename))
+        {
+            loadLasPoints(filename);
+        }
+        else
+        {
+            loadAndCenterPoints(filename);
+        }
+
+        if (this->triangulation == DELAUNAY_TRIANGULATION)
+        {
+            generateDelaunayTriangulation();
+        }
+        else
+        {
+            generateRegularTriangulation(); // Generer triangulering av punktene
+        }
+    }
+
+    if (hashed && (!points.empty() || quantized.Size() > 0))
+    {
+        TerrainCache::Write(cachePath, sourceHash, sourceSize, gridSpacing, storage, this->triangulation, outOfCore, center, boundsMin, boundsMax, points, vertices, normals, indices, quantized, heightGrid);
+    }
+
+    setupBuffers(points.data(), vertices.data(), normals.data(), indices.data());
+}
+
+// Kopierer terrenget fra den minnekartlagte cachen. Alt ligger i samme format som i minnet,
+// s det er bare minnekopier og ingen lkker over hvert punkt
+void PunktSky::loadFromCache(const TerrainCache& cache)
+{
+    const TerrainCacheHeader& header = cache.GetHeader();
+    size_t pointCount = static_cast<size_t>(header.pointCount);
+    size_t vertexCount = static_cast<size_t>(header.vertexCount);
+    size_t indexCount = static_cast<size_t>(header.indexCount);
+
+    points.assign(cache.GetPoints(), cache.GetPoints() + pointCount);
+    vertices.assign(cache.GetVertices(), cache.GetVertices() + vertexCount);
+    normals.assign(cache.GetNormals(), cache.GetNormals() + vertexCount);
+    indices.assign(cache.GetIndices(), cache.GetIndices() + indexCount);
+    center = header.center;
+
+    quantized.SetQuantization(header.center, header.quantizationScale);
+    quantized.GetData().assign(cache.GetQuantizedPoints(), cache.GetQuantizedPoints() + static_cast<size_t>(header.quantizedCount));
+    boundsMin = header.boundsMin;
+    boundsMax = header.boundsMax;
+
+    if (header.gridColumns > 0 && header.gridRows > 0)
+    {
+        heightGrid.Reset(header.gridOrigin, header.gridSpacing, header.gridColumns, header.gridRows);
+        std::copy(cache.GetGridCells(), cache.GetGridCells() + heightGrid.GetCells().size(), heightGrid.GetCells().begin());
+    }
+
+    std::cout << "Loaded " << points.size() << " points and " << indices.size() / 3 << " triangles from cache, centered around "
+        << center.x << ", " << center.y << ", " << center.z << std::endl;
+
+    // Laster opp rett fra cachefilen
+    setupBuffers(cache.GetPoints(), cache.GetVertices(), cache.GetNormals(), cache.GetIndices());
+}
+
+// Hjrnene og normalene i trianguleringen ligger etter hverandre i samme VBO (alle posisjoner frst, s alle normaler),
+// s de kan lastes opp direkte uten  flettes sammen frst. Punktskyen har sin egen VAO og VBO med bare posisjoner
+void PunktSky::setupBuffers(const glm::vec3* pointPositions, const glm::vec3* vertexPositions, const glm::vec3* vertexNormals, const unsigned int* triangleIndices)
+{
     // Create VAO and VBO
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
+    // Chunkene med detaljniv lages fra hydekartet, som ogs finnes nr terrenget kommer fra cachen eller er bygd fra disk.
+    // Da blir bare chunkene lastet opp, hele trianguleringen ligger fortsatt i minnet til strler, normaler og baking
+    if (triangulation == GRID_TRIANGULATION && !heightGrid.GetCells().empty())
+    {
+        lod.Build(heightGrid);
+        lod.Upload();
+    }
+    if (lod.IsEmpty())
+    {
+        uploadMesh(vertexPositions, vertexNormals, triangleIndices);
+    }
+
+    // Punktskyen
+    glGenVertexArrays(1, &pointVAO);
+    glGenBuffers(1, &pointVBO);
 
-    //Bufferhndtering, fordi det reeduserer hvor mange ganger data m g igjennom CPU og GPU
-    std::vector<float> vertexData;
-    for (size_t i = 0; i < points.size(); ++i)
+    glBindVertexArray(pointVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, pointVBO);
+    if (points.empty() && quantized.Size() > 0)
+    {
+        // Bare heltallene ligger i minnet, s de blir gjort om og lastet opp i biter gjennom n liten buffer
+        const size_t batch = size_t(1) << 20;
+        pointCount = quantized.Size();
+        glBufferData(GL_ARRAY_BUFFER, pointCount * sizeof(glm::vec3), nullptr, GL_STATIC_DRAW);
+        std::vector<glm::vec3> positions(std::min(batch, pointCount));
+        for (size_t first = 0; first < pointCount; first += batch)
+        {
+            size_t count = std::min(batch, pointCount - first);
+            quantized.Dequantize(first, count, center, positions.data());
+            glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::vec3), count * sizeof(glm::vec3), positions.data());
+        }
+    }
+    else
     {
-        vertexData.push_back(points[i].x);
-        vertexData.push_back(points[i].y);
-        vertexData.push_back(points[i].z);
-        vertexData.push_back(normals[i].x);
-        vertexData.push_back(normals[i].y);
-        vertexData.push_back(normals[i].z);
+        pointCount = points.size();
+        glBufferData(GL_ARRAY_BUFFER, pointCount * sizeof(glm::vec3), pointPositions, GL_STATIC_DRAW);
     }
 
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0); // Position
+    glEnableVertexAttribArray(0);
+
+}
+
+// Laster opp trianguleringen til VAO, VBO og EBO som allerede finnes
+void PunktSky::uploadMesh(const glm::vec3* vertexPositions, const glm::vec3* vertexNormals, const unsigned int* triangleIndices)
+{
+    size_t positionBytes = vertices.size() * sizeof(glm::vec3);
+
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(float), &vertexData[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, 2 * positionBytes, nullptr, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, positionBytes, vertexPositions);
+    glBufferSubData(GL_ARRAY_BUFFER, positionBytes, positionBytes, vertexNormals);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), triangleIndices, GL_STATIC_DRAW);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0); // Position
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0); // Position
     glEnableVertexAttribArray(0);
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float))); // Normal
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)positionBytes); // Normal
     glEnableVertexAttribArray(1);
+
+    normalLinesDirty = true;
+    bvhDirty = true;
+    if (!bakedHeights.IsEmpty())
+    {
+        bakedHeights.Bake(vertices, normals, indices, bakedHeights.GetColumns(), bakedHeights.GetRows());
+    }
 }
 
 PunktSky::~PunktSky() 
@@ -48,13 +257,21 @@ PunktSky::~PunktSky()
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
+    glDeleteVertexArrays(1, &pointVAO);
+    glDeleteBuffers(1, &pointVBO);
+    if (normalVAO != 0)
+    {
+        glDeleteVertexArrays(1, &normalVAO);
+        glDeleteBuffers(1, &normalVBO);
+    }
 
 }
 
 void PunktSky::DrawPunktSky() // Rendrer punktskyen med individuelle punkter
 {
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_POINTS, 0, points.size());
+    glBindVertexArray(pointVAO);
+    glVertexAttrib3f(1, 0.0f, 1.0f, 0.0f); // Punktene har ingen normal, s alle peker rett opp
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(pointCount));
 }
 
 const std::vector<glm::vec3>& PunktSky::GetPoints() const 
@@ -62,174 +279,478 @@ const std::vector<glm::vec3>& PunktSky::GetPoints() const
     return points;
 }
 
+const QuantizedPoints& PunktSky::GetQuantizedPoints() const
+{
+    return quantized;
+}
+
+bool PunktSky::ExportPoints(const std::string& filename) const
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return false;
+    }
+
+    bool quantizedOnly = points.empty() && quantized.Size() > 0;
+    size_t count = quantizedOnly ? quantized.Size() : points.size();
+    file << count << "\n";
+
+    // Korteste tekst som leses tilbake til samme float, skrevet gjennom n buffer per bit
+    const size_t batch = size_t(1) << 16;
+    std::vector<glm::vec3> positions(quantizedOnly ? std::min(batch, count) : 0);
+    std::vector<char> text(batch * 3 * 32);
+    for (size_t first = 0; first < count; first += batch)
+    {
+        size_t batchCount = std::min(batch, count - first);
+        const glm::vec3* source = points.data() + first;
+        if (quantizedOnly)
+        {
+            quantized.Dequantize(first, batchCount, center, positions.data());
+            source = positions.data();
+        }
+
+        char* out = text.data();
+        char* end = text.data() + text.size();
+        for (size_t i = 0; i < batchCount; ++i)
+        {
+            out = std::to_chars(out, end, source[i].x).ptr;
+            *out++ = ' ';
+            out = std::to_chars(out, end, source[i].z).ptr;
+            *out++ = ' ';
+            out = std::to_chars(out, end, source[i].y).ptr;
+            *out++ = '\n';
+        }
+        file.write(text.data(), out - text.data());
+    }
+
+    std::cout << "Exported " << count << " points to " << filename << std::endl;
+    return file.good();
+}
+
+const glm::dvec3& PunktSky::GetCenter() const
+{
+    return center;
+}
+
+const HeightGrid& PunktSky::GetHeightGrid() const
+{
+    return heightGrid;
+}
+
+void PunktSky::SetMaxError(float error)
+{
+    maxError = error;
+    if (triangulation != ADAPTIVE_TRIANGULATION || heightGrid.GetCells().empty())
+    {
+        return;
+    }
+
+    // Feilhierarkiet blir bare regnet ut n gang, etter det er hver ny feilgrense n runde over trekantene
+    if (rtin.GetSize() == 0)
+    {
+        rtin.Build(heightGrid);
+    }
+    rtin.Extract(maxError, vertices, normals, indices);
+    uploadMesh(vertices.data(), normals.data(), indices.data());
+}
+
+float PunktSky::GetMaxError() const
+{
+    return maxError;
+}
+
 void PunktSky::DrawTriangles() // Rendrer trianguleringen basert p indekser
 {
+    if (!lod.IsEmpty())
+    {
+        lod.Draw(); // Hele trianguleringen er ikke lastet opp
+        return;
+    }
+
     glBindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
 }
 
+void PunktSky::DrawTriangles(const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model, float screenHeight)
+{
+    if (lod.IsEmpty())
+    {
+        DrawTriangles();
+        return;
+    }
+
+    // Kameraet og synsfeltet i terrengets koordinater, s avstandene stemmer med hydeavvikene i chunkene
+    glm::mat4 modelView = view * model;
+    glm::vec3 cameraPosition = glm::vec3(glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    float pixelScale = screenHeight * 0.5f * projection[1][1];
+
+    lod.Select(projection * modelView, cameraPosition, pixelScale);
+    lod.Draw();
+}
+
+void PunktSky::SetLodPixelError(float pixels)
+{
+    lod.SetPixelError(pixels);
+}
+
+const TerrainLod& PunktSky::GetLod() const
+{
+    return lod;
+}
+
+bool PunktSky::IntersectRay(const glm::vec3& origin, const glm::vec3& direction, RayHit& hit, float maxDistance)
+{
+    if (bvhDirty)
+    {
+        bvh.Build(vertices, indices);
+        bvhDirty = false;
+    }
+    return bvh.Intersect(origin, direction, hit, maxDistance);
+}
+
+void PunktSky::IntersectRays(const glm::vec3* origins, const glm::vec3* directions, size_t count, RayHit* hits, float maxDistance)
+{
+    if (bvhDirty)
+    {
+        bvh.Build(vertices, indices);
+        bvhDirty = false;
+    }
+    bvh.IntersectRays(origins, directions, count, hits, maxDistance);
+}
+
+bool PunktSky::BakeHeightField(int columns, int rows)
+{
+    return bakedHeights.Bake(vertices, normals, indices, columns, rows);
+}
+
+const BakedHeightField& PunktSky::GetBakedHeightField() const
+{
+    return bakedHeights;
+}
+
 void PunktSky::DrawNormals() // Normalvektoren blir tegnet som linjer
 {
-    glGenVertexArrays(1, &normalVAO);
-    glGenBuffers(1, &normalVBO);
+    if (!showNormals)
+    {
+        return;
+    }
+
+    if (normalLinesDirty)
+    {
+        uploadNormalLines();
+    }
+
+    glBindVertexArray(normalVAO);
+    glVertexAttrib3f(1, 0.0f, 1.0f, 0.0f); // Linjene har ingen egen normal, som punktene
+    glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(normalLineVertexCount));
+}
 
-    std::vector<glm::vec3> normalLines;
-    for (size_t i = 0; i < points.size(); ++i)
+// Linjene blir bare laget nr trianguleringen eller lengden er endret, og bufferet blir gjenbrukt
+void PunktSky::uploadNormalLines()
+{
+    if (normalVAO == 0)
     {
-        normalLines.push_back(points[i]);
-        normalLines.push_back(points[i] + normals[i] * 2.0f);
+        glGenVertexArrays(1, &normalVAO);
+        glGenBuffers(1, &normalVBO);
     }
 
+    std::vector<glm::vec3> normalLines(vertices.size() * 2);
+    parallelFor(vertices.size(), [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            normalLines[i * 2] = vertices[i];
+            normalLines[i * 2 + 1] = vertices[i] + normals[i] * normalLength;
+        }
+    });
+
     glBindVertexArray(normalVAO);
     glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
-    glBufferData(GL_ARRAY_BUFFER, normalLines.size() * sizeof(glm::vec3), &normalLines[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, normalLines.size() * sizeof(glm::vec3), normalLines.data(), GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
     glEnableVertexAttribArray(0);
 
-    glBindVertexArray(normalVAO);
-    glDrawArrays(GL_LINES, 0, normalLines.size());
+    normalLineVertexCount = normalLines.size();
+    normalLinesDirty = false;
+}
+
+void PunktSky::SetShowNormals(bool show)
+{
+    showNormals = show;
+}
+
+bool PunktSky::GetShowNormals() const
+{
+    return showNormals;
+}
+
+void PunktSky::SetNormalLength(float length)
+{
+    if (length != normalLength)
+    {
+        normalLength = length;
+        normalLinesDirty = true;
+    }
+}
 
-    glDeleteVertexArrays(1, &normalVAO);
-    glDeleteBuffers(1, &normalVBO);
+float PunktSky::GetNormalLength() const
+{
+    return normalLength;
 }
 
-// Leser punktskydata fra filen
+// Leser punktskydata fra filen.
+// Filen blir minnekartlagt og delt i biter som starter p en ny linje. Hver bit blir parset p sin egen trd
+// rett inn i points, og resultatene blir sltt sammen i samme rekkeflge som i filen.
 void PunktSky::loadAndCenterPoints(const std::string& filename) 
 {
-    std::ifstream file(filename);
-    if (!file.is_open()) 
+    MappedFile file;
+    if (!file.Open(filename)) 
     {
         std::cerr << "Error: Unable to open file " << filename << std::endl;
         return;
     }
 
-    glm::vec3 min(FLT_MAX), max(-FLT_MAX);
-    std::string line;
-
-   
-    if (std::getline(file, line)) 
+    const char* begin = file.Data();
+    const char* end = begin + file.Size();
+    if (begin == end)
     {
-        std::cout << "Point count header: " << line << std::endl;
+        return;
     }
 
+    // Frste linje er antall punkter
+    const char* headerEnd = findLineEnd(begin, end);
+    std::cout << "Point count header: " << std::string(begin, headerEnd) << std::endl;
+    const char* dataBegin = headerEnd < end ? headerEnd + 1 : end;
+
+    // Deler filen i biter som slutter rett etter et linjeskift, og teller linjene i hver bit
+    // slik at alle punktene kan skrives rett inn i points uten  kopieres
+    std::vector<PointChunk> chunks;
+    points.resize(prepareChunks(chunks, dataBegin, end));
+
     // Leser koordinatene fra filen
-    int lineNumber = 1;
-    while (std::getline(file, line)) 
-    {
-        lineNumber++;
-        glm::vec3 position;
-        std::stringstream ss(line);
-        ss >> position.x >> position.z >> position.y;
+    parseChunks(chunks, points.data());
+
+    // Slr sammen bitene: flytter punktene tett sammen og skriver ut feilene med linjenummer fra filen
+    glm::dvec3 bounds[2];
+    mergeChunks(chunks, points, bounds[0], bounds[1]);
+    glm::vec3 min(bounds[0]), max(bounds[1]);
 
-        if (ss.fail()) 
+    file.Close(); // Lukker filen
+
+    // Beregner midtpunktet og justerer alle punktene
+    glm::vec3 middle = (min + max) / 2.0f;
+    parallelFor(points.size(), [&](size_t first, size_t last, unsigned int)
+    {
+        for (size_t i = first; i < last; ++i)
         {
-            std::cerr << "Error: Failed to read coordinates on line " << lineNumber << ": " << line << std::endl;
-            continue;
+            points[i] -= middle;
         }
+    });
+    center = glm::dvec3(middle);
 
-        // Oppdaterer min- og maksverdier for  finne bounding box
-        min = glm::min(min, position);
-        max = glm::max(max, position);
-        points.push_back(position);
-    }
+    std::cout << "Loaded " << points.size() << " points centered around "
+        << center.x << ", " << center.y << ", " << center.z << std::endl;
+}
 
-    file.close(); // Lukker filen
+// Leser punktskydata fra en binr LAS-fil
+void PunktSky::loadLasPoints(const std::string& filename)
+{
+    LasReader reader;
+    if (!reader.Open(filename))
+    {
+        return;
+    }
 
-    // Beregner midtpunktet og justerer alle punktene
-    glm::vec3 center = (min + max) / 2.0f;
-    for (auto& position : points) 
+    if (!reader.ReadPoints(points, center))
     {
-        position -= center;
+        std::cerr << "Error: Failed to read points from " << filename << std::endl;
+        return;
     }
 
     std::cout << "Loaded " << points.size() << " points centered around "
         << center.x << ", " << center.y << ", " << center.z << std::endl;
 }
 
+// Leser punktene i full presisjon. Tekst blir parset i double og lagret som heltall i millimeter,
+// LAS-heltallene blir kopiert rett over med scale og offset fra headeren
+void PunktSky::loadQuantizedPoints(const std::string& filename)
+{
+    if (LasReader::IsLasFile(filename))
+    {
+        LasReader reader;
+        if (!reader.Open(filename) || !reader.ReadQuantized(quantized))
+        {
+            return;
+        }
+    }
+    else
+    {
+        MappedFile file;
+        if (!file.Open(filename))
+        {
+            std::cerr << "Error: Unable to open file " << filename << std::endl;
+            return;
+        }
+
+        const char* begin = file.Data();
+        const char* end = begin + file.Size();
+        if (begin == end)
+        {
+            return;
+        }
+
+        const char* headerEnd = findLineEnd(begin, end);
+        std::cout << "Point count header: " << std::string(begin, headerEnd) << std::endl;
+        const char* dataBegin = headerEnd < end ? headerEnd + 1 : end;
+
+        // Bruker det frste gyldige punktet (rundet til hele meter) som origin, s heltallene holder seg sm
+        glm::dvec3 origin(0.0);
+        for (const char* p = dataBegin; p < end; )
+        {
+            const char* lineEnd = findLineEnd(p, end);
+            if (parsePointLine(p, lineEnd, origin))
+            {
+                break;
+            }
+            p = lineEnd < end ? lineEnd + 1 : end;
+        }
+        quantized.SetQuantization(glm::round(origin), glm::dvec3(0.001));
+
+        std::vector<PointChunk> chunks;
+        quantized.GetData().resize(prepareChunks(chunks, dataBegin, end));
+        parseChunks(chunks, quantized.GetData().data(), quantized);
+
+        glm::dvec3 min, max;
+        mergeChunks(chunks, quantized.GetData(), min, max);
+    }
+
+    // Flytter origin til midten av punktskyen. Punktene blir bare gjort om til float i biter nr de trengs
+    // (hydekartet, Delaunay og opplastingen), s det ligger ingen float-kopi ved siden av heltallene
+    quantized.Recenter();
+    center = quantized.GetOrigin();
+
+    std::cout << "Loaded " << quantized.Size() << " quantized points centered around "
+        << center.x << ", " << center.y << ", " << center.z << std::endl;
+}
+
 void PunktSky::generateRegularTriangulation()
 {
+    bool quantizedOnly = storage == QUANTIZED_POINTS && points.empty();
+    size_t pointTotal = quantizedOnly ? quantized.Size() : points.size();
+
+    // Finner bounding boxen parallelt, max og min finner maksimum og minimum koordinater for  finne punktskyen
+    unsigned int chunks = threadCount();
+    std::vector<glm::vec3> chunkMin(chunks, glm::vec3(FLT_MAX));
+    std::vector<glm::vec3> chunkMax(chunks, glm::vec3(-FLT_MAX));
+    parallelFor(points.size(), chunks, [&](size_t begin, size_t end, unsigned int chunk)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            chunkMin[chunk] = glm::min(chunkMin[chunk], points[i]);
+            chunkMax[chunk] = glm::max(chunkMax[chunk], points[i]);
+        }
+    });
+
     glm::vec3 min(FLT_MAX), max(-FLT_MAX);
-    for (const auto& point : points)
+    for (unsigned int c = 0; c < chunks; ++c)
     {
-        min = glm::min(min, point);
-        max = glm::max(max, point);
-        // max og min finner maksimum og minimum koordinater for  finne punktskyen
+        min = glm::min(min, chunkMin[c]);
+        max = glm::max(max, chunkMax[c]);
     }
 
-    float gridSpacing = 10.0f;
+    if (quantizedOnly)
+    {
+        quantized.Bounds(center, min, max);
+    }
+
+    boundsMin = min;
+    boundsMax = max;
+    if (pointTotal == 0)
+    {
+        return;
+    }
 
     // Beregner grid-dimensjoner
     int gridWidth = static_cast<int>((max.x - min.x) / gridSpacing) + 1;
     int gridHeight = static_cast<int>((max.z - min.z) / gridSpacing) + 1;
 
-    // Oppretter griden for  kartlegge punktene
-    std::vector<std::vector<int>> grid(gridWidth, std::vector<int>(gridHeight, -1));
-
-    //Plasserer punktene i gridet
-    for (size_t i = 0; i < points.size(); ++i)
+    // Alle punktene blir samlet i rutene (gjennomsnitt, min, max og antall), og trianguleringen blir laget
+    // fra hydekartet med ett hjrne midt i hver rute og gjennomsnittshyden
+    heightGrid.Reset(glm::vec2(min.x, min.z), gridSpacing, gridWidth, gridHeight);
+    if (quantizedOnly)
     {
-        int xIndex = static_cast<int>((points[i].x - min.x) / gridSpacing);
-        int zIndex = static_cast<int>((points[i].z - min.z) / gridSpacing);
-
-        if (xIndex >= 0 && xIndex < gridWidth && zIndex >= 0 && zIndex < gridHeight)
-        {
-            grid[xIndex][zIndex] = static_cast<int>(i);
-        }
+        heightGrid.Accumulate(quantized, center);
     }
-
-    // Generer trianguleringene
-    for (int row = 0; row < gridHeight - 1; ++row)
+    else
     {
-        for (int col = 0; col < gridWidth - 1; ++col)
-        {
-            // 4 naboer
-            int topLeft = grid[col][row];
-            int topRight = grid[col + 1][row];
-            int bottomLeft = grid[col][row + 1];
-            int bottomRight = grid[col + 1][row + 1];
+        heightGrid.Accumulate(points.data(), points.size());
+    }
 
-            if (topLeft != -1 && topRight != -1 && bottomLeft != -1 && bottomRight != -1)
-            {
-                // Frste trekant
-                indices.push_back(topLeft);
-                indices.push_back(bottomLeft);
-                indices.push_back(topRight);
-
-                // Andre trekant
-                indices.push_back(topRight);
-                indices.push_back(bottomLeft);
-                indices.push_back(bottomRight);
-            }
-        }
+    if (triangulation == ADAPTIVE_TRIANGULATION)
+    {
+        rtin.Build(heightGrid);
+        rtin.Extract(maxError, vertices, normals, indices);
+        std::cout << "Adaptive triangulation: " << indices.size() / 3 << " triangles with max error " << maxError << std::endl;
+    }
+    else
+    {
+        heightGrid.BuildMesh(vertices, normals, indices);
     }
+}
 
+// Delaunay-triangulering av alle punktene, s ingen punkter blir kastet og ingen ruter mangler.
+// Hjrnene i trianguleringen er de samme som punktene
+void PunktSky::generateDelaunayTriangulation()
+{
+    // Med QUANTIZED_POINTS blir heltallene gjort om rett inn i hjrnene, som er den eneste float-kopien
+    if (storage == QUANTIZED_POINTS && points.empty())
+    {
+        vertices.resize(quantized.Size());
+        quantized.Dequantize(0, quantized.Size(), center, vertices.data());
+    }
+    else
+    {
+        vertices = points;
+    }
 
+    boundsMin = glm::vec3(FLT_MAX);
+    boundsMax = glm::vec3(-FLT_MAX);
+    for (const auto& vertex : vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex);
+        boundsMax = glm::max(boundsMax, vertex);
+    }
 
-    // Beregning av normalvektorer
-    normals.resize(points.size(), glm::vec3(0.0f)); // (0, 0, 0)
+    DelaunayTriangulation::Triangulate(vertices, indices);
 
+    // Beregning av normalvektorer, summen av normalene til trekantene rundt hvert punkt
+    normals.assign(vertices.size(), glm::vec3(0.0f));
     for (size_t i = 0; i < indices.size(); i += 3)
     {
         unsigned int i0 = indices[i];
         unsigned int i1 = indices[i + 1];
         unsigned int i2 = indices[i + 2];
 
-        glm::vec3 v0 = points[i0];
-        glm::vec3 v1 = points[i1];
-        glm::vec3 v2 = points[i2];
-
-        glm::vec3 normal = glm::normalize(glm::cross(v1 - v0, v2 - v0)); // Kryssproduktet for  beregne trekantens normale
-
-        // Normale vektorer til 3 punkter
+        glm::vec3 normal = glm::normalize(glm::cross(vertices[i1] - vertices[i0], vertices[i2] - vertices[i0]));
         normals[i0] += normal;
         normals[i1] += normal;
         normals[i2] += normal;
     }
 
-    // Normalisere vektorene, for at de skal ha lengde p 1
-    for (auto& normal : normals)
+    // Punkter som ble hoppet over (samme x og z som et annet punkt) har ingen trekanter og beholder nullvektoren
+    parallelFor(normals.size(), [&](size_t begin, size_t end, unsigned int)
     {
-        normal = glm::normalize(normal);
-    }
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (normals[i] != glm::vec3(0.0f))
+            {
+                normals[i] = glm::normalize(normals[i]);
+            }
+        }
+    });
+
+    std::cout << "Delaunay triangulation: " << indices.size() / 3 << " triangles" << std::endl;
 }
@@ -8,31 +8,115 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <charconv>
 #include <float.h>
 
+#include "MappedFile.h"
+#include "QuantizedPoints.h"
+#include "PointParser.h"
+#include "LasReader.h"
+#include "TerrainCache.h"
+#include "StreamingTerrain.h"
+#include "HeightGrid.h"
+#include "DelaunayTriangulation.h"
+#include "RtinMesh.h"
+#include "TerrainLod.h"
+#include "TriangleBvh.h"
+#include "BakedHeightField.h"
+#include "Parallel.h"
+
 class PunktSky
 {
 public:
-    PunktSky(const std::string& filename); // Leser inn data fra fil
+    static const size_t DefaultMemoryBudget = size_t(1) << 31; // 2 GB
+
+    // Leser inn data fra fil. Filer som slutter p .las blir lest som binr LAS, alt annet som tekst.
+    // Punktskyer som ikke fr plass i memoryBudget blir bygd i fliser fra disk, og da inneholder punktskyen bare hjrnene i trianguleringen.
+    // Delaunay- og adaptiv triangulering trenger alle punktene i minnet, og blir byttet ut med griden hvis de ikke fr plass
+    PunktSky(const std::string& filename, size_t memoryBudget = DefaultMemoryBudget, PointStorage storage = FLOAT_POINTS,
+        TriangulationMode triangulation = GRID_TRIANGULATION);
     ~PunktSky();
 
     void DrawPunktSky(); // Renderer punktskyen
-    const std::vector<glm::vec3>& GetPoints() const; // Gir tilgang til punktene i punktskyen
+    const std::vector<glm::vec3>& GetPoints() const; // Gir tilgang til punktene i punktskyen (tom med QUANTIZED_POINTS)
+    const QuantizedPoints& GetQuantizedPoints() const; // Punktene med full presisjon (bare med QUANTIZED_POINTS, ellers tom)
+    const glm::dvec3& GetCenter() const; // Midtpunktet i originale koordinater som GetPoints er relative til
+    const HeightGrid& GetHeightGrid() const; // Hydekartet, tomt med Delaunay-triangulering
+
+    // Skriver de sentrerte punktene i samme tekstformat som konstruktren leser (antall p frste linje, s "x z y"),
+    // for tilpasning av en B-spline flate i BSpline-prosjektet. Med QUANTIZED_POINTS blir punktene gjort om i biter
+    bool ExportPoints(const std::string& filename) const;
+
+    // Strste tillatte avvik i hyde med ADAPTIVE_TRIANGULATION. Trianguleringen blir laget p nytt og lastet opp med en gang
+    void SetMaxError(float error);
+    float GetMaxError() const;
+
+    void DrawTriangles(); // Rendrer treanguleringen til punktskyen, eller chunkene fra siste utvalg nr terrenget har LOD
 
-    void DrawTriangles(); // Rendrer treanguleringen til punktskyen
+    // Rendrer terrenget med detaljniv etter avstanden til kameraet, med samme matriser som shaderen fr.
+    // Delaunay og den adaptive trianguleringen har ikke noe hydekart med faste ruter  lage chunks fra,
+    // s de tegner hele trianguleringen med ett kall som over. Med LOD blir bare chunkene lastet opp til GPU-en
+    void DrawTriangles(const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model, float screenHeight);
+    void SetLodPixelError(float pixels); // Strste hydeavvik p skjermen i piksler fr en chunk blir delt
+    const TerrainLod& GetLod() const;
+
+    // Frste treff langs strlen mot trianguleringen, i de sentrerte koordinatene til GetPoints. BVH-en over trekantene
+    // blir bygd frste gang og p nytt nr trianguleringen er endret, s mange strler br sendes samlet med IntersectRays
+    bool IntersectRay(const glm::vec3& origin, const glm::vec3& direction, RayHit& hit, float maxDistance = FLT_MAX);
+    void IntersectRays(const glm::vec3* origins, const glm::vec3* directions, size_t count, RayHit* hits, float maxDistance = FLT_MAX);
+
+    // Baker hyden og normalen til trianguleringen i et rutenett med columns x rows punkter over terrenget, for oppslag
+    // med HeightAt og NormalAt i de sentrerte koordinatene. Blir bakt p nytt med samme opplsning nr trianguleringen endres
+    bool BakeHeightField(int columns, int rows);
+    const BakedHeightField& GetBakedHeightField() const; // Tomt til BakeHeightField er kalt
 
     void DrawNormals(); // Rendrer normalvektoren for  se at punktskyen har normaler
+    void SetShowNormals(bool show); // Slr normalene av og p, DrawNormals gjr ingenting nr de er av
+    bool GetShowNormals() const;
+    void SetNormalLength(float length); // Lengden p normallinjene, bufferet blir laget p nytt ved neste DrawNormals
+    float GetNormalLength() const;
 
 private:
     std::vector<glm::vec3> points; // Lagrer punktene
     void loadAndCenterPoints(const std::string& filename); //Leser punktskydata og gjr om posisjonen snn at punktskyen er sentrert
+    void loadLasPoints(const std::string& filename); // Leser punktene direkte fra en binr LAS-fil og sentrerer dem
+    void loadQuantizedPoints(const std::string& filename); // Leser tekst eller LAS inn i quantized og lager points relativt til midtpunktet
+
+    PointStorage storage;
+    QuantizedPoints quantized; // Punktene med full presisjon nr storage er QUANTIZED_POINTS
 
     std::vector<unsigned int> indices;
-    void generateRegularTriangulation(); // Treangulering av punktene
+    void generateRegularTriangulation(); // Treangulering av hydekartet til punktene
+    void generateDelaunayTriangulation(); // Delaunay-triangulering av alle punktene
+    TriangulationMode triangulation;
+
+    HeightGrid heightGrid; // Hydestatistikk per rute, satt sammen fra flisene nr terrenget er bygd fra disk
+    RtinMesh rtin; // Feilhierarkiet til hydekartet med ADAPTIVE_TRIANGULATION
+    float maxError; // Feilgrensen for den adaptive trianguleringen
+    TerrainLod lod; // Chunkene til DrawTriangles med detaljniv, bare med GRID_TRIANGULATION
+    TriangleBvh bvh; // For IntersectRay, over vertices og indices
+    bool bvhDirty; // Trianguleringen er endret siden BVH-en sist ble bygd
+    BakedHeightField bakedHeights; // Fra BakeHeightField, over vertices og indices
+    std::vector<glm::vec3> vertices; // Hjrnene i trianguleringen
+    std::vector<glm::vec3> normals; // Normalvektoren til hvert hjrne
+
+    float gridSpacing; // Avstanden mellom punktene i trianguleringen
+    glm::dvec3 center; // Midtpunktet i originale koordinater som punktene er sentrert rundt
+    glm::vec3 boundsMin, boundsMax; // Bounding box for de sentrerte punktene
 
-    std::vector<glm::vec3> normals; // Normalvektoren
+    void loadFromCache(const TerrainCache& cache); // Henter ferdig triangulert terreng fra cachen
+    void setupBuffers(const glm::vec3* pointPositions, const glm::vec3* vertexPositions, const glm::vec3* vertexNormals,
+        const unsigned int* triangleIndices); // Laster opp punkter, hjrner, normaler og indekser til GPU-en
+    void uploadMesh(const glm::vec3* vertexPositions, const glm::vec3* vertexNormals, const unsigned int* triangleIndices);
 
-    GLuint VAO, VBO, EBO;
-    GLuint normalVAO, normalVBO;
+    GLuint VAO, VBO, EBO; // Trianguleringen
+    GLuint pointVAO, pointVBO; // Punktskyen
+    size_t pointCount; // Antall punkter i pointVBO
+    GLuint normalVAO, normalVBO; // Linjene fra hvert hjrne langs normalen, laget n gang og ikke per bilde
+    void uploadNormalLines(); // Lager linjene fra vertices og normals og laster dem opp
+    bool showNormals;
+    bool normalLinesDirty; // Trianguleringen eller lengden er endret siden linjene sist ble lastet opp
+    float normalLength;
+    size_t normalLineVertexCount;
 };
 #endif // !PUNKTSKY_H
@@ -0,0 +1,140 @@
+#include "QuantizedPoints.h"
+#include "Parallel.h"
+
+#include <climits>
+#include <cmath>
+#include <algorithm>
+
+QuantizedPoints::QuantizedPoints()
+{
+    origin = glm::dvec3(0.0);
+    scale = glm::dvec3(0.001); // Millimeter
+}
+
+void QuantizedPoints::SetQuantization(const glm::dvec3& newOrigin, const glm::dvec3& newScale)
+{
+    origin = newOrigin;
+    scale = newScale;
+}
+
+glm::ivec3 QuantizedPoints::Quantize(const glm::dvec3& position) const
+{
+    // Punkter utenfor int32-omrdet blir klemt til kanten i stedet for  g rundt
+    glm::dvec3 q = glm::round((position - origin) / scale);
+    q = glm::clamp(q, glm::dvec3(INT_MIN), glm::dvec3(INT_MAX));
+    return glm::ivec3(q);
+}
+
+glm::dvec3 QuantizedPoints::GetPosition(size_t i) const
+{
+    return glm::dvec3(data[i]) * scale + origin;
+}
+
+void QuantizedPoints::Dequantize(size_t first, size_t count, const glm::dvec3& relativeTo, glm::vec3* output) const
+{
+    glm::dvec3 shift = origin - relativeTo;
+    parallelFor(count, [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            output[i] = glm::vec3(glm::dvec3(data[first + i]) * scale + shift);
+        }
+    });
+}
+
+void QuantizedPoints::integerBounds(glm::ivec3& min, glm::ivec3& max) const
+{
+    unsigned int chunks = threadCount();
+    std::vector<glm::ivec3> chunkMin(chunks, glm::ivec3(INT_MAX));
+    std::vector<glm::ivec3> chunkMax(chunks, glm::ivec3(INT_MIN));
+    parallelFor(data.size(), chunks, [&](size_t begin, size_t end, unsigned int chunk)
+    {
+        glm::ivec3 localMin(INT_MAX), localMax(INT_MIN);
+        for (size_t i = begin; i < end; ++i)
+        {
+            localMin = glm::min(localMin, data[i]);
+            localMax = glm::max(localMax, data[i]);
+        }
+        chunkMin[chunk] = localMin;
+        chunkMax[chunk] = localMax;
+    });
+
+    min = glm::ivec3(INT_MAX);
+    max = glm::ivec3(INT_MIN);
+    for (unsigned int c = 0; c < chunks; ++c)
+    {
+        min = glm::min(min, chunkMin[c]);
+        max = glm::max(max, chunkMax[c]);
+    }
+}
+
+void QuantizedPoints::Bounds(const glm::dvec3& relativeTo, glm::vec3& min, glm::vec3& max) const
+{
+    if (data.empty())
+    {
+        min = max = glm::vec3(0.0f);
+        return;
+    }
+
+    glm::ivec3 integerMin, integerMax;
+    integerBounds(integerMin, integerMax);
+    min = glm::vec3(glm::dvec3(integerMin) * scale + origin - relativeTo);
+    max = glm::vec3(glm::dvec3(integerMax) * scale + origin - relativeTo);
+}
+
+void QuantizedPoints::Recenter()
+{
+    if (data.empty())
+    {
+        return;
+    }
+
+    glm::ivec3 min, max;
+    integerBounds(min, max);
+
+    // Midtpunktet regnes i 64 bit s summen ikke gr over
+    glm::ivec3 middle(
+        static_cast<int>((static_cast<long long>(min.x) + max.x) / 2),
+        static_cast<int>((static_cast<long long>(min.y) + max.y) / 2),
+        static_cast<int>((static_cast<long long>(min.z) + max.z) / 2));
+
+    parallelFor(data.size(), [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            data[i] -= middle;
+        }
+    });
+    origin += glm::dvec3(middle) * scale;
+}
+
+std::vector<glm::ivec3>& QuantizedPoints::GetData()
+{
+    return data;
+}
+
+const std::vector<glm::ivec3>& QuantizedPoints::GetData() const
+{
+    return data;
+}
+
+const glm::dvec3& QuantizedPoints::GetOrigin() const
+{
+    return origin;
+}
+
+const glm::dvec3& QuantizedPoints::GetScale() const
+{
+    return scale;
+}
+
+size_t QuantizedPoints::Size() const
+{
+    return data.size();
+}
+
+void QuantizedPoints::Clear()
+{
+    data.clear();
+    data.shrink_to_fit();
+}
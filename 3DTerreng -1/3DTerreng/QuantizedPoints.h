@@ -0,0 +1,50 @@
+#ifndef QUANTIZEDPOINTS_H
+#define QUANTIZEDPOINTS_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Hvordan punktene blir lagret nr de leses inn
+enum PointStorage
+{
+    FLOAT_POINTS, // Leses rett inn i float
+    QUANTIZED_POINTS // Leses i double og lagres bare som int32 med double origin og scale, som i LAS
+};
+
+// Punkter lagret som heltall p samme mte som i LAS: posisjon = heltall * scale + origin.
+// Origin og scale er double, s store koordinater (UTM) beholder full presisjon, mens hvert punkt
+// bare bruker 12 bytes. Punktene blir gjort om til float relativt til et valgfritt punkt (kamera, flis) frst nr de trengs.
+class QuantizedPoints
+{
+public:
+    QuantizedPoints();
+
+    void SetQuantization(const glm::dvec3& newOrigin, const glm::dvec3& newScale); // M settes fr punkter blir lagt til
+    glm::ivec3 Quantize(const glm::dvec3& position) const; // Gjr om en posisjon til heltall
+    glm::dvec3 GetPosition(size_t i) const; // Posisjonen til punkt i i originale koordinater
+
+    // Skriver punktene [first, first + count) som float relativt til relativeTo
+    void Dequantize(size_t first, size_t count, const glm::dvec3& relativeTo, glm::vec3* output) const;
+
+    // Bounding boxen som float relativt til relativeTo, regnet ut p heltallene
+    void Bounds(const glm::dvec3& relativeTo, glm::vec3& min, glm::vec3& max) const;
+
+    // Flytter origin til midten av bounding boxen. Heltallene blir forskjvet like mye, s ingen presisjon gr tapt
+    void Recenter();
+
+    std::vector<glm::ivec3>& GetData();
+    const std::vector<glm::ivec3>& GetData() const;
+    const glm::dvec3& GetOrigin() const;
+    const glm::dvec3& GetScale() const;
+    size_t Size() const;
+    void Clear();
+
+private:
+    void integerBounds(glm::ivec3& min, glm::ivec3& max) const;
+
+    glm::dvec3 origin;
+    glm::dvec3 scale;
+    std::vector<glm::ivec3> data;
+};
+
+#endif // !QUANTIZEDPOINTS_H
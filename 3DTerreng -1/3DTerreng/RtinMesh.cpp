@@ -0,0 +1,196 @@
+#include "RtinMesh.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+RtinMesh::RtinMesh()
+{
+    size = 0;
+    origin = glm::vec2(0.0f);
+    spacing = 1.0f;
+}
+
+float RtinMesh::heightAt(int x, int y) const
+{
+    return heights[static_cast<size_t>(y) * size + x];
+}
+
+void RtinMesh::Build(const HeightGrid& grid)
+{
+    int columns = grid.GetColumns();
+    int rows = grid.GetRows();
+    if (columns < 2 || rows < 2)
+    {
+        size = 0;
+        heights.clear();
+        errors.clear();
+        return;
+    }
+
+    // Minste 2^k + 1 som dekker gridet
+    int tileSize = 1;
+    while (tileSize + 1 < std::max(columns, rows))
+    {
+        tileSize *= 2;
+    }
+    size = tileSize + 1;
+
+    spacing = grid.GetSpacing();
+    origin = grid.GetOrigin() + glm::vec2((grid.GetFirstColumn() + 0.5f) * spacing, (grid.GetFirstRow() + 0.5f) * spacing);
+
+    const float empty = std::numeric_limits<float>::quiet_NaN();
+    const float infinity = std::numeric_limits<float>::infinity();
+    heights.assign(static_cast<size_t>(size) * size, empty);
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int col = 0; col < columns; ++col)
+        {
+            const HeightCell& cell = grid.GetCell(grid.GetFirstColumn() + col, grid.GetFirstRow() + row);
+            if (cell.count > 0)
+            {
+                heights[static_cast<size_t>(row) * size + col] = cell.mean;
+            }
+        }
+    }
+
+    // Gr gjennom alle trekantene fra de minste til de strste, s feilen til barna er ferdig fr foreldrene.
+    // Trekant id (fra 2) er en sti i binrtreet: de to verste er de to halvdelene av kvadratet, og hver bit
+    // under sier om vi gr til venstre eller hyre halvdel
+    errors.assign(static_cast<size_t>(size) * size, 0.0f);
+    size_t triangleCount = static_cast<size_t>(tileSize) * tileSize * 2 - 2;
+    size_t parentCount = triangleCount - static_cast<size_t>(tileSize) * tileSize;
+
+    for (size_t i = triangleCount; i-- > 0; )
+    {
+        size_t id = i + 2;
+        int ax = 0, ay = 0, bx = 0, by = 0, cx = 0, cy = 0;
+        if (id & 1)
+        {
+            bx = by = cx = tileSize;
+        }
+        else
+        {
+            ax = ay = cy = tileSize;
+        }
+        while ((id >>= 1) > 1)
+        {
+            int mx = (ax + bx) >> 1;
+            int my = (ay + by) >> 1;
+            if (id & 1)
+            {
+                bx = ax; by = ay;
+                ax = cx; ay = cy;
+            }
+            else
+            {
+                ax = bx; ay = by;
+                bx = cx; by = cy;
+            }
+            cx = mx;
+            cy = my;
+        }
+
+        int mx = (ax + bx) >> 1;
+        int my = (ay + by) >> 1;
+        size_t middle = static_cast<size_t>(my) * size + mx;
+
+        float a = heightAt(ax, ay);
+        float b = heightAt(bx, by);
+        float m = heights[middle];
+        float c = heightAt(cx, cy);
+
+        // Tomme hjrner gir uendelig feil, s trekanten rundt blir delt helt ned
+        float error = (std::isnan(a) || std::isnan(b) || std::isnan(c) || std::isnan(m)) ? infinity : std::abs((a + b) * 0.5f - m);
+        errors[middle] = std::max(errors[middle], error);
+
+        // Planet til trekanten avviker fra planene til barna med hyst feilen i midtpunktet, s feilen i barna
+        // pluss den blir en vre grense for avviket i alle rutene under trekanten
+        if (i < parentCount)
+        {
+            size_t left = static_cast<size_t>((ay + cy) >> 1) * size + ((ax + cx) >> 1);
+            size_t right = static_cast<size_t>((by + cy) >> 1) * size + ((bx + cx) >> 1);
+            errors[middle] = std::max(errors[middle], error + std::max(errors[left], errors[right]));
+        }
+    }
+}
+
+void RtinMesh::Extract(float maxError, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<unsigned int>& indices) const
+{
+    vertices.clear();
+    normals.clear();
+    indices.clear();
+    if (size == 0)
+    {
+        return;
+    }
+
+    std::vector<int> vertexOf(heights.size(), -1);
+    auto vertex = [&](int x, int y)
+    {
+        int& id = vertexOf[static_cast<size_t>(y) * size + x];
+        if (id < 0)
+        {
+            id = static_cast<int>(vertices.size());
+            vertices.push_back(glm::vec3(origin.x + x * spacing, heightAt(x, y), origin.y + y * spacing));
+        }
+        return static_cast<unsigned int>(id);
+    };
+
+    // Deler trekanten s lenge feilen i midten av hypotenusen er for stor
+    struct Triangle
+    {
+        int ax, ay, bx, by, cx, cy;
+    };
+    int last = size - 1;
+    std::vector<Triangle> stack = { { 0, 0, last, last, last, 0 }, { last, last, 0, 0, 0, last } };
+    while (!stack.empty())
+    {
+        Triangle t = stack.back();
+        stack.pop_back();
+
+        int mx = (t.ax + t.bx) >> 1;
+        int my = (t.ay + t.by) >> 1;
+        if (std::abs(t.ax - t.cx) + std::abs(t.ay - t.cy) > 1 && errors[static_cast<size_t>(my) * size + mx] > maxError)
+        {
+            stack.push_back({ t.bx, t.by, t.cx, t.cy, mx, my });
+            stack.push_back({ t.cx, t.cy, t.ax, t.ay, mx, my });
+            continue;
+        }
+
+        if (std::isnan(heightAt(t.ax, t.ay)) || std::isnan(heightAt(t.bx, t.by)) || std::isnan(heightAt(t.cx, t.cy)))
+        {
+            continue;
+        }
+
+        unsigned int a = vertex(t.ax, t.ay);
+        unsigned int b = vertex(t.bx, t.by);
+        unsigned int c = vertex(t.cx, t.cy);
+        indices.insert(indices.end(), { a, b, c });
+    }
+
+    // Beregning av normalvektorer, summen av normalene til trekantene rundt hvert hjrne
+    normals.assign(vertices.size(), glm::vec3(0.0f));
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        glm::vec3 normal = glm::normalize(glm::cross(vertices[indices[i + 1]] - vertices[indices[i]], vertices[indices[i + 2]] - vertices[indices[i]]));
+        normals[indices[i]] += normal;
+        normals[indices[i + 1]] += normal;
+        normals[indices[i + 2]] += normal;
+    }
+
+    for (auto& normal : normals)
+    {
+        normal = glm::normalize(normal);
+    }
+}
+
+int RtinMesh::GetSize() const
+{
+    return size;
+}
+
+float RtinMesh::GetError(int x, int y) const
+{
+    return errors[static_cast<size_t>(y) * size + x];
+}
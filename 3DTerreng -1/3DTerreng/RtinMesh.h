@@ -0,0 +1,38 @@
+#ifndef RTINMESH_H
+#define RTINMESH_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "HeightGrid.h"
+
+// Adaptiv triangulering av hydekartet (right-triangulated irregular network).
+// Hydekartet blir lagt i et kvadrat med 2^k + 1 hjrner p hver side, som blir delt i rettvinklede trekanter
+// ved  halvere hypotenusen. Build regner ut en gang for alle hvor stor feilen blir i hvert hjrne hvis trekanten
+// over det ikke blir delt, s Extract kan lage et mesh for hvilken som helst feilgrense i liner tid.
+// Trekanter som dekker tomme ruter blir alltid delt helt ned, og de minste trekantene med tomme hjrner blir hoppet over.
+class RtinMesh
+{
+public:
+    RtinMesh();
+
+    void Build(const HeightGrid& grid); // Regner ut feilen i alle hjrnene
+
+    // Lager trekanter der ingen hyde i gridet avviker mer enn maxError fra trekanten.
+    // Hjrnene ligger midt i rutene i gridet, og trekantene har samme omlpsretning som gridtrianguleringen
+    void Extract(float maxError, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<unsigned int>& indices) const;
+
+    int GetSize() const; // Antall hjrner langs hver side, 0 hvis Build ikke er kalt
+    float GetError(int x, int y) const; // Feilen i hjrnet (x, y), uendelig hvis trekanten dekker tomme ruter
+
+private:
+    float heightAt(int x, int y) const;
+
+    int size;
+    std::vector<float> heights; // NaN i tomme ruter og utenfor gridet
+    std::vector<float> errors;
+    glm::vec2 origin; // Midten av frste rute i x og z
+    float spacing;
+};
+
+#endif // !RTINMESH_H
@@ -0,0 +1,116 @@
+#ifndef SIMDFLOAT_H
+#define SIMDFLOAT_H
+
+#include <glm/glm.hpp>
+
+// Et knippe float-verdier som blir regnet p med n instruksjon. Bredden kommer fra GLM_ARCH i glm/simd/platform.h:
+// 8 med AVX2 (/arch:AVX2), 4 med SSE2 og 1 (vanlig float) ellers. Prosjektet definerer GLM_FORCE_INTRINSICS
+// s glm finner instruksjonssettet, uten den blir alt regnet en verdi om gangen.
+// Sammenligninger gir en SimdMask, og Bits() har n bit per verdi der sammenligningen holdt
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+
+struct SimdFloat
+{
+    static const int Width = 8;
+    __m256 value;
+
+    SimdFloat() {}
+    SimdFloat(__m256 value) : value(value) {}
+    explicit SimdFloat(float scalar) : value(_mm256_set1_ps(scalar)) {}
+
+    static SimdFloat Load(const float* source) { return _mm256_loadu_ps(source); }
+    // source[indices[k]] for hver plass k
+    static SimdFloat Gather(const float* source, const int* indices) { return _mm256_i32gather_ps(source, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices)), 4); }
+    void Store(float* destination) const { _mm256_storeu_ps(destination, value); }
+};
+
+struct SimdMask
+{
+    __m256 value;
+
+    SimdMask(__m256 value) : value(value) {}
+    int Bits() const { return _mm256_movemask_ps(value); }
+};
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return _mm256_add_ps(a.value, b.value); }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return _mm256_sub_ps(a.value, b.value); }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a.value, b.value); }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return _mm256_div_ps(a.value, b.value); }
+inline SimdFloat Min(SimdFloat a, SimdFloat b) { return _mm256_min_ps(a.value, b.value); }
+inline SimdFloat Max(SimdFloat a, SimdFloat b) { return _mm256_max_ps(a.value, b.value); }
+inline SimdMask operator<(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.value, b.value, _CMP_LT_OQ); }
+inline SimdMask operator<=(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.value, b.value, _CMP_LE_OQ); }
+inline SimdMask operator&(SimdMask a, SimdMask b) { return _mm256_and_ps(a.value, b.value); }
+
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+
+struct SimdFloat
+{
+    static const int Width = 4;
+    __m128 value;
+
+    SimdFloat() {}
+    SimdFloat(__m128 value) : value(value) {}
+    explicit SimdFloat(float scalar) : value(_mm_set1_ps(scalar)) {}
+
+    static SimdFloat Load(const float* source) { return _mm_loadu_ps(source); }
+    static SimdFloat Gather(const float* source, const int* indices) { return _mm_set_ps(source[indices[3]], source[indices[2]], source[indices[1]], source[indices[0]]); }
+    void Store(float* destination) const { _mm_storeu_ps(destination, value); }
+};
+
+struct SimdMask
+{
+    __m128 value;
+
+    SimdMask(__m128 value) : value(value) {}
+    int Bits() const { return _mm_movemask_ps(value); }
+};
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return _mm_add_ps(a.value, b.value); }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return _mm_sub_ps(a.value, b.value); }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a.value, b.value); }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return _mm_div_ps(a.value, b.value); }
+inline SimdFloat Min(SimdFloat a, SimdFloat b) { return _mm_min_ps(a.value, b.value); }
+inline SimdFloat Max(SimdFloat a, SimdFloat b) { return _mm_max_ps(a.value, b.value); }
+inline SimdMask operator<(SimdFloat a, SimdFloat b) { return _mm_cmplt_ps(a.value, b.value); }
+inline SimdMask operator<=(SimdFloat a, SimdFloat b) { return _mm_cmple_ps(a.value, b.value); }
+inline SimdMask operator&(SimdMask a, SimdMask b) { return _mm_and_ps(a.value, b.value); }
+
+#else
+
+struct SimdFloat
+{
+    static const int Width = 1;
+    float value;
+
+    SimdFloat() {}
+    explicit SimdFloat(float scalar) : value(scalar) {}
+
+    static SimdFloat Load(const float* source) { return SimdFloat(*source); }
+    static SimdFloat Gather(const float* source, const int* indices) { return SimdFloat(source[indices[0]]); }
+    void Store(float* destination) const { *destination = value; }
+};
+
+struct SimdMask
+{
+    bool value;
+
+    SimdMask(bool value) : value(value) {}
+    int Bits() const { return value ? 1 : 0; }
+};
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return SimdFloat(a.value + b.value); }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return SimdFloat(a.value - b.value); }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return SimdFloat(a.value * b.value); }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return SimdFloat(a.value / b.value); }
+inline SimdFloat Min(SimdFloat a, SimdFloat b) { return SimdFloat(a.value < b.value ? a.value : b.value); }
+inline SimdFloat Max(SimdFloat a, SimdFloat b) { return SimdFloat(a.value > b.value ? a.value : b.value); }
+inline SimdMask operator<(SimdFloat a, SimdFloat b) { return a.value < b.value; }
+inline SimdMask operator<=(SimdFloat a, SimdFloat b) { return a.value <= b.value; }
+inline SimdMask operator&(SimdMask a, SimdMask b) { return a.value && b.value; }
+
+#endif
+
+inline SimdFloat& operator+=(SimdFloat& a, SimdFloat b) { a = a + b; return a; }
+
+#endif // !SIMDFLOAT_H
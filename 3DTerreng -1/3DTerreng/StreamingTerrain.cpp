@@ -0,0 +1,414 @@
+#include "StreamingTerrain.h"
+#include "MappedFile.h"
+#include "PointParser.h"
+#include "LasReader.h"
+#include "Parallel.h"
+#include "HeightGrid.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <charconv>
+#include <atomic>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+StreamingTerrain::StreamingTerrain(float gridSpacing, size_t memoryBudget, bool fullPrecision)
+    : gridSpacing(gridSpacing), memoryBudget(memoryBudget), fullPrecision(fullPrecision)
+{
+    // En ttendedel av budsjettet gr til bitene som blir lest fra filen (som glm::dvec3)
+    batchPoints = std::max<size_t>(1 << 16, memoryBudget / 8 / sizeof(glm::dvec3));
+
+    center = glm::dvec3(0.0);
+    gridMin = glm::vec3(0.0f);
+    gridMax = glm::vec3(0.0f);
+    gridWidth = 0;
+    gridHeight = 0;
+    tileSize = 0;
+    tilesX = 0;
+    tilesZ = 0;
+    pointCount = 0;
+    singlePrecision = !fullPrecision;
+    fullGrid = nullptr;
+}
+
+uint64_t StreamingTerrain::EstimatePointCount(const std::string& filename)
+{
+    if (LasReader::IsLasFile(filename))
+    {
+        LasReader reader;
+        return reader.Open(filename) ? reader.GetPointCount() : 0;
+    }
+
+    // Frste linje i tekstfilen er antall punkter. Hvis den mangler, blir antallet ansltt fra filstrrelsen
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+    {
+        return 0;
+    }
+
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+
+    std::string header;
+    std::getline(file, header);
+
+    uint64_t count = 0;
+    const char* begin = header.data();
+    while (begin < header.data() + header.size() && (*begin == ' ' || *begin == '\t'))
+    {
+        ++begin;
+    }
+    std::from_chars_result result = std::from_chars(begin, header.data() + header.size(), count);
+    if (result.ec != std::errc() || count == 0)
+    {
+        count = fileSize / 30;
+    }
+
+    return count;
+}
+
+bool StreamingTerrain::forEachBatch(const std::string& filename, bool reportErrors, const BatchCallback& callback)
+{
+    std::vector<glm::dvec3> batch;
+
+    if (LasReader::IsLasFile(filename))
+    {
+        LasReader reader;
+        if (!reader.Open(filename))
+        {
+            return false;
+        }
+
+        size_t count = static_cast<size_t>(reader.GetPointCount());
+        batch.resize(std::min(batchPoints, count));
+        for (size_t first = 0; first < count; first += batchPoints)
+        {
+            size_t n = std::min(batchPoints, count - first);
+            reader.ReadPositions(first, n, batch.data());
+            callback(batch.data(), n);
+        }
+        return true;
+    }
+
+    MappedFile file;
+    if (!file.Open(filename))
+    {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return false;
+    }
+
+    const char* begin = file.Data();
+    const char* end = begin + file.Size();
+    if (begin == end)
+    {
+        return true;
+    }
+
+    // Hopper over linjen med antall punkter
+    const char* headerEnd = findLineEnd(begin, end);
+    const char* windowBegin = headerEnd < end ? headerEnd + 1 : end;
+
+    // Leser filen i vinduer p omtrent batchPoints linjer (regner med omtrent 32 bytes per linje)
+    const size_t windowBytes = batchPoints * 32;
+    std::vector<glm::vec3> parsed;
+    std::vector<glm::dvec3> parsedDouble;
+    size_t lineNumber = 1;
+
+    while (windowBegin < end)
+    {
+        const char* windowEnd = end;
+        if (static_cast<size_t>(end - windowBegin) > windowBytes)
+        {
+            windowEnd = findLineEnd(windowBegin + windowBytes, end);
+            windowEnd = windowEnd < end ? windowEnd + 1 : end;
+        }
+
+        std::vector<PointChunk> chunks = splitIntoChunks(windowBegin, windowEnd, threadCount());
+        countLines(chunks);
+
+        size_t lineCount = 0;
+        for (auto& chunk : chunks)
+        {
+            chunk.firstPoint = lineCount;
+            lineCount += chunk.lineCount;
+        }
+        if (singlePrecision)
+        {
+            parsed.resize(lineCount);
+            parseChunks(chunks, parsed.data());
+        }
+        else
+        {
+            parsedDouble.resize(lineCount);
+            parseChunks(chunks, parsedDouble.data());
+        }
+
+        batch.clear();
+        for (const auto& chunk : chunks)
+        {
+            if (reportErrors)
+            {
+                ::reportErrors(chunk, lineNumber + 1);
+            }
+            for (size_t i = 0; i < chunk.pointCount; ++i)
+            {
+                batch.push_back(singlePrecision ? glm::dvec3(parsed[chunk.firstPoint + i]) : parsedDouble[chunk.firstPoint + i]);
+            }
+            lineNumber += chunk.lineCount;
+        }
+
+        callback(batch.data(), batch.size());
+        windowBegin = windowEnd;
+    }
+
+    return true;
+}
+
+glm::ivec2 StreamingTerrain::cellOf(const glm::vec3& point) const
+{
+    return glm::ivec2(static_cast<int>((point.x - gridMin.x) / gridSpacing), static_cast<int>((point.z - gridMin.z) / gridSpacing));
+}
+
+glm::vec3 StreamingTerrain::centered(const glm::dvec3& position) const
+{
+    if (singlePrecision)
+    {
+        return glm::vec3(position) - glm::vec3(center);
+    }
+    return glm::vec3(position - center);
+}
+
+std::string StreamingTerrain::tilePath(int tileX, int tileZ) const
+{
+    return scratchDirectory + "/tile_" + std::to_string(tileX) + "_" + std::to_string(tileZ) + ".bin";
+}
+
+bool StreamingTerrain::binPoints(const std::string& filename)
+{
+    size_t tileCount = static_cast<size_t>(tilesX) * tilesZ;
+
+    // Halvparten av budsjettet gr til buffere for flisene. Et buffer blir skrevet til disk nr det er fullt
+    size_t bufferPoints = std::max<size_t>(256, memoryBudget / 2 / tileCount / sizeof(glm::vec3));
+    std::vector<std::vector<glm::vec3>> buffers(tileCount);
+    bool writeFailed = false;
+
+    auto flush = [&](size_t tile)
+    {
+        if (buffers[tile].empty())
+        {
+            return;
+        }
+
+        std::ofstream out(tilePath(static_cast<int>(tile % tilesX), static_cast<int>(tile / tilesX)), std::ios::binary | std::ios::app);
+        out.write(reinterpret_cast<const char*>(buffers[tile].data()), buffers[tile].size() * sizeof(glm::vec3));
+        writeFailed |= !out;
+        buffers[tile].clear();
+    };
+
+    auto add = [&](int tileX, int tileZ, const glm::vec3& point)
+    {
+        size_t tile = static_cast<size_t>(tileZ) * tilesX + tileX;
+        buffers[tile].push_back(point);
+        if (buffers[tile].size() >= bufferPoints)
+        {
+            flush(tile);
+        }
+    };
+
+    bool ok = forEachBatch(filename, false, [&](const glm::dvec3* positions, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            glm::vec3 point = centered(positions[i]);
+            glm::ivec2 cell = cellOf(point);
+            if (cell.x < 0 || cell.x >= gridWidth || cell.y < 0 || cell.y >= gridHeight)
+            {
+                continue;
+            }
+
+            // Punktet havner i sin egen flis, og i naboflisene hvis det ligger i kanten deres
+            int tileX = cell.x / tileSize;
+            int tileZ = cell.y / tileSize;
+            int localX = cell.x - tileX * tileSize;
+            int localZ = cell.y - tileZ * tileSize;
+
+            int xs[2] = { tileX, -1 };
+            int zs[2] = { tileZ, -1 };
+            if (localX <= 1 && tileX > 0) xs[1] = tileX - 1;
+            if (localX == tileSize - 1 && tileX + 1 < tilesX) xs[1] = tileX + 1;
+            if (localZ <= 1 && tileZ > 0) zs[1] = tileZ - 1;
+            if (localZ == tileSize - 1 && tileZ + 1 < tilesZ) zs[1] = tileZ + 1;
+
+            for (int a = 0; a < 2 && xs[a] >= 0; ++a)
+            {
+                for (int b = 0; b < 2 && zs[b] >= 0; ++b)
+                {
+                    add(xs[a], zs[b], point);
+                }
+            }
+        }
+    });
+
+    for (size_t tile = 0; tile < tileCount; ++tile)
+    {
+        flush(tile);
+    }
+
+    if (writeFailed)
+    {
+        std::cerr << "Error: Unable to write tile files to " << scratchDirectory << std::endl;
+        return false;
+    }
+    return ok;
+}
+
+void StreamingTerrain::buildTile(int tileX, int tileZ, TileMesh& mesh)
+{
+    // Rutene flisen eier
+    int col0 = tileX * tileSize;
+    int row0 = tileZ * tileSize;
+    int col1 = std::min(col0 + tileSize, gridWidth) - 1;
+    int row1 = std::min(row0 + tileSize, gridHeight) - 1;
+
+    // Rutene flisen trenger: n ekstra p lav side og to p hy side for normalene i kanten
+    int extCol0 = std::max(col0 - 1, 0);
+    int extRow0 = std::max(row0 - 1, 0);
+    int extCol1 = std::min(col1 + 2, gridWidth - 1);
+    int extRow1 = std::min(row1 + 2, gridHeight - 1);
+
+    std::vector<glm::vec3> tilePoints;
+    std::ifstream in(tilePath(tileX, tileZ), std::ios::binary | std::ios::ate);
+    if (in.is_open())
+    {
+        size_t bytes = static_cast<size_t>(in.tellg());
+        tilePoints.resize(bytes / sizeof(glm::vec3));
+        in.seekg(0);
+        in.read(reinterpret_cast<char*>(tilePoints.data()), tilePoints.size() * sizeof(glm::vec3));
+    }
+
+    // Samler hydene i utsnittet av gridet og lager trekantene i rutene flisen eier.
+    // Flisene blir allerede bygd parallelt, s hver flis bruker bare n trd
+    HeightGrid grid;
+    grid.Reset(glm::vec2(gridMin.x, gridMin.z), gridSpacing, extCol1 - extCol0 + 1, extRow1 - extRow0 + 1, extCol0, extRow0);
+    grid.Accumulate(tilePoints.data(), tilePoints.size(), 1);
+    grid.BuildMesh(col0, row0, col1, row1, mesh.vertices, mesh.normals, mesh.indices);
+
+    // Flisene eier hver sine ruter, s de kan skrive til det felles gridet samtidig
+    if (fullGrid)
+    {
+        std::vector<HeightCell>& cells = fullGrid->GetCells();
+        for (int row = row0; row <= row1; ++row)
+        {
+            for (int col = col0; col <= col1; ++col)
+            {
+                cells[static_cast<size_t>(row) * gridWidth + col] = grid.GetCell(col, row);
+            }
+        }
+    }
+}
+
+bool StreamingTerrain::Build(const std::string& filename, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals,
+    std::vector<unsigned int>& indices, glm::dvec3& outCenter, glm::vec3& boundsMin, glm::vec3& boundsMax,
+    HeightGrid* heightGrid)
+{
+    singlePrecision = !fullPrecision && !LasReader::IsLasFile(filename);
+
+    // Frste runde: bounding box og antall punkter
+    glm::dvec3 min(DBL_MAX), max(-DBL_MAX);
+    pointCount = 0;
+    bool ok = forEachBatch(filename, true, [&](const glm::dvec3* positions, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            min = glm::min(min, positions[i]);
+            max = glm::max(max, positions[i]);
+        }
+        pointCount += count;
+    });
+
+    if (!ok || pointCount == 0)
+    {
+        return false;
+    }
+
+    center = singlePrecision ? glm::dvec3((glm::vec3(min) + glm::vec3(max)) / 2.0f) : (min + max) * 0.5;
+    gridMin = centered(min);
+    gridMax = centered(max);
+    gridWidth = static_cast<int>((gridMax.x - gridMin.x) / gridSpacing) + 1;
+    gridHeight = static_cast<int>((gridMax.z - gridMin.z) / gridSpacing) + 1;
+
+    // Velger flisstrrelsen slik at hver trd holder seg innenfor sin del av budsjettet
+    unsigned int workers = threadCount();
+    double pointsPerCell = static_cast<double>(pointCount) / (static_cast<double>(gridWidth) * gridHeight);
+    double bytesPerCell = pointsPerCell * sizeof(glm::vec3) * 1.5 + sizeof(HeightCell) + sizeof(int) + 2 * sizeof(glm::vec3) + 6 * sizeof(unsigned int);
+    double cellsPerTile = static_cast<double>(memoryBudget) / 2 / workers / bytesPerCell;
+    tileSize = std::max(4, std::min(4096, static_cast<int>(std::sqrt(cellsPerTile))));
+    tilesX = (gridWidth + tileSize - 1) / tileSize;
+    tilesZ = (gridHeight + tileSize - 1) / tileSize;
+
+    std::cout << "Streaming " << pointCount << " points into " << tilesX << " x " << tilesZ << " tiles of "
+        << tileSize << " x " << tileSize << " cells" << std::endl;
+
+    // Andre runde: sorterer punktene i flisfiler
+    scratchDirectory = filename + ".tiles";
+    std::error_code error;
+    std::filesystem::remove_all(scratchDirectory, error);
+    std::filesystem::create_directories(scratchDirectory, error);
+    if (error)
+    {
+        std::cerr << "Error: Unable to create " << scratchDirectory << std::endl;
+        return false;
+    }
+
+    if (!binPoints(filename))
+    {
+        std::filesystem::remove_all(scratchDirectory, error);
+        return false;
+    }
+
+    fullGrid = heightGrid;
+    if (fullGrid)
+    {
+        fullGrid->Reset(glm::vec2(gridMin.x, gridMin.z), gridSpacing, gridWidth, gridHeight);
+    }
+
+    // Triangulerer flisene parallelt, hver trd henter neste ledige flis
+    size_t tileCount = static_cast<size_t>(tilesX) * tilesZ;
+    std::vector<TileMesh> meshes(tileCount);
+    std::atomic<size_t> nextTile(0);
+    parallelFor(workers, workers, [&](size_t, size_t, unsigned int)
+    {
+        for (size_t tile = nextTile++; tile < tileCount; tile = nextTile++)
+        {
+            buildTile(static_cast<int>(tile % tilesX), static_cast<int>(tile / tilesX), meshes[tile]);
+        }
+    });
+
+    std::filesystem::remove_all(scratchDirectory, error);
+
+    // Slr sammen flisene. Hjrner i kanten mellom to fliser finnes i begge, med samme posisjon og normal
+    vertices.clear();
+    normals.clear();
+    indices.clear();
+    for (auto& mesh : meshes)
+    {
+        unsigned int base = static_cast<unsigned int>(vertices.size());
+        vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        normals.insert(normals.end(), mesh.normals.begin(), mesh.normals.end());
+        for (unsigned int index : mesh.indices)
+        {
+            indices.push_back(base + index);
+        }
+        mesh = TileMesh();
+    }
+
+    outCenter = center;
+    boundsMin = gridMin;
+    boundsMax = gridMax;
+
+    std::cout << "Built " << indices.size() / 3 << " triangles from " << pointCount << " points centered around "
+        << center.x << ", " << center.y << ", " << center.z << std::endl;
+    return true;
+}
@@ -0,0 +1,66 @@
+#ifndef STREAMINGTERRAIN_H
+#define STREAMINGTERRAIN_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+class HeightGrid;
+
+// Bygger terrenget fra punktskyer som er for store til  ligge i minnet.
+// Frste runde over filen finner bounding boxen. Andre runde sorterer punktene i fliser som blir skrevet til
+// midlertidige filer, og til slutt blir hydene i hver flis samlet i et HeightGrid og triangulert, innenfor et fast minnebudsjett.
+// Flisene har en kant p to ruter mot naboene, s trianguleringen og normalene blir de samme som nr alt ligger i minnet.
+class StreamingTerrain
+{
+public:
+    StreamingTerrain(float gridSpacing, size_t memoryBudget, bool fullPrecision = false); // fullPrecision leser tekstfiler i double
+
+    // Bygger terrenget. vertices blir hjrnene i trianguleringen (ett per rute), sentrert rundt center.
+    // Med heightGrid blir rutene fra hver flis ogs kopiert inn i ett grid for hele terrenget, til LOD og cachen.
+    // Det koster n HeightCell per rute, mindre enn hjrnene og normalene som uansett ligger i minnet
+    bool Build(const std::string& filename, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals,
+        std::vector<unsigned int>& indices, glm::dvec3& center, glm::vec3& boundsMin, glm::vec3& boundsMax,
+        HeightGrid* heightGrid = nullptr);
+
+    static uint64_t EstimatePointCount(const std::string& filename); // Antall punkter iflge headeren i filen
+
+private:
+    typedef std::function<void(const glm::dvec3* positions, size_t count)> BatchCallback;
+
+    // Leser filen i biter og kaller callback for hver bit med punkter i originale koordinater
+    bool forEachBatch(const std::string& filename, bool reportErrors, const BatchCallback& callback);
+
+    // Resultatet for n flis
+    struct TileMesh
+    {
+        std::vector<glm::vec3> vertices;
+        std::vector<glm::vec3> normals;
+        std::vector<unsigned int> indices;
+    };
+
+    bool binPoints(const std::string& filename); // Andre runde: skriver punktene til flisfilene
+    void buildTile(int tileX, int tileZ, TileMesh& mesh); // Triangulerer n flis
+    std::string tilePath(int tileX, int tileZ) const;
+    glm::ivec2 cellOf(const glm::vec3& point) const; // Ruten et sentrert punkt havner i
+    glm::vec3 centered(const glm::dvec3& position) const; // Sentrerer et punkt p samme mte som PunktSky gjr i minnet
+
+    float gridSpacing;
+    size_t memoryBudget;
+    size_t batchPoints; // Antall punkter som blir lest om gangen
+
+    glm::dvec3 center;
+    glm::vec3 gridMin, gridMax; // Bounding box for de sentrerte punktene
+    int gridWidth, gridHeight; // Antall ruter
+    int tileSize; // Antall ruter per flis i hver retning
+    int tilesX, tilesZ;
+    uint64_t pointCount;
+    bool fullPrecision;
+    bool singlePrecision; // Tekstfiler blir lest og sentrert i float hvis ikke fullPrecision er valgt
+    std::string scratchDirectory;
+    HeightGrid* fullGrid; // Gridet for hele terrenget, eller nullptr
+};
+
+#endif // !STREAMINGTERRAIN_H
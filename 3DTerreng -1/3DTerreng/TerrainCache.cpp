@@ -0,0 +1,213 @@
+#include "TerrainCache.h"
+#include "Parallel.h"
+
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+
+static const char cacheMagic[8] = { 'P', 'S', 'K', 'Y', 'T', 'E', 'R', 'R' };
+
+// Blandefunksjon fra MurmurHash3, sprer alle bitene i h utover hele verdien
+static uint64_t mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Rask ikke-kryptografisk hash av en blokk, 8 bytes om gangen
+static uint64_t hashBlock(const char* data, size_t size, uint64_t seed)
+{
+    uint64_t h = seed ^ (size * 0x9e3779b97f4a7c15ULL);
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; ++i)
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i * 8, 8);
+        h = (h ^ mix(word)) * 0x100000001b3ULL;
+    }
+
+    uint64_t tail = 0;
+    if (size > words * 8)
+    {
+        std::memcpy(&tail, data + words * 8, size - words * 8);
+    }
+    return mix(h ^ tail);
+}
+
+bool TerrainCache::HashFile(const std::string& filename, uint64_t& hash, uint64_t& size)
+{
+    MappedFile source;
+    if (!source.Open(filename))
+    {
+        return false;
+    }
+
+    // Filen blir delt i blokker med fast strrelse, s hashen blir den samme uansett antall trder
+    const size_t blockSize = 1 << 20;
+    size = source.Size();
+    size_t blockCount = (static_cast<size_t>(size) + blockSize - 1) / blockSize;
+    std::vector<uint64_t> blockHashes(blockCount);
+
+    parallelFor(blockCount, [&](size_t first, size_t last, unsigned int)
+    {
+        for (size_t b = first; b < last; ++b)
+        {
+            size_t begin = b * blockSize;
+            size_t length = std::min<size_t>(blockSize, static_cast<size_t>(size) - begin);
+            blockHashes[b] = hashBlock(source.Data() + begin, length, b);
+        }
+    });
+
+    hash = hashBlock(reinterpret_cast<const char*>(blockHashes.data()), blockHashes.size() * sizeof(uint64_t), size);
+    return true;
+}
+
+std::string TerrainCache::CachePath(const std::string& sourceFile)
+{
+    return sourceFile + ".terraincache";
+}
+
+bool TerrainCache::Open(const std::string& cachePath, uint64_t sourceHash, uint64_t sourceSize, float gridSpacing, PointStorage storage,
+    TriangulationMode triangulation, bool outOfCore)
+{
+    Close();
+    if (!file.Open(cachePath) || file.Size() < sizeof(TerrainCacheHeader))
+    {
+        Close();
+        return false;
+    }
+
+    std::memcpy(&header, file.Data(), sizeof(TerrainCacheHeader));
+
+    bool valid = std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0
+        && header.version == Version
+        && header.headerSize == sizeof(TerrainCacheHeader)
+        && header.sourceHash == sourceHash
+        && header.sourceSize == sourceSize
+        && header.gridSpacing == gridSpacing
+        && header.storage == static_cast<uint32_t>(storage)
+        && header.triangulation == static_cast<uint32_t>(triangulation)
+        && header.outOfCore == (outOfCore ? 1u : 0u)
+        && header.gridColumns >= 0 && header.gridRows >= 0;
+
+    // Filstrrelsen m stemme, ellers ble skrivingen avbrutt
+    uint64_t expectedSize = sizeof(TerrainCacheHeader) + (header.pointCount + header.vertexCount * 2) * sizeof(glm::vec3) + header.indexCount * sizeof(unsigned int)
+        + header.quantizedCount * sizeof(glm::ivec3) + static_cast<uint64_t>(header.gridColumns) * header.gridRows * sizeof(HeightCell);
+    if (!valid || expectedSize != file.Size())
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void TerrainCache::Close()
+{
+    file.Close();
+    std::memset(&header, 0, sizeof(header));
+}
+
+const TerrainCacheHeader& TerrainCache::GetHeader() const
+{
+    return header;
+}
+
+const glm::vec3* TerrainCache::GetPoints() const
+{
+    return reinterpret_cast<const glm::vec3*>(file.Data() + sizeof(TerrainCacheHeader));
+}
+
+const glm::vec3* TerrainCache::GetVertices() const
+{
+    return GetPoints() + header.pointCount;
+}
+
+const glm::vec3* TerrainCache::GetNormals() const
+{
+    return GetVertices() + header.vertexCount;
+}
+
+const unsigned int* TerrainCache::GetIndices() const
+{
+    return reinterpret_cast<const unsigned int*>(GetNormals() + header.vertexCount);
+}
+
+const glm::ivec3* TerrainCache::GetQuantizedPoints() const
+{
+    return reinterpret_cast<const glm::ivec3*>(GetIndices() + header.indexCount);
+}
+
+const HeightCell* TerrainCache::GetGridCells() const
+{
+    return reinterpret_cast<const HeightCell*>(GetQuantizedPoints() + header.quantizedCount);
+}
+
+bool TerrainCache::Write(const std::string& cachePath, uint64_t sourceHash, uint64_t sourceSize, float gridSpacing, PointStorage storage,
+    TriangulationMode triangulation, bool outOfCore, const glm::dvec3& center, const glm::vec3& boundsMin, const glm::vec3& boundsMax, const std::vector<glm::vec3>& points,
+    const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, const std::vector<unsigned int>& indices, const QuantizedPoints& quantized,
+    const HeightGrid& grid)
+{
+    TerrainCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = Version;
+    header.headerSize = sizeof(TerrainCacheHeader);
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+    header.gridSpacing = gridSpacing;
+    header.storage = static_cast<uint32_t>(storage);
+    header.triangulation = static_cast<uint32_t>(triangulation);
+    header.outOfCore = outOfCore ? 1 : 0;
+    header.pointCount = points.size();
+    header.vertexCount = vertices.size();
+    header.indexCount = indices.size();
+    header.center = center;
+    header.boundsMin = boundsMin;
+    header.boundsMax = boundsMax;
+    header.quantizationScale = quantized.GetScale();
+    header.quantizedCount = quantized.Size();
+    header.gridColumns = grid.GetColumns();
+    header.gridRows = grid.GetRows();
+    header.gridOrigin = grid.GetOrigin();
+
+    // Skriver til en midlertidig fil frst, s en halvferdig cache aldri blir lest
+    std::string tempPath = cachePath + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        std::cerr << "Warning: Unable to write terrain cache " << cachePath << std::endl;
+        return false;
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(points.data()), points.size() * sizeof(glm::vec3));
+    out.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(glm::vec3));
+    out.write(reinterpret_cast<const char*>(normals.data()), normals.size() * sizeof(glm::vec3));
+    out.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(unsigned int));
+    out.write(reinterpret_cast<const char*>(quantized.GetData().data()), quantized.Size() * sizeof(glm::ivec3));
+    out.write(reinterpret_cast<const char*>(grid.GetCells().data()), grid.GetCells().size() * sizeof(HeightCell));
+    out.close();
+
+    if (!out)
+    {
+        std::cerr << "Warning: Unable to write terrain cache " << cachePath << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    std::remove(cachePath.c_str());
+    if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+    {
+        std::cerr << "Warning: Unable to write terrain cache " << cachePath << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,72 @@
+#ifndef TERRAINCACHE_H
+#define TERRAINCACHE_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "MappedFile.h"
+#include "QuantizedPoints.h"
+#include "DelaunayTriangulation.h"
+#include "HeightGrid.h"
+
+// Headeren i starten av cachefilen. Etter headeren kommer punktene, hjrnene i trianguleringen, normalene og indeksene rett etter hverandre,
+// i samme format som de blir lastet opp til GPU-en, s heltallspunktene hvis punktskyen er kvantisert, og til slutt rutene i hydekartet
+struct TerrainCacheHeader
+{
+    char magic[8]; // "PSKYTERR"
+    uint32_t version;
+    uint32_t headerSize; // sizeof(TerrainCacheHeader), s en endret struct ikke blir lest feil
+    uint64_t sourceHash; // Hash av innholdet i kildefilen
+    uint64_t sourceSize;
+    float gridSpacing; // Rutenettet som trianguleringen ble laget med
+    uint32_t storage; // PointStorage
+    uint64_t pointCount; // 0 nr punktskyen er kvantisert, da ligger punktene bare som heltall
+    uint64_t vertexCount; // Antall hjrner og normaler i trianguleringen
+    uint64_t indexCount;
+    glm::dvec3 center; // Midtpunktet som punktene ble sentrert rundt
+    glm::vec3 boundsMin; // Bounding box for de sentrerte punktene
+    glm::vec3 boundsMax;
+    uint32_t triangulation; // TriangulationMode
+    uint32_t outOfCore; // 1 nr terrenget ble bygd flis for flis fra disk, da er punktene hjrnene i rutenettet
+    glm::dvec3 quantizationScale; // Heltallspunktene har center som origin
+    uint64_t quantizedCount;
+    int32_t gridColumns; // Hydekartet, 0 x 0 nr terrenget ikke ble laget fra et helt hydekart
+    int32_t gridRows;
+    glm::vec2 gridOrigin;
+};
+
+// Binr cache for et ferdig triangulert terreng. Cachen blir lagret ved siden av kildefilen og minnekartlagt
+// neste gang, s punkter, hjrner, normaler og indekser kan sendes rett til glBufferData uten  parse eller triangulere p nytt
+class TerrainCache
+{
+public:
+    static const uint32_t Version = 7;
+
+    bool Open(const std::string& cachePath, uint64_t sourceHash, uint64_t sourceSize, float gridSpacing, PointStorage storage,
+        TriangulationMode triangulation, bool outOfCore); // Returnerer false hvis cachen mangler eller er utdatert
+    void Close();
+
+    const TerrainCacheHeader& GetHeader() const;
+    const glm::vec3* GetPoints() const;
+    const glm::vec3* GetVertices() const;
+    const glm::vec3* GetNormals() const;
+    const unsigned int* GetIndices() const;
+    const glm::ivec3* GetQuantizedPoints() const;
+    const HeightCell* GetGridCells() const;
+
+    static bool Write(const std::string& cachePath, uint64_t sourceHash, uint64_t sourceSize, float gridSpacing, PointStorage storage,
+        TriangulationMode triangulation, bool outOfCore, const glm::dvec3& center, const glm::vec3& boundsMin, const glm::vec3& boundsMax, const std::vector<glm::vec3>& points,
+        const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, const std::vector<unsigned int>& indices, const QuantizedPoints& quantized,
+        const HeightGrid& grid);
+
+    static std::string CachePath(const std::string& sourceFile); // Filnavnet til cachen for en kildefil
+    static bool HashFile(const std::string& filename, uint64_t& hash, uint64_t& size); // Hasher hele filen parallelt
+
+private:
+    MappedFile file;
+    TerrainCacheHeader header;
+};
+
+#endif // !TERRAINCACHE_H
@@ -0,0 +1,629 @@
+#include "TerrainLod.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Retningen til naboen over hver kant: nord, st, sr, vest
+static const int edgeDx[4] = { 0, 1, 0, -1 };
+static const int edgeDz[4] = { -1, 0, 1, 0 };
+
+TerrainLod::TerrainLod()
+{
+    maxDepth = 0;
+    pixelError = 2.0f;
+    frame = 0;
+    selectedChunks = 0;
+    selectedTriangles = 0;
+    sharedInterior = { 0, 0 };
+    for (int e = 0; e < 4; ++e)
+    {
+        sharedEdges[e][0] = { 0, 0 };
+        sharedEdges[e][1] = { 0, 0 };
+    }
+    VAO = 0;
+    VBO = 0;
+    EBO = 0;
+}
+
+TerrainLod::~TerrainLod()
+{
+    if (VAO != 0)
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+    }
+}
+
+void TerrainLod::buildIndices(const std::vector<char>& valid, const std::vector<int>& columns, const std::vector<int>& rows,
+    std::vector<uint16_t>& output, IndexRange& interior, IndexRange (&edges)[4][2]) const
+{
+    const int n = ChunkSize;
+    unsigned int start = static_cast<unsigned int>(output.size());
+
+    // Legger til trekanten hvis alle hjrnene har hyde, med klokka i xz-planet som resten av terrenget
+    auto emit = [&](int i0, int j0, int i1, int j1, int i2, int j2)
+    {
+        int a = j0 * (n + 1) + i0;
+        int b = j1 * (n + 1) + i1;
+        int c = j2 * (n + 1) + i2;
+        if (!valid[a] || !valid[b] || !valid[c])
+        {
+            return;
+        }
+
+        int orientation = (columns[i1] - columns[i0]) * (rows[j2] - rows[j0]) - (rows[j1] - rows[j0]) * (columns[i2] - columns[i0]);
+        if (orientation == 0)
+        {
+            return;
+        }
+        if (orientation > 0)
+        {
+            std::swap(b, c);
+        }
+        output.push_back(static_cast<uint16_t>(a));
+        output.push_back(static_cast<uint16_t>(b));
+        output.push_back(static_cast<uint16_t>(c));
+    };
+
+    // Innsiden: alle rutene som ikke rrer kanten, to trekanter i hver som i gridtrianguleringen
+    interior.first = static_cast<unsigned int>(output.size()) - start;
+    for (int j = 1; j < n - 1; ++j)
+    {
+        for (int i = 1; i < n - 1; ++i)
+        {
+            emit(i, j, i, j + 1, i + 1, j);
+            emit(i + 1, j, i, j + 1, i + 1, j + 1);
+        }
+    }
+    interior.count = static_cast<unsigned int>(output.size()) - start - interior.first;
+
+    // Hver kant er et trapes mellom hjrnene p kanten og hjrnene n rute inn. De to radene blir sydd sammen
+    // ved  g langs begge og alltid ta neste hjrne fra den raden som ligger lengst bak.
+    // Varianten mot et grovere niv bruker bare annethvert hjrne p kanten, som er de naboen ogs har
+    for (int e = 0; e < 4; ++e)
+    {
+        auto point = [&](int t, int layer, int& i, int& j)
+        {
+            switch (e)
+            {
+            case 0: i = t; j = layer; break;
+            case 1: i = n - layer; j = t; break;
+            case 2: i = t; j = n - layer; break;
+            default: i = layer; j = t; break;
+            }
+        };
+
+        for (int variant = 0; variant < 2; ++variant)
+        {
+            std::vector<int> outer;
+            for (int t = 0; t <= n; t += variant == 0 ? 1 : 2)
+            {
+                outer.push_back(t);
+            }
+            std::vector<int> inner;
+            for (int t = 1; t <= n - 1; ++t)
+            {
+                inner.push_back(t);
+            }
+
+            edges[e][variant].first = static_cast<unsigned int>(output.size()) - start;
+            size_t o = 0;
+            size_t m = 0;
+            while (o + 1 < outer.size() || m + 1 < inner.size())
+            {
+                bool advanceOuter = m + 1 >= inner.size() || (o + 1 < outer.size() && outer[o + 1] <= inner[m + 1]);
+                int i0, j0, i1, j1, i2, j2;
+                point(outer[o], 0, i0, j0);
+                if (advanceOuter)
+                {
+                    point(outer[o + 1], 0, i1, j1);
+                    point(inner[m], 1, i2, j2);
+                    ++o;
+                }
+                else
+                {
+                    point(inner[m + 1], 1, i1, j1);
+                    point(inner[m], 1, i2, j2);
+                    ++m;
+                }
+                emit(i0, j0, i1, j1, i2, j2);
+            }
+            edges[e][variant].count = static_cast<unsigned int>(output.size()) - start - edges[e][variant].first;
+        }
+    }
+}
+
+void TerrainLod::buildChunk(const HeightGrid& grid, Chunk& chunk, ChunkMesh& mesh) const
+{
+    const int n = ChunkSize;
+    int stride = 1 << (maxDepth - chunk.depth);
+    int col0 = grid.GetFirstColumn() + chunk.x * n * stride;
+    int row0 = grid.GetFirstRow() + chunk.z * n * stride;
+    float spacing = grid.GetSpacing();
+
+    // Hjrner forbi gridet blir flyttet inn p siste rad og kolonne, s de grove nivene dekker hele terrenget
+    // og kanten blir lik p alle niver. Trekantene mellom to slike hjrner fr null areal
+    int lastCol = std::min(col0 + n * stride, grid.GetFirstColumn() + grid.GetColumns() - 1);
+    int lastRow = std::min(row0 + n * stride, grid.GetFirstRow() + grid.GetRows() - 1);
+    auto sampleCol = [&](int i) { return std::min(col0 + i * stride, lastCol); };
+    auto sampleRow = [&](int j) { return std::min(row0 + j * stride, lastRow); };
+
+    // Hjrnene: hver stride-te rute i hydekartet. Normalene kommer fra hydeforskjellen til nabohjrnene p samme niv
+    size_t vertexCount = static_cast<size_t>(n + 1) * (n + 1);
+    std::vector<char> valid(vertexCount, 0);
+    std::vector<float> heights(vertexCount, 0.0f);
+    mesh.positions.assign(vertexCount, glm::vec3(0.0f));
+    mesh.normals.assign(vertexCount, glm::vec3(0.0f, 1.0f, 0.0f));
+    mesh.complete = true;
+
+    float minHeight = FLT_MAX;
+    float maxHeight = -FLT_MAX;
+    for (int j = 0; j <= n; ++j)
+    {
+        for (int i = 0; i <= n; ++i)
+        {
+            int col = sampleCol(i);
+            int row = sampleRow(j);
+            size_t v = static_cast<size_t>(j) * (n + 1) + i;
+            if (!grid.HasHeight(col, row))
+            {
+                mesh.complete = false;
+                continue;
+            }
+
+            valid[v] = 1;
+            mesh.positions[v] = grid.CellPosition(col, row);
+            heights[v] = mesh.positions[v].y;
+            minHeight = std::min(minHeight, heights[v]);
+            maxHeight = std::max(maxHeight, heights[v]);
+
+            float h = heights[v];
+            bool left = grid.HasHeight(col - stride, row);
+            bool right = grid.HasHeight(col + stride, row);
+            bool up = grid.HasHeight(col, row - stride);
+            bool down = grid.HasHeight(col, row + stride);
+            float dx = static_cast<float>((left ? stride : 0) + (right ? stride : 0)) * spacing;
+            float dz = static_cast<float>((up ? stride : 0) + (down ? stride : 0)) * spacing;
+            float dhdx = dx > 0.0f ? ((right ? grid.GetCell(col + stride, row).mean : h) - (left ? grid.GetCell(col - stride, row).mean : h)) / dx : 0.0f;
+            float dhdz = dz > 0.0f ? ((down ? grid.GetCell(col, row + stride).mean : h) - (up ? grid.GetCell(col, row - stride).mean : h)) / dz : 0.0f;
+            mesh.normals[v] = glm::normalize(glm::vec3(-dhdx, 1.0f, -dhdz));
+        }
+    }
+
+    // Feilen er det strste avviket mellom en rute i hydekartet og trekantene til chunken over den
+    chunk.error = 0.0f;
+    if (stride > 1)
+    {
+        for (int row = row0; row <= lastRow; ++row)
+        {
+            for (int col = col0; col <= lastCol; ++col)
+            {
+                if (!grid.HasHeight(col, row))
+                {
+                    continue;
+                }
+
+                float cellHeight = grid.GetCell(col, row).mean;
+                minHeight = std::min(minHeight, cellHeight);
+                maxHeight = std::max(maxHeight, cellHeight);
+
+                int i = std::min((col - col0) / stride, n - 1);
+                int j = std::min((row - row0) / stride, n - 1);
+                int width = sampleCol(i + 1) - sampleCol(i);
+                int height = sampleRow(j + 1) - sampleRow(j);
+                float fu = width > 0 ? static_cast<float>(col - sampleCol(i)) / width : 0.0f;
+                float fw = height > 0 ? static_cast<float>(row - sampleRow(j)) / height : 0.0f;
+
+                size_t topLeft = static_cast<size_t>(j) * (n + 1) + i;
+                size_t topRight = topLeft + 1;
+                size_t bottomLeft = topLeft + n + 1;
+                size_t bottomRight = bottomLeft + 1;
+                if (!valid[topLeft] || !valid[topRight] || !valid[bottomLeft] || !valid[bottomRight])
+                {
+                    continue;
+                }
+
+                float surface = fu + fw <= 1.0f
+                    ? heights[topLeft] + fu * (heights[topRight] - heights[topLeft]) + fw * (heights[bottomLeft] - heights[topLeft])
+                    : heights[bottomRight] + (1.0f - fu) * (heights[bottomLeft] - heights[bottomRight]) + (1.0f - fw) * (heights[topRight] - heights[bottomRight]);
+                chunk.error = std::max(chunk.error, std::abs(surface - cellHeight));
+            }
+        }
+    }
+
+    // En chunk blir aldri mer nyaktig enn barna sine, s avstanden der den blir delt ker oppover i treet
+    for (int child : chunk.children)
+    {
+        if (child >= 0)
+        {
+            chunk.error = std::max(chunk.error, chunks[child].error);
+            minHeight = std::min(minHeight, chunks[child].boundsMin.y);
+            maxHeight = std::max(maxHeight, chunks[child].boundsMax.y);
+        }
+    }
+
+    glm::vec2 origin = grid.GetOrigin();
+    chunk.boundsMin = glm::vec3(origin.x + (col0 + 0.5f) * spacing, minHeight, origin.y + (row0 + 0.5f) * spacing);
+    chunk.boundsMax = glm::vec3(origin.x + (lastCol + 0.5f) * spacing, maxHeight, origin.y + (lastRow + 0.5f) * spacing);
+
+    if (lastCol < col0 + n * stride || lastRow < row0 + n * stride)
+    {
+        mesh.complete = false;
+    }
+    if (!mesh.complete)
+    {
+        std::vector<int> columns(n + 1);
+        std::vector<int> rows(n + 1);
+        for (int i = 0; i <= n; ++i)
+        {
+            columns[i] = sampleCol(i);
+            rows[i] = sampleRow(i);
+        }
+        buildIndices(valid, columns, rows, mesh.indices, chunk.interior, chunk.edges);
+    }
+}
+
+void TerrainLod::Build(const HeightGrid& grid)
+{
+    chunks.clear();
+    levels.clear();
+    positions.clear();
+    normals.clear();
+    indices.clear();
+    maxDepth = 0;
+
+    int columns = grid.GetColumns();
+    int rows = grid.GetRows();
+    if (columns < 2 || rows < 2)
+    {
+        return;
+    }
+
+    while ((ChunkSize << maxDepth) < std::max(columns, rows) - 1)
+    {
+        ++maxDepth;
+    }
+    levels.resize(maxDepth + 1);
+
+    // Trekantene for chunks uten hull er like for alle, s de ligger bare n gang frst i indeksbufferet
+    std::vector<char> allValid(static_cast<size_t>(ChunkSize + 1) * (ChunkSize + 1), 1);
+    std::vector<int> steps(ChunkSize + 1);
+    for (int i = 0; i <= ChunkSize; ++i)
+    {
+        steps[i] = i;
+    }
+    buildIndices(allValid, steps, steps, indices, sharedInterior, sharedEdges);
+
+    // Fra bladene og opp, s feilen og hyden til barna er klar fr foreldrene
+    for (int depth = maxDepth; depth >= 0; --depth)
+    {
+        int side = 1 << depth;
+        int stride = 1 << (maxDepth - depth);
+        levels[depth].assign(static_cast<size_t>(side) * side, -1);
+
+        std::vector<Chunk> candidates;
+        for (int z = 0; z < side; ++z)
+        {
+            for (int x = 0; x < side; ++x)
+            {
+                // Hopper over chunks som ligger helt utenfor gridet
+                if (x * ChunkSize * stride >= columns || z * ChunkSize * stride >= rows)
+                {
+                    continue;
+                }
+
+                Chunk chunk;
+                chunk.depth = depth;
+                chunk.x = x;
+                chunk.z = z;
+                chunk.splitFrame = 0;
+                bool hasChild = false;
+                for (int c = 0; c < 4; ++c)
+                {
+                    chunk.children[c] = depth < maxDepth ? chunkAt(depth + 1, x * 2 + (c & 1), z * 2 + (c >> 1)) : -1;
+                    hasChild |= chunk.children[c] >= 0;
+                }
+                if (depth < maxDepth && !hasChild)
+                {
+                    continue;
+                }
+                candidates.push_back(chunk);
+            }
+        }
+
+        std::vector<ChunkMesh> meshes(candidates.size());
+        parallelFor(candidates.size(), [&](size_t begin, size_t end, unsigned int)
+        {
+            for (size_t k = begin; k < end; ++k)
+            {
+                buildChunk(grid, candidates[k], meshes[k]);
+            }
+        });
+
+        for (size_t k = 0; k < candidates.size(); ++k)
+        {
+            Chunk& chunk = candidates[k];
+            ChunkMesh& mesh = meshes[k];
+
+            // Et blad uten ett eneste punkt blir ikke med
+            if (depth == maxDepth && chunk.boundsMin.y > chunk.boundsMax.y)
+            {
+                continue;
+            }
+
+            chunk.firstVertex = static_cast<unsigned int>(positions.size());
+            positions.insert(positions.end(), mesh.positions.begin(), mesh.positions.end());
+            normals.insert(normals.end(), mesh.normals.begin(), mesh.normals.end());
+
+            if (mesh.complete)
+            {
+                chunk.interior = sharedInterior;
+                std::copy(&sharedEdges[0][0], &sharedEdges[0][0] + 8, &chunk.edges[0][0]);
+            }
+            else
+            {
+                unsigned int base = static_cast<unsigned int>(indices.size());
+                indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+                chunk.interior.first += base;
+                for (int e = 0; e < 4; ++e)
+                {
+                    chunk.edges[e][0].first += base;
+                    chunk.edges[e][1].first += base;
+                }
+            }
+
+            levels[depth][static_cast<size_t>(chunk.z) * side + chunk.x] = static_cast<int>(chunks.size());
+            chunks.push_back(chunk);
+            mesh = ChunkMesh();
+        }
+    }
+
+    splitLists.assign(maxDepth + 1, std::vector<int>());
+}
+
+void TerrainLod::Upload()
+{
+    if (positions.empty())
+    {
+        return;
+    }
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    // Posisjonene og normalene ligger etter hverandre i samme VBO, som i PunktSky
+    size_t positionBytes = positions.size() * sizeof(glm::vec3);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, 2 * positionBytes, nullptr, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, positionBytes, positions.data());
+    glBufferSubData(GL_ARRAY_BUFFER, positionBytes, positionBytes, normals.data());
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0); // Position
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)positionBytes); // Normal
+    glEnableVertexAttribArray(1);
+
+    glBindVertexArray(0);
+
+    // Alt ligger p GPU-en n
+    std::vector<glm::vec3>().swap(positions);
+    std::vector<glm::vec3>().swap(normals);
+    std::vector<uint16_t>().swap(indices);
+}
+
+int TerrainLod::chunkAt(int depth, int x, int z) const
+{
+    int side = 1 << depth;
+    if (depth < 0 || depth > maxDepth || x < 0 || z < 0 || x >= side || z >= side)
+    {
+        return -1;
+    }
+    return levels[depth][static_cast<size_t>(z) * side + x];
+}
+
+// Deler chunken og alle foreldrene som ikke allerede er delt
+void TerrainLod::split(int index, std::vector<std::vector<int>>& lists)
+{
+    while (index >= 0 && chunks[index].splitFrame != frame)
+    {
+        Chunk& chunk = chunks[index];
+        chunk.splitFrame = frame;
+        lists[chunk.depth].push_back(index);
+        index = chunkAt(chunk.depth - 1, chunk.x >> 1, chunk.z >> 1);
+    }
+}
+
+bool TerrainLod::isVisible(const Chunk& chunk) const
+{
+    for (const auto& plane : frustum)
+    {
+        // Hjrnet av boksen som ligger lengst inn i planet
+        glm::vec3 corner(plane.x > 0.0f ? chunk.boundsMax.x : chunk.boundsMin.x,
+            plane.y > 0.0f ? chunk.boundsMax.y : chunk.boundsMin.y,
+            plane.z > 0.0f ? chunk.boundsMax.z : chunk.boundsMin.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TerrainLod::Select(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, float pixelScale)
+{
+    ++frame;
+    drawCounts.clear();
+    drawOffsets.clear();
+    drawBaseVertices.clear();
+    selectedChunks = 0;
+    selectedTriangles = 0;
+
+    int root = chunks.empty() ? -1 : chunkAt(0, 0, 0);
+    if (root < 0)
+    {
+        return;
+    }
+
+    // Planene i synsfeltet, hentet rett fra radene i matrisen
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        frustum[i * 2] = rows[3] + rows[i];
+        frustum[i * 2 + 1] = rows[3] - rows[i];
+    }
+
+    for (auto& list : splitLists)
+    {
+        list.clear();
+    }
+
+    // Deler chunks der hydeavviket blir mer enn pixelError piksler p skjermen
+    std::vector<int> stack(1, root);
+    while (!stack.empty())
+    {
+        int index = stack.back();
+        stack.pop_back();
+        const Chunk& chunk = chunks[index];
+        if (chunk.depth == maxDepth || !isVisible(chunk))
+        {
+            continue;
+        }
+
+        glm::vec3 outside = glm::max(glm::max(chunk.boundsMin - cameraPosition, cameraPosition - chunk.boundsMax), glm::vec3(0.0f));
+        float distance = glm::length(outside);
+        if (chunk.error * pixelScale > pixelError * distance)
+        {
+            split(index, splitLists);
+            for (int child : chunk.children)
+            {
+                if (child >= 0)
+                {
+                    stack.push_back(child);
+                }
+            }
+        }
+    }
+
+    // Naboer skal aldri vre mer enn ett niv fra hverandre. Nr en chunk er delt, m naboene p samme niv ogs
+    // finnes, alts m foreldrene deres vre delt. Gr fra de dypeste nivene og opp, siden det bare deler grovere chunks
+    for (int depth = maxDepth - 1; depth >= 1; --depth)
+    {
+        for (size_t k = 0; k < splitLists[depth].size(); ++k)
+        {
+            const Chunk& chunk = chunks[splitLists[depth][k]];
+            for (int e = 0; e < 4; ++e)
+            {
+                int neighbourX = chunk.x + edgeDx[e];
+                int neighbourZ = chunk.z + edgeDz[e];
+                int side = 1 << depth;
+                if (neighbourX < 0 || neighbourZ < 0 || neighbourX >= side || neighbourZ >= side)
+                {
+                    continue;
+                }
+                split(chunkAt(depth - 1, neighbourX >> 1, neighbourZ >> 1), splitLists);
+            }
+        }
+    }
+
+    // Tegner bladene i det delte treet. En kant blir sydd mot et grovere niv nr forelderen til naboen ikke er delt
+    auto addRange = [&](const IndexRange& range, unsigned int firstVertex)
+    {
+        if (range.count == 0)
+        {
+            return;
+        }
+        drawCounts.push_back(static_cast<GLsizei>(range.count));
+        drawOffsets.push_back(reinterpret_cast<const void*>(static_cast<size_t>(range.first) * sizeof(uint16_t)));
+        drawBaseVertices.push_back(static_cast<GLint>(firstVertex));
+        selectedTriangles += range.count / 3;
+    };
+
+    stack.assign(1, root);
+    while (!stack.empty())
+    {
+        int index = stack.back();
+        stack.pop_back();
+        const Chunk& chunk = chunks[index];
+        if (chunk.splitFrame == frame)
+        {
+            for (int child : chunk.children)
+            {
+                if (child >= 0)
+                {
+                    stack.push_back(child);
+                }
+            }
+            continue;
+        }
+
+        if (!isVisible(chunk))
+        {
+            continue;
+        }
+
+        ++selectedChunks;
+        addRange(chunk.interior, chunk.firstVertex);
+        for (int e = 0; e < 4; ++e)
+        {
+            int coarser = chunk.depth > 0 ? chunkAt(chunk.depth - 1, (chunk.x + edgeDx[e]) >> 1, (chunk.z + edgeDz[e]) >> 1) : -1;
+            bool stitched = coarser >= 0 && chunks[coarser].splitFrame != frame;
+            addRange(chunk.edges[e][stitched ? 1 : 0], chunk.firstVertex);
+        }
+    }
+}
+
+void TerrainLod::Draw() const
+{
+    if (drawCounts.empty())
+    {
+        return;
+    }
+
+    glBindVertexArray(VAO);
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_SHORT, drawOffsets.data(),
+        static_cast<GLsizei>(drawCounts.size()), drawBaseVertices.data());
+}
+
+void TerrainLod::SetPixelError(float pixels)
+{
+    pixelError = pixels;
+}
+
+float TerrainLod::GetPixelError() const
+{
+    return pixelError;
+}
+
+bool TerrainLod::IsEmpty() const
+{
+    return chunks.empty();
+}
+
+size_t TerrainLod::GetChunkCount() const
+{
+    return chunks.size();
+}
+
+size_t TerrainLod::GetSelectedChunkCount() const
+{
+    return selectedChunks;
+}
+
+size_t TerrainLod::GetSelectedTriangleCount() const
+{
+    return selectedTriangles;
+}
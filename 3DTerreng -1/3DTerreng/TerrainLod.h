@@ -0,0 +1,101 @@
+#ifndef TERRAINLOD_H
+#define TERRAINLOD_H
+
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+#include <vector>
+#include <cstdint>
+
+#include "HeightGrid.h"
+
+// Terreng delt i et quadtree av chunks med ChunkSize x ChunkSize ruter hver. Bladene bruker hver rute i hydekartet,
+// og hvert niv opp bruker annenhver rute av nivet under, s alle chunks har like mange hjrner.
+// Hvert bilde blir chunkene valgt ut fra hvor mange piksler hydeavviket deres blir fra kameraet, og chunks utenfor
+// synsfeltet blir hoppet over. Naboer er aldri mer enn ett niv fra hverandre, og kanten mot et grovere niv
+// blir tegnet uten de ekstra hjrnene, s det ikke blir sprekker. Alle valgte chunks blir tegnet med ett kall.
+class TerrainLod
+{
+public:
+    static const int ChunkSize = 32; // Antall ruter langs hver side av en chunk, m vre et partall
+
+    TerrainLod();
+    ~TerrainLod();
+
+    void Build(const HeightGrid& grid); // Lager alle nivene fra hydekartet
+    void Upload(); // Laster opp hjrner og indekser til GPU-en
+
+    // Velger chunks for dette bildet. viewProjection og cameraPosition er i terrengets koordinater (med model ganget inn),
+    // og pixelScale er skjermhyden / (2 tan(fov / 2)), alts hvor mange piksler n enhet blir p avstand 1
+    void Select(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, float pixelScale);
+    void Draw() const; // Tegner chunkene fra siste Select
+
+    void SetPixelError(float pixels); // Strste tillatte hydeavvik p skjermen, i piksler
+    float GetPixelError() const;
+
+    bool IsEmpty() const;
+    size_t GetChunkCount() const;
+    size_t GetSelectedChunkCount() const;
+    size_t GetSelectedTriangleCount() const;
+
+private:
+    // En del av indeksbufferet
+    struct IndexRange
+    {
+        unsigned int first;
+        unsigned int count;
+    };
+
+    struct Chunk
+    {
+        int depth; // 0 er roten
+        int x, z; // Plassen blant chunkene p samme niv
+        glm::vec3 boundsMin, boundsMax;
+        float error; // Strste hydeavvik mellom denne chunken og rutene den dekker, ogs for alle barna
+        unsigned int firstVertex;
+        IndexRange interior; // Trekantene som ikke ligger langs kanten
+        IndexRange edges[4][2]; // Kantene (nord, st, sr, vest), [0] med alle hjrner og [1] tilpasset et grovere niv
+        int children[4]; // -1 der barnet ikke har noen punkter
+        uint32_t splitFrame; // Chunken er delt i barna sine nr splitFrame == frame
+    };
+
+    // Geometrien til n chunk fr den er sltt sammen med resten
+    struct ChunkMesh
+    {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<uint16_t> indices;
+        bool complete; // Alle hjrnene har hyde og ligger innenfor gridet, s de felles indeksene kan brukes
+    };
+
+    void buildChunk(const HeightGrid& grid, Chunk& chunk, ChunkMesh& mesh) const;
+    // columns og rows er rutene hjrnene ligger p langs hver akse, trekanter med null areal blir hoppet over
+    void buildIndices(const std::vector<char>& valid, const std::vector<int>& columns, const std::vector<int>& rows,
+        std::vector<uint16_t>& output, IndexRange& interior, IndexRange (&edges)[4][2]) const;
+    int chunkAt(int depth, int x, int z) const; // -1 utenfor eller uten punkter
+    void split(int index, std::vector<std::vector<int>>& splitLists);
+    bool isVisible(const Chunk& chunk) const;
+
+    std::vector<Chunk> chunks;
+    std::vector<std::vector<int>> levels; // Indeksen til hver chunk per niv, (1 << depth)^2 plasser
+    int maxDepth;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<uint16_t> indices; // Frst de felles trekantene for chunks uten hull, s chunkene med hull
+    IndexRange sharedInterior;
+    IndexRange sharedEdges[4][2];
+
+    float pixelError;
+    uint32_t frame;
+    glm::vec4 frustum[6];
+    std::vector<std::vector<int>> splitLists; // Delte chunks per niv i dette bildet
+    std::vector<GLsizei> drawCounts;
+    std::vector<const void*> drawOffsets;
+    std::vector<GLint> drawBaseVertices;
+    size_t selectedChunks;
+    size_t selectedTriangles;
+
+    GLuint VAO, VBO, EBO;
+};
+
+#endif // !TERRAINLOD_H
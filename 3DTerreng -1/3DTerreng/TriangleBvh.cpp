@@ -0,0 +1,274 @@
+#include "TriangleBvh.h"
+
+#include <algorithm>
+
+TriangleBvh::TriangleBvh()
+{
+}
+
+void TriangleBvh::Clear()
+{
+    nodes.clear();
+    ax.clear(); ay.clear(); az.clear();
+    abx.clear(); aby.clear(); abz.clear();
+    acx.clear(); acy.clear(); acz.clear();
+    triangles.clear();
+}
+
+void TriangleBvh::Build(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices)
+{
+    Clear();
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    std::vector<glm::vec3> centroids(triangleCount);
+    std::vector<glm::vec3> triangleMin(triangleCount);
+    std::vector<glm::vec3> triangleMax(triangleCount);
+    std::vector<unsigned int> order(triangleCount);
+    parallelFor(triangleCount, [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const glm::vec3& a = vertices[indices[i * 3]];
+            const glm::vec3& b = vertices[indices[i * 3 + 1]];
+            const glm::vec3& c = vertices[indices[i * 3 + 2]];
+            triangleMin[i] = glm::min(a, glm::min(b, c));
+            triangleMax[i] = glm::max(a, glm::max(b, c));
+            centroids[i] = (a + b + c) / 3.0f;
+            order[i] = static_cast<unsigned int>(i);
+        }
+    });
+
+    // Med deling ved medianen har hver bit minst LeafSize / 2 trekanter
+    nodes.reserve(triangleCount / (LeafSize / 2) * 2 + 1);
+    nodes.push_back(Node());
+    buildNode(0, 0, triangleCount, order, centroids, triangleMin, triangleMax);
+
+    // Legger trekantene i hver bit etter hverandre, med starten p en hel SimdFloat
+    const size_t W = SimdFloat::Width;
+    size_t slotCount = 0;
+    for (Node& node : nodes)
+    {
+        if (node.count > 0)
+        {
+            slotCount += (node.count + W - 1) / W * W;
+        }
+    }
+    for (std::vector<float>* list : { &ax, &ay, &az, &abx, &aby, &abz, &acx, &acy, &acz })
+    {
+        list->assign(slotCount, 0.0f);
+    }
+    triangles.assign(slotCount, 0);
+
+    size_t slot = 0;
+    for (Node& node : nodes)
+    {
+        if (node.count == 0)
+        {
+            continue;
+        }
+        size_t begin = node.first;
+        node.first = static_cast<unsigned int>(slot);
+        for (size_t n = 0; n < node.count; ++n)
+        {
+            unsigned int triangle = order[begin + n];
+            const glm::vec3& a = vertices[indices[triangle * 3]];
+            glm::vec3 ab = vertices[indices[triangle * 3 + 1]] - a;
+            glm::vec3 ac = vertices[indices[triangle * 3 + 2]] - a;
+            ax[slot + n] = a.x; ay[slot + n] = a.y; az[slot + n] = a.z;
+            abx[slot + n] = ab.x; aby[slot + n] = ab.y; abz[slot + n] = ab.z;
+            acx[slot + n] = ac.x; acy[slot + n] = ac.y; acz[slot + n] = ac.z;
+            triangles[slot + n] = triangle;
+        }
+        slot += (node.count + W - 1) / W * W;
+    }
+}
+
+void TriangleBvh::buildNode(unsigned int index, size_t begin, size_t end, std::vector<unsigned int>& order,
+    const std::vector<glm::vec3>& centroids, const std::vector<glm::vec3>& triangleMin, const std::vector<glm::vec3>& triangleMax)
+{
+    glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+    glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+    for (size_t i = begin; i < end; ++i)
+    {
+        unsigned int triangle = order[i];
+        boundsMin = glm::min(boundsMin, triangleMin[triangle]);
+        boundsMax = glm::max(boundsMax, triangleMax[triangle]);
+        centroidMin = glm::min(centroidMin, centroids[triangle]);
+        centroidMax = glm::max(centroidMax, centroids[triangle]);
+    }
+    nodes[index].boundsMin = boundsMin;
+    nodes[index].boundsMax = boundsMax;
+
+    if (end - begin <= static_cast<size_t>(LeafSize))
+    {
+        nodes[index].first = static_cast<unsigned int>(begin); // Blir flyttet til plassen i trekantlistene etterp
+        nodes[index].count = static_cast<unsigned int>(end - begin);
+        return;
+    }
+
+    // Deler ved medianen langs aksen der midtpunktene er mest spredt
+    glm::vec3 extent = centroidMax - centroidMin;
+    int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+    size_t middle = (begin + end) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+        [&](unsigned int a, unsigned int b) { return centroids[a][axis] < centroids[b][axis]; });
+
+    unsigned int first = static_cast<unsigned int>(nodes.size());
+    nodes[index].first = first;
+    nodes[index].count = 0;
+    nodes.push_back(Node());
+    nodes.push_back(Node());
+    buildNode(first, begin, middle, order, centroids, triangleMin, triangleMax);
+    buildNode(first + 1, middle, end, order, centroids, triangleMin, triangleMax);
+}
+
+// Avstanden der strlen gr inn i boksen, FLT_MAX nr den bommer eller boksen ligger lenger unna enn best
+static inline float boxEntry(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::vec3& origin, const glm::vec3& inverse, float best)
+{
+    glm::vec3 t1 = (boundsMin - origin) * inverse;
+    glm::vec3 t2 = (boundsMax - origin) * inverse;
+    glm::vec3 entries = glm::min(t1, t2);
+    glm::vec3 exits = glm::max(t1, t2);
+    float entry = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+    float exit = std::min(std::min(exits.x, exits.y), exits.z);
+    return (entry <= exit && entry < best) ? entry : FLT_MAX;
+}
+
+bool TriangleBvh::Intersect(const glm::vec3& origin, const glm::vec3& direction, RayHit& hit, float maxDistance) const
+{
+    hit.distance = FLT_MAX;
+    hit.triangle = 0;
+    hit.u = hit.v = 0.0f;
+    if (nodes.empty())
+    {
+        return false;
+    }
+
+    const int W = SimdFloat::Width;
+    glm::vec3 inverse = 1.0f / direction;
+    SimdFloat ox(origin.x), oy(origin.y), oz(origin.z);
+    SimdFloat dx(direction.x), dy(direction.y), dz(direction.z);
+    SimdFloat zero(0.0f), one(1.0f);
+    float best = maxDistance;
+    bool found = false;
+
+    struct Entry
+    {
+        unsigned int node;
+        float distance;
+    };
+    Entry stack[64];
+    int stackSize = 0;
+    float rootEntry = boxEntry(nodes[0].boundsMin, nodes[0].boundsMax, origin, inverse, best);
+    if (rootEntry != FLT_MAX)
+    {
+        stack[stackSize++] = { 0, rootEntry };
+    }
+
+    while (stackSize > 0)
+    {
+        Entry entry = stack[--stackSize];
+        if (entry.distance >= best)
+        {
+            continue;
+        }
+
+        const Node& node = nodes[entry.node];
+        if (node.count == 0)
+        {
+            // Det nrmeste barnet blir lagt verst p stacken, s det blir testet frst
+            float left = boxEntry(nodes[node.first].boundsMin, nodes[node.first].boundsMax, origin, inverse, best);
+            float right = boxEntry(nodes[node.first + 1].boundsMin, nodes[node.first + 1].boundsMax, origin, inverse, best);
+            Entry nearest = { node.first, left };
+            Entry farthest = { node.first + 1, right };
+            if (right < left)
+            {
+                std::swap(nearest, farthest);
+            }
+            if (farthest.distance != FLT_MAX)
+            {
+                stack[stackSize++] = farthest;
+            }
+            if (nearest.distance != FLT_MAX)
+            {
+                stack[stackSize++] = nearest;
+            }
+            continue;
+        }
+
+        for (unsigned int slot = node.first; slot < node.first + node.count; slot += W)
+        {
+            SimdFloat abX = SimdFloat::Load(&abx[slot]), abY = SimdFloat::Load(&aby[slot]), abZ = SimdFloat::Load(&abz[slot]);
+            SimdFloat acX = SimdFloat::Load(&acx[slot]), acY = SimdFloat::Load(&acy[slot]), acZ = SimdFloat::Load(&acz[slot]);
+
+            // p = direction x ac, determinanten er ab . p
+            SimdFloat px = dy * acZ - dz * acY;
+            SimdFloat py = dz * acX - dx * acZ;
+            SimdFloat pz = dx * acY - dy * acX;
+            SimdFloat inverseDeterminant = one / (abX * px + abY * py + abZ * pz);
+
+            SimdFloat sx = ox - SimdFloat::Load(&ax[slot]);
+            SimdFloat sy = oy - SimdFloat::Load(&ay[slot]);
+            SimdFloat sz = oz - SimdFloat::Load(&az[slot]);
+            SimdFloat u = (sx * px + sy * py + sz * pz) * inverseDeterminant;
+
+            SimdFloat qx = sy * abZ - sz * abY;
+            SimdFloat qy = sz * abX - sx * abZ;
+            SimdFloat qz = sx * abY - sy * abX;
+            SimdFloat v = (dx * qx + dy * qy + dz * qz) * inverseDeterminant;
+            SimdFloat t = (acX * qx + acY * qy + acZ * qz) * inverseDeterminant;
+
+            // Flate trekanter og tomme plasser gir uendelig eller NaN, og da er alle sammenligningene usanne
+            int bits = ((zero <= u) & (zero <= v) & (u + v <= one) & (zero <= t) & (t < SimdFloat(best))).Bits();
+            if (bits == 0)
+            {
+                continue;
+            }
+
+            float ts[SimdFloat::Width], us[SimdFloat::Width], vs[SimdFloat::Width];
+            t.Store(ts);
+            u.Store(us);
+            v.Store(vs);
+            for (int k = 0; k < W; ++k)
+            {
+                if ((bits >> k) & 1 && ts[k] < best)
+                {
+                    best = ts[k];
+                    hit.distance = ts[k];
+                    hit.triangle = triangles[slot + k];
+                    hit.u = us[k];
+                    hit.v = vs[k];
+                    found = true;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+void TriangleBvh::IntersectRays(const glm::vec3* origins, const glm::vec3* directions, size_t count, RayHit* hits, float maxDistance) const
+{
+    // Sm batcher er ikke verdt  starte trder for
+    unsigned int chunks = count >= 4096 ? threadCount() : 1;
+    parallelFor(count, chunks, [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t n = begin; n < end; ++n)
+        {
+            Intersect(origins[n], directions[n], hits[n], maxDistance);
+        }
+    });
+}
+
+bool TriangleBvh::IsEmpty() const
+{
+    return nodes.empty();
+}
+
+size_t TriangleBvh::GetNodeCount() const
+{
+    return nodes.size();
+}
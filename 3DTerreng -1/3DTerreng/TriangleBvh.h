@@ -0,0 +1,66 @@
+#ifndef TRIANGLEBVH_H
+#define TRIANGLEBVH_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <float.h>
+
+#include "SimdFloat.h"
+#include "Parallel.h"
+
+// Frste treff langs en strle
+struct RayHit
+{
+    float distance; // Treffpunktet er origin + distance * direction, FLT_MAX nr strlen ikke treffer noe
+    unsigned int triangle; // Trekanten som ble truffet, indices[3 * triangle] til indices[3 * triangle + 2]
+    float u, v; // Barysentriske koordinater: treffpunktet er (1 - u - v) a + u b + v c
+};
+
+// Bounding volume hierarchy over trekantene i en triangulering. Trekantene blir delt i to ved medianen langs
+// den lengste aksen til bitene har hyst LeafSize trekanter, og hver bit blir lagret som structure of arrays
+// s strlen blir testet mot SimdFloat::Width trekanter om gangen (Mller-Trumbore).
+// Strlene gr gjennom treet med nrmeste barn frst og hopper over bokser lenger unna enn beste treff
+class TriangleBvh
+{
+public:
+    static const int LeafSize = 8; // Hyeste antall trekanter i en bit
+
+    TriangleBvh();
+
+    void Build(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices);
+    void Clear();
+
+    // Gir false og hit.distance = FLT_MAX nr strlen ikke treffer noe nrmere enn maxDistance.
+    // direction trenger ikke vre normalisert, distance er i lengder av direction
+    bool Intersect(const glm::vec3& origin, const glm::vec3& direction, RayHit& hit, float maxDistance = FLT_MAX) const;
+    // Intersect for count strler, delt p trdene nr det er mange
+    void IntersectRays(const glm::vec3* origins, const glm::vec3* directions, size_t count, RayHit* hits,
+        float maxDistance = FLT_MAX) const;
+
+    bool IsEmpty() const;
+    size_t GetNodeCount() const;
+
+private:
+    struct Node
+    {
+        glm::vec3 boundsMin;
+        unsigned int first; // Frste barn (det andre er first + 1), eller frste plass i trekantlistene for en bit
+        glm::vec3 boundsMax;
+        unsigned int count; // Antall trekanter i biten, 0 for noder med barn
+    };
+
+    // Bygger noden for trekantene order[begin, end) og barna under den
+    void buildNode(unsigned int index, size_t begin, size_t end, std::vector<unsigned int>& order,
+        const std::vector<glm::vec3>& centroids, const std::vector<glm::vec3>& triangleMin, const std::vector<glm::vec3>& triangleMax);
+
+    std::vector<Node> nodes; // nodes[0] er roten
+
+    // Hjrne a og kantene b - a og c - a for hver trekant, med hver bit p en plass delelig med SimdFloat::Width.
+    // Tomme plasser p slutten av en bit har kanter lik null og blir aldri truffet
+    std::vector<float> ax, ay, az;
+    std::vector<float> abx, aby, abz;
+    std::vector<float> acx, acy, acz;
+    std::vector<unsigned int> triangles; // Trekanten p hver plass
+};
+
+#endif // !TRIANGLEBVH_H
@@ -1,14 +1,28 @@
 #include "BSplineSurface.h"
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <limits>
 #include <glm/glm.hpp> // For glm::clamp
 
 BSplineSurface::BSplineSurface() 
 {
-    VAO, VBO, EBO = 0;
-    normalVAO, normalVBO = 0;
+    VAO = VBO = EBO = 0;
+    normalVAO = normalVBO = 0;
+    gridRowLength = 0;
+    uDegree = vDegree = 0;
+    uSize = vSize = 0;
+    rational = false;
+    specializedEvaluation = true;
+    projectionGrid.uTiles = projectionGrid.vTiles = 0;
+    bakedModel = glm::mat4(1.0f);
+    bakedDirty = false;
+    bakedRegionMin = glm::vec2(FLT_MAX);
+    bakedRegionMax = glm::vec2(-FLT_MAX);
+    bakedRegionMoved = false;
 
     // Kontrollpunkter for en bikvadratisk B-spline flate
-    controlPoints = 
+    std::vector<glm::vec3> points =
     {
         {0, 0, 0}, {1, 0, 0}, {2, 0, 0}, {3, 0, 0},
         {0, 1, 0}, {1, 1, 2}, {2, 1, 2}, {3, 1, 0},
@@ -16,199 +30,2362 @@ BSplineSurface::BSplineSurface()
     };
 
     // Skjtevektorer
-    uKnots = { 0, 0, 0, 1, 2, 2, 2 }; // 7 skjteverdier for 4 kontrollpunkter + grad 2
-    vKnots = { 0, 0, 0, 1, 1, 1 };    // 6 skjteverdier for 3 kontrollpunkter + grad 2
+    SetControlNet(4, 3, 2, 2, points,
+        { 0, 0, 0, 1, 2, 2, 2 },  // 7 skjteverdier for 4 kontrollpunkter + grad 2
+        { 0, 0, 0, 1, 1, 1 });    // 6 skjteverdier for 3 kontrollpunkter + grad 2
+}
+
+std::vector<float> BSplineSurface::ClampedKnots(int controlCount, int degree)
+{
+    std::vector<float> knots(controlCount + degree + 1);
+    int spans = controlCount - degree;
+    for (int i = 0; i < static_cast<int>(knots.size()); ++i)
+    {
+        knots[i] = static_cast<float>(glm::clamp(i - degree, 0, spans)) / spans;
+    }
+    return knots;
+}
+
+bool BSplineSurface::SetControlNet(int uSize, int vSize, int uDegree, int vDegree, const std::vector<glm::vec3>& points,
+    const std::vector<float>& uKnots, const std::vector<float>& vKnots, const std::vector<float>& weights)
+{
+    if (uDegree < 1 || vDegree < 1 || uDegree > MaxDegree || vDegree > MaxDegree)
+    {
+        std::cerr << "Error: B-spline degree must be between 1 and " << MaxDegree << std::endl;
+        return false;
+    }
+    if (uSize <= uDegree || vSize <= vDegree)
+    {
+        std::cerr << "Error: Need at least degree + 1 control points in each direction" << std::endl;
+        return false;
+    }
+    if (points.size() != static_cast<size_t>(uSize) * vSize)
+    {
+        std::cerr << "Error: Expected " << uSize * vSize << " control points, got " << points.size() << std::endl;
+        return false;
+    }
+
+    std::vector<float> newUKnots = uKnots.empty() ? ClampedKnots(uSize, uDegree) : uKnots;
+    std::vector<float> newVKnots = vKnots.empty() ? ClampedKnots(vSize, vDegree) : vKnots;
+    if (newUKnots.size() != static_cast<size_t>(uSize + uDegree + 1) || newVKnots.size() != static_cast<size_t>(vSize + vDegree + 1))
+    {
+        std::cerr << "Error: Knot vectors must have size + degree + 1 values" << std::endl;
+        return false;
+    }
+    if (!std::is_sorted(newUKnots.begin(), newUKnots.end()) || !std::is_sorted(newVKnots.begin(), newVKnots.end())
+        || newUKnots[uDegree] >= newUKnots[uSize] || newVKnots[vDegree] >= newVKnots[vSize])
+    {
+        std::cerr << "Error: Knot vectors must be non-decreasing with a non-empty parameter range" << std::endl;
+        return false;
+    }
+    if (!weights.empty() && weights.size() != points.size())
+    {
+        std::cerr << "Error: Expected " << points.size() << " weights, got " << weights.size() << std::endl;
+        return false;
+    }
+    if (std::any_of(weights.begin(), weights.end(), [](float weight) { return !(weight > 0.0f); }))
+    {
+        std::cerr << "Error: Control point weights must be positive" << std::endl;
+        return false;
+    }
+
+    this->uSize = uSize;
+    this->vSize = vSize;
+    this->uDegree = uDegree;
+    this->vDegree = vDegree;
+    controlPoints = points;
+    this->uKnots = newUKnots;
+    this->vKnots = newVKnots;
+
+    // Med bare vekter lik 1 er flaten polynomisk, og de vanlige punktene blir brukt direkte
+    rational = std::any_of(weights.begin(), weights.end(), [](float weight) { return weight != 1.0f; });
+    this->weights = rational ? weights : std::vector<float>();
+    weightedPoints.clear();
+    if (rational)
+    {
+        weightedPoints.resize(points.size());
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            weightedPoints[i] = glm::vec4(points[i] * weights[i], weights[i]);
+        }
+    }
+    bezierPatches.clear();
+    projectionGrid.points.clear();
+    rayNodes.clear();
+    bakedDirty = true;
+    return true;
+}
+
+bool BSplineSurface::LoadControlNet(const std::string& filename)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return false;
+    }
+
+    int newUSize = 0, newVSize = 0, newUDegree = 0, newVDegree = 0;
+    if (!(file >> newUSize >> newVSize >> newUDegree >> newVDegree) || newUSize <= 0 || newVSize <= 0)
+    {
+        std::cerr << "Error: Missing or invalid header in " << filename << std::endl;
+        return false;
+    }
+
+    std::vector<glm::vec3> points(static_cast<size_t>(newUSize) * newVSize);
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        if (!(file >> points[i].x >> points[i].y >> points[i].z))
+        {
+            std::cerr << "Error: Failed to read control point " << i << " in " << filename << std::endl;
+            return false;
+        }
+    }
+
+    // Resten av filen er enten ingenting, begge skjtevektorene, eller skjtevektorene og vektene.
+    // Vektene kan ikke st alene, ellers ville de blitt lest som skjteverdier
+    std::vector<float> values;
+    float value;
+    while (file >> value)
+    {
+        values.push_back(value);
+    }
+    if (!file.eof())
+    {
+        std::cerr << "Error: Invalid number after the control points in " << filename << std::endl;
+        return false;
+    }
+
+    size_t uKnotCount = static_cast<size_t>(newUSize + newUDegree + 1);
+    size_t knotCount = uKnotCount + newVSize + newVDegree + 1;
+    if (!values.empty() && values.size() != knotCount && values.size() != knotCount + points.size())
+    {
+        if (values.size() == points.size())
+        {
+            std::cerr << "Error: Weights without knot vectors in " << filename << ", the knots must come first" << std::endl;
+        }
+        else
+        {
+            std::cerr << "Error: Expected " << knotCount << " knots, optionally followed by " << points.size()
+                << " weights, after the control points in " << filename << std::endl;
+        }
+        return false;
+    }
+
+    std::vector<float> newUKnots;
+    std::vector<float> newVKnots;
+    std::vector<float> newWeights;
+    if (!values.empty())
+    {
+        newUKnots.assign(values.begin(), values.begin() + uKnotCount);
+        newVKnots.assign(values.begin() + uKnotCount, values.begin() + knotCount);
+        newWeights.assign(values.begin() + knotCount, values.end());
+    }
+
+    if (!SetControlNet(newUSize, newVSize, newUDegree, newVDegree, points, newUKnots, newVKnots, newWeights))
+    {
+        std::cerr << "Error: Invalid control net in " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool BSplineSurface::SaveControlNet(const std::string& filename) const
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return false;
+    }
+
+    file.precision(9);
+    file << uSize << " " << vSize << " " << uDegree << " " << vDegree << "\n";
+    for (const glm::vec3& point : controlPoints)
+    {
+        file << point.x << " " << point.y << " " << point.z << "\n";
+    }
+    for (float knot : uKnots)
+    {
+        file << knot << " ";
+    }
+    file << "\n";
+    for (float knot : vKnots)
+    {
+        file << knot << " ";
+    }
+    file << "\n";
+    for (float weight : weights)
+    {
+        file << weight << "\n";
+    }
+    return file.good();
+}
+
+int BSplineSurface::GetUDegree() const
+{
+    return uDegree;
+}
+
+int BSplineSurface::GetVDegree() const
+{
+    return vDegree;
+}
+
+int BSplineSurface::GetUSize() const
+{
+    return uSize;
+}
+
+int BSplineSurface::GetVSize() const
+{
+    return vSize;
+}
+
+const std::vector<glm::vec3>& BSplineSurface::GetControlPoints() const
+{
+    return controlPoints;
+}
+
+const std::vector<float>& BSplineSurface::GetUKnots() const
+{
+    return uKnots;
+}
+
+const std::vector<float>& BSplineSurface::GetVKnots() const
+{
+    return vKnots;
+}
+
+bool BSplineSurface::SetControlPoint(int i, int j, const glm::vec3& position)
+{
+    if (i < 0 || j < 0 || i >= uSize || j >= vSize)
+    {
+        std::cerr << "Error: Control point (" << i << ", " << j << ") is outside the control net" << std::endl;
+        return false;
+    }
+
+    // Flaten over omrdet kontrollpunktet pvirker ligger inne i det konvekse skallet til kontrollpunktene
+    // (i - uDegree .. i + uDegree, j - vDegree .. j + vDegree). Boksen rundt skallet i x og z fr og etter flyttingen
+    // dekker alle punktene i det bakte feltet som kan endre seg
+    auto markBaked = [&]()
+    {
+        for (int b = std::max(j - vDegree, 0); b <= std::min(j + vDegree, vSize - 1); ++b)
+        {
+            for (int a = std::max(i - uDegree, 0); a <= std::min(i + uDegree, uSize - 1); ++a)
+            {
+                glm::vec3 point = glm::vec3(bakedModel * glm::vec4(controlPoints[static_cast<size_t>(b) * uSize + a], 1.0f));
+                bakedRegionMin = glm::min(bakedRegionMin, glm::vec2(point.x, point.z));
+                bakedRegionMax = glm::max(bakedRegionMax, glm::vec2(point.x, point.z));
+            }
+        }
+    };
+
+    size_t index = static_cast<size_t>(j) * uSize + i;
+    bool baked = !bakedHeights.IsEmpty();
+    if (baked)
+    {
+        glm::vec3 before = glm::vec3(bakedModel * glm::vec4(controlPoints[index], 1.0f));
+        glm::vec3 after = glm::vec3(bakedModel * glm::vec4(position, 1.0f));
+        bakedRegionMoved = bakedRegionMoved || before.x != after.x || before.z != after.z;
+        markBaked();
+    }
+    controlPoints[index] = position;
+    if (rational)
+    {
+        weightedPoints[index] = glm::vec4(position * weights[index], weights[index]);
+    }
+    if (baked)
+    {
+        markBaked();
+    }
+    bezierPatches.clear();
+    projectionGrid.points.clear();
+    rayNodes.clear();
+    if (surfacePoints.empty())
+    {
+        return true;
+    }
+
+    // Punktene i meshet som ligger i omrdet basisfunksjonen til kontrollpunktet ikke er null, som sammenhengende
+    // biter [first, end) av punktlista
+    float uLow = uKnots[i], uHigh = uKnots[i + uDegree + 1];
+    float vLow = vKnots[j], vHigh = vKnots[j + vDegree + 1];
+    auto inside = [&](const glm::vec2& parameter)
+    {
+        return parameter.x >= uLow && parameter.x <= uHigh && parameter.y >= vLow && parameter.y <= vHigh;
+    };
+    std::vector<std::pair<size_t, size_t>> runs;
+    auto add = [&](size_t first, size_t end)
+    {
+        if (!runs.empty() && runs.back().second == first)
+        {
+            runs.back().second = end;
+        }
+        else
+        {
+            runs.push_back(std::make_pair(first, end));
+        }
+    };
+
+    if (gridRowLength > 0)
+    {
+        // I rutenettet er omrdet et rektangel av linjer og kolonner
+        size_t lines = meshParameters.size() / gridRowLength;
+        size_t firstColumn = 0;
+        while (firstColumn < gridRowLength && meshParameters[firstColumn].y < vLow)
+        {
+            ++firstColumn;
+        }
+        size_t endColumn = firstColumn;
+        while (endColumn < gridRowLength && meshParameters[endColumn].y <= vHigh)
+        {
+            ++endColumn;
+        }
+        for (size_t line = 0; line < lines && endColumn > firstColumn; ++line)
+        {
+            float u = meshParameters[line * gridRowLength].x;
+            if (u >= uLow && u <= uHigh)
+            {
+                add(line * gridRowLength + firstColumn, line * gridRowLength + endColumn);
+            }
+        }
+    }
+    else
+    {
+        for (size_t n = 0; n < meshParameters.size(); ++n)
+        {
+            if (inside(meshParameters[n]))
+            {
+                add(n, n + 1);
+            }
+        }
+    }
+
+    std::vector<float> uParameters, vParameters;
+    for (const auto& run : runs)
+    {
+        for (size_t n = run.first; n < run.second; ++n)
+        {
+            uParameters.push_back(meshParameters[n].x);
+            vParameters.push_back(meshParameters[n].y);
+        }
+    }
+    if (uParameters.empty())
+    {
+        return true;
+    }
+
+    SurfaceBatch batch;
+    EvaluateBatch(uParameters.data(), vParameters.data(), uParameters.size(), batch, true);
+    size_t k = 0;
+    for (const auto& run : runs)
+    {
+        for (size_t n = run.first; n < run.second; ++n, ++k)
+        {
+            SurfaceSample sample;
+            sample.position = glm::vec3(batch.x[k], batch.y[k], batch.z[k]);
+            sample.du = glm::vec3(batch.dux[k], batch.duy[k], batch.duz[k]);
+            sample.dv = glm::vec3(batch.dvx[k], batch.dvy[k], batch.dvz[k]);
+            surfacePoints[n] = sample.position;
+            normals[n] = SampleNormal(sample);
+        }
+        UploadVertices(run.first, run.second - run.first);
+    }
+    return true;
+}
+
+const std::vector<float>& BSplineSurface::GetWeights() const
+{
+    return weights;
+}
+
+bool BSplineSurface::IsRational() const
+{
+    return rational;
+}
+
+float BSplineSurface::GetUMin() const
+{
+    return uKnots[uDegree];
+}
+
+float BSplineSurface::GetUMax() const
+{
+    return uKnots[uSize];
+}
+
+float BSplineSurface::GetVMin() const
+{
+    return vKnots[vDegree];
+}
+
+float BSplineSurface::GetVMax() const
+{
+    return vKnots[vSize];
 }
 
 BSplineSurface::~BSplineSurface()
 {
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteVertexArrays(1, &normalVAO);
+    glDeleteBuffers(1, &normalVBO);
+}
+
+// Binrsk i skjtevektoren. Bare intervallene fra knots[degree] til knots[controlCount] er en del av flaten,
+// og t helt i slutten hrer til det siste intervallet
+int BSplineSurface::FindKnotSpan(int degree, int controlCount, float t, const std::vector<float>& knots) const
+{
+    if (t >= knots[controlCount])
+    {
+        int span = controlCount - 1;
+        while (span > degree && knots[span] == knots[span + 1])
+        {
+            --span;
+        }
+        return span;
+    }
+
+    // Strste span i [degree, controlCount - 1] med knots[span] <= t. Sket har ingen hopp som avhenger av t,
+    // s det gr like fort nr parameterne kommer i tilfeldig rekkeflge
+    int span = degree;
+    int length = controlCount - degree;
+    while (length > 1)
+    {
+        int half = length / 2;
+        span = knots[span + half] <= t ? span + half : span;
+        length -= half;
+    }
+    return span;
+}
+
+// Cox-de Boor uten rekursjon: bygger trekanten av basisfunksjoner fra grad 0 og opp, og bruker bare de
+// degree + 1 funksjonene som er forskjellige fra null i intervallet. basis[k] er funksjonen til kontrollpunkt span - degree + k
+void BSplineSurface::BasisFunctions(int span, int degree, float t, const std::vector<float>& knots, float* basis) const
+{
+    float left[MaxDegree + 1];
+    float right[MaxDegree + 1];
+
+    basis[0] = 1.0f;
+    for (int j = 1; j <= degree; ++j)
+    {
+        left[j] = t - knots[span + 1 - j];
+        right[j] = knots[span + j] - t;
+        float saved = 0.0f;
+        for (int r = 0; r < j; ++r)
+        {
+            float temp = basis[r] / (right[r + 1] + left[j - r]);
+            basis[r] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+        }
+        basis[j] = saved;
+    }
+}
+
+// Derivatene kommer fra samme trekant som basisfunksjonene: ndu holder basisfunksjonene av alle grader over
+// diagonalen og forskjellene mellom skjteverdiene under, og hvert derivat er en vektet differanse av
+// funksjoner av lavere grad (The NURBS Book, algoritme A2.3)
+void BSplineSurface::BasisFunctionDerivatives(int span, int degree, int derivativeCount, float t, const std::vector<float>& knots, float (*derivatives)[MaxDegree + 1]) const
+{
+    float ndu[MaxDegree + 1][MaxDegree + 1];
+    float left[MaxDegree + 1];
+    float right[MaxDegree + 1];
+
+    ndu[0][0] = 1.0f;
+    for (int j = 1; j <= degree; ++j)
+    {
+        left[j] = t - knots[span + 1 - j];
+        right[j] = knots[span + j] - t;
+        float saved = 0.0f;
+        for (int r = 0; r < j; ++r)
+        {
+            ndu[j][r] = right[r + 1] + left[j - r];
+            float temp = ndu[r][j - 1] / ndu[j][r];
+            ndu[r][j] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+        }
+        ndu[j][j] = saved;
+    }
+
+    for (int j = 0; j <= degree; ++j)
+    {
+        derivatives[0][j] = ndu[j][degree];
+    }
+
+    // Derivater hyere enn graden er null
+    int count = std::min(derivativeCount, degree);
+    for (int k = count + 1; k <= derivativeCount; ++k)
+    {
+        for (int j = 0; j <= degree; ++j)
+        {
+            derivatives[k][j] = 0.0f;
+        }
+    }
+
+    float a[2][MaxDegree + 1];
+    for (int r = 0; r <= degree; ++r)
+    {
+        int s1 = 0;
+        int s2 = 1;
+        a[0][0] = 1.0f;
+        for (int k = 1; k <= count; ++k)
+        {
+            float d = 0.0f;
+            int rk = r - k;
+            int pk = degree - k;
+            if (r >= k)
+            {
+                a[s2][0] = a[s1][0] / ndu[pk + 1][rk];
+                d = a[s2][0] * ndu[rk][pk];
+            }
+            int j1 = rk >= -1 ? 1 : -rk;
+            int j2 = r - 1 <= pk ? k - 1 : degree - r;
+            for (int j = j1; j <= j2; ++j)
+            {
+                a[s2][j] = (a[s1][j] - a[s1][j - 1]) / ndu[pk + 1][rk + j];
+                d += a[s2][j] * ndu[rk + j][pk];
+            }
+            if (r <= pk)
+            {
+                a[s2][k] = -a[s1][k - 1] / ndu[pk + 1][r];
+                d += a[s2][k] * ndu[r][pk];
+            }
+            derivatives[k][r] = d;
+            std::swap(s1, s2);
+        }
+    }
+
+    // Ganger med degree * (degree - 1) * ... for hvert derivat
+    float factor = static_cast<float>(degree);
+    for (int k = 1; k <= count; ++k)
+    {
+        for (int j = 0; j <= degree; ++j)
+        {
+            derivatives[k][j] *= factor;
+        }
+        factor *= static_cast<float>(degree - k);
+    }
+}
+
+// Gjr summene av kontrollpunktene om til et punkt med derivater. sums er posisjon, u, v, uu, uv og vv
+static SurfaceSample netSample(const glm::vec3* sums)
+{
+    SurfaceSample sample;
+    sample.position = sums[0];
+    sample.du = sums[1];
+    sample.dv = sums[2];
+    sample.duu = sums[3];
+    sample.duv = sums[4];
+    sample.dvv = sums[5];
+    return sample;
+}
+
+// For homogene punkter (w x, w y, w z, w) er flaten S = A / w, og derivatene kommer fra kvotientregelen
+// brukt p A = w S (The NURBS Book, ligning 4.20)
+static SurfaceSample netSample(const glm::vec4* sums)
+{
+    float w = sums[0].w;
+    float wu = sums[1].w, wv = sums[2].w;
+    float inverse = 1.0f / w;
+
+    SurfaceSample sample;
+    sample.position = glm::vec3(sums[0]) * inverse;
+    sample.du = (glm::vec3(sums[1]) - wu * sample.position) * inverse;
+    sample.dv = (glm::vec3(sums[2]) - wv * sample.position) * inverse;
+    sample.duu = (glm::vec3(sums[3]) - 2.0f * wu * sample.du - sums[3].w * sample.position) * inverse;
+    sample.duv = (glm::vec3(sums[4]) - wu * sample.dv - wv * sample.du - sums[4].w * sample.position) * inverse;
+    sample.dvv = (glm::vec3(sums[5]) - 2.0f * wv * sample.dv - sums[5].w * sample.position) * inverse;
+    return sample;
+}
+
+static glm::vec3 netPosition(const glm::vec4& sum)
+{
+    return glm::vec3(sum) / sum.w;
+}
+
+// Summerer hver rad av kontrollpunkter med basisfunksjonene i u frst, og bruker radsummene til alle derivatene
+template <typename Point>
+static SurfaceSample sumDerivatives(const Point* first, int rowStride, int uDegree, int vDegree,
+    const float (*Nu)[BSplineSurface::MaxDegree + 1], const float (*Nv)[BSplineSurface::MaxDegree + 1], bool secondDerivatives)
+{
+    Point sums[6];
+    std::fill(sums, sums + 6, Point(0.0f));
+    for (int l = 0; l <= vDegree; ++l)
+    {
+        const Point* row = first + static_cast<size_t>(l) * rowStride;
+        Point row0(0.0f), row1(0.0f), row2(0.0f);
+        for (int k = 0; k <= uDegree; ++k)
+        {
+            row0 += Nu[0][k] * row[k];
+            row1 += Nu[1][k] * row[k];
+            if (secondDerivatives)
+            {
+                row2 += Nu[2][k] * row[k];
+            }
+        }
+
+        sums[0] += Nv[0][l] * row0;
+        sums[1] += Nv[0][l] * row1;
+        sums[2] += Nv[1][l] * row0;
+        if (secondDerivatives)
+        {
+            sums[3] += Nv[0][l] * row2;
+            sums[4] += Nv[1][l] * row1;
+            sums[5] += Nv[2][l] * row0;
+        }
+    }
+    return netSample(sums);
+}
+
+SurfaceSample BSplineSurface::EvaluateDerivatives(float u, float v, bool secondDerivatives) const
+{
+    // Graden velger en utrullet evaluator direkte, s den kan inlines i lkkene som kaller EvaluateDerivatives
+    if (!secondDerivatives && specializedEvaluation && uDegree <= 3 && vDegree <= 3)
+    {
+        switch (uDegree * 4 + vDegree)
+        {
+        case 1 * 4 + 1: return EvaluateFixed<1, 1>(u, v);
+        case 1 * 4 + 2: return EvaluateFixed<1, 2>(u, v);
+        case 1 * 4 + 3: return EvaluateFixed<1, 3>(u, v);
+        case 2 * 4 + 1: return EvaluateFixed<2, 1>(u, v);
+        case 2 * 4 + 2: return EvaluateFixed<2, 2>(u, v);
+        case 2 * 4 + 3: return EvaluateFixed<2, 3>(u, v);
+        case 3 * 4 + 1: return EvaluateFixed<3, 1>(u, v);
+        case 3 * 4 + 2: return EvaluateFixed<3, 2>(u, v);
+        case 3 * 4 + 3: return EvaluateFixed<3, 3>(u, v);
+        default: break;
+        }
+    }
+
+    int order = secondDerivatives ? 2 : 1;
+    int uSpan = FindKnotSpan(uDegree, uSize, u, uKnots);
+    int vSpan = FindKnotSpan(vDegree, vSize, v, vKnots);
+    float Nu[3][MaxDegree + 1]; // Nu[k] er k-te derivat av basisfunksjonene i u retning
+    float Nv[3][MaxDegree + 1];
+    BasisFunctionDerivatives(uSpan, uDegree, order, u, uKnots, Nu);
+    BasisFunctionDerivatives(vSpan, vDegree, order, v, vKnots, Nv);
+
+    size_t first = static_cast<size_t>(vSpan - vDegree) * uSize + uSpan - uDegree;
+    if (rational)
+    {
+        return sumDerivatives(&weightedPoints[first], uSize, uDegree, vDegree, Nu, Nv, secondDerivatives);
+    }
+    return sumDerivatives(&controlPoints[first], uSize, uDegree, vDegree, Nu, Nv, secondDerivatives);
+}
+
+// Samme trekant som BasisFunctions, men for en hel SimdFloat med parametere. Bare skjteverdiene blir hentet
+// hver for seg siden hver parameter kan ligge i et eget span. Frstederivatet faller ut av siste rad i trekanten:
+// temp[r] er N(r, degree - 1) delt p lengden av intervallet, og derivatet er degree * (temp[r - 1] - temp[r])
+void BSplineSurface::BatchBasisFunctions(const int* spans, int degree, const SimdFloat& t, const std::vector<float>& knots,
+    SimdFloat* basis, SimdFloat* derivatives) const
+{
+    const int W = SimdFloat::Width;
+    SimdFloat left[MaxDegree + 1];
+    SimdFloat right[MaxDegree + 1];
+    SimdFloat temps[MaxDegree + 1];
+    float gathered[W];
+
+    basis[0] = SimdFloat(1.0f);
+    for (int j = 1; j <= degree; ++j)
+    {
+        for (int lane = 0; lane < W; ++lane)
+        {
+            gathered[lane] = knots[spans[lane] + 1 - j];
+        }
+        left[j] = t - SimdFloat::Load(gathered);
+        for (int lane = 0; lane < W; ++lane)
+        {
+            gathered[lane] = knots[spans[lane] + j];
+        }
+        right[j] = SimdFloat::Load(gathered) - t;
+
+        SimdFloat saved(0.0f);
+        for (int r = 0; r < j; ++r)
+        {
+            SimdFloat temp = basis[r] / (right[r + 1] + left[j - r]);
+            temps[r] = temp;
+            basis[r] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+        }
+        basis[j] = saved;
+    }
+
+    if (derivatives != nullptr)
+    {
+        SimdFloat scale(static_cast<float>(degree));
+        SimdFloat zero(0.0f);
+        for (int r = 0; r <= degree; ++r)
+        {
+            derivatives[r] = scale * ((r > 0 ? temps[r - 1] : zero) - (r < degree ? temps[r] : zero));
+        }
+    }
+}
+
+void BSplineSurface::EvaluateBatchBlock(const float* u, const float* v, size_t count, SurfaceBatch& output, size_t offset, bool derivatives) const
+{
+    const int W = SimdFloat::Width;
+
+    // Den siste blokken blir fylt opp med den siste parameteren, og bare de gyldige verdiene blir skrevet tilbake
+    float uLanes[W], vLanes[W];
+    int uSpans[W], vSpans[W];
+    for (int lane = 0; lane < W; ++lane)
+    {
+        size_t n = offset + std::min<size_t>(lane, count - offset - 1);
+        uLanes[lane] = glm::clamp(u[n], GetUMin(), GetUMax());
+        vLanes[lane] = glm::clamp(v[n], GetVMin(), GetVMax());
+        uSpans[lane] = FindKnotSpan(uDegree, uSize, uLanes[lane], uKnots);
+        vSpans[lane] = FindKnotSpan(vDegree, vSize, vLanes[lane], vKnots);
+    }
+
+    SimdFloat Bu[MaxDegree + 1], BuPrime[MaxDegree + 1];
+    SimdFloat Bv[MaxDegree + 1], BvPrime[MaxDegree + 1];
+    BatchBasisFunctions(uSpans, uDegree, SimdFloat::Load(uLanes), uKnots, Bu, derivatives ? BuPrime : nullptr);
+    BatchBasisFunctions(vSpans, vDegree, SimdFloat::Load(vLanes), vKnots, Bv, derivatives ? BvPrime : nullptr);
+
+    SimdFloat zero(0.0f);
+    SimdFloat x = zero, y = zero, z = zero;
+    SimdFloat dux = zero, duy = zero, duz = zero;
+    SimdFloat dvx = zero, dvy = zero, dvz = zero;
+    SimdFloat w = zero, dwu = zero, dwv = zero; // Vekten og derivatene dens, bare for rasjonale flater
+    float cx[W], cy[W], cz[W], cw[W];
+    for (int l = 0; l <= vDegree; ++l)
+    {
+        SimdFloat rowX = zero, rowY = zero, rowZ = zero, rowW = zero;
+        SimdFloat rowUx = zero, rowUy = zero, rowUz = zero, rowUw = zero;
+        for (int k = 0; k <= uDegree; ++k)
+        {
+            for (int lane = 0; lane < W; ++lane)
+            {
+                size_t index = static_cast<size_t>(vSpans[lane] - vDegree + l) * uSize + uSpans[lane] - uDegree + k;
+                if (rational)
+                {
+                    const glm::vec4& point = weightedPoints[index];
+                    cx[lane] = point.x;
+                    cy[lane] = point.y;
+                    cz[lane] = point.z;
+                    cw[lane] = point.w;
+                }
+                else
+                {
+                    const glm::vec3& point = controlPoints[index];
+                    cx[lane] = point.x;
+                    cy[lane] = point.y;
+                    cz[lane] = point.z;
+                }
+            }
+            SimdFloat px = SimdFloat::Load(cx), py = SimdFloat::Load(cy), pz = SimdFloat::Load(cz);
+            rowX += Bu[k] * px;
+            rowY += Bu[k] * py;
+            rowZ += Bu[k] * pz;
+            if (derivatives)
+            {
+                rowUx += BuPrime[k] * px;
+                rowUy += BuPrime[k] * py;
+                rowUz += BuPrime[k] * pz;
+            }
+            if (rational)
+            {
+                SimdFloat pw = SimdFloat::Load(cw);
+                rowW += Bu[k] * pw;
+                if (derivatives)
+                {
+                    rowUw += BuPrime[k] * pw;
+                }
+            }
+        }
+
+        x += Bv[l] * rowX;
+        y += Bv[l] * rowY;
+        z += Bv[l] * rowZ;
+        if (derivatives)
+        {
+            dux += Bv[l] * rowUx;
+            duy += Bv[l] * rowUy;
+            duz += Bv[l] * rowUz;
+            dvx += BvPrime[l] * rowX;
+            dvy += BvPrime[l] * rowY;
+            dvz += BvPrime[l] * rowZ;
+        }
+        if (rational)
+        {
+            w += Bv[l] * rowW;
+            if (derivatives)
+            {
+                dwu += Bv[l] * rowUw;
+                dwv += BvPrime[l] * rowW;
+            }
+        }
+    }
+
+    // Rasjonal flate: S = A / w og S' = (A' - w' S) / w
+    if (rational)
+    {
+        SimdFloat inverse = SimdFloat(1.0f) / w;
+        x = x * inverse;
+        y = y * inverse;
+        z = z * inverse;
+        if (derivatives)
+        {
+            dux = (dux - dwu * x) * inverse;
+            duy = (duy - dwu * y) * inverse;
+            duz = (duz - dwu * z) * inverse;
+            dvx = (dvx - dwv * x) * inverse;
+            dvy = (dvy - dwv * y) * inverse;
+            dvz = (dvz - dwv * z) * inverse;
+        }
+    }
+
+    size_t valid = std::min<size_t>(W, count - offset);
+    auto store = [&](const SimdFloat& value, std::vector<float>& destination)
+    {
+        if (valid == static_cast<size_t>(W))
+        {
+            value.Store(&destination[offset]);
+            return;
+        }
+        float lanes[W];
+        value.Store(lanes);
+        std::copy(lanes, lanes + valid, &destination[offset]);
+    };
+
+    store(x, output.x);
+    store(y, output.y);
+    store(z, output.z);
+    if (derivatives)
+    {
+        store(dux, output.dux);
+        store(duy, output.duy);
+        store(duz, output.duz);
+        store(dvx, output.dvx);
+        store(dvy, output.dvy);
+        store(dvz, output.dvz);
+    }
+}
+
+void BSplineSurface::EvaluateBatch(const float* u, const float* v, size_t count, SurfaceBatch& output, bool derivatives) const
+{
+    output.x.resize(count);
+    output.y.resize(count);
+    output.z.resize(count);
+    if (derivatives)
+    {
+        output.dux.resize(count);
+        output.duy.resize(count);
+        output.duz.resize(count);
+        output.dvx.resize(count);
+        output.dvy.resize(count);
+        output.dvz.resize(count);
+    }
+
+    // Sm batcher er ikke verdt  starte trder for
+    const size_t W = SimdFloat::Width;
+    size_t blocks = (count + W - 1) / W;
+    unsigned int chunks = count >= 16384 ? threadCount() : 1;
+    parallelFor(blocks, chunks, [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t block = begin; block < end; ++block)
+        {
+            EvaluateBatchBlock(u, v, count, output, block * W, derivatives);
+        }
+    });
+}
+
+glm::vec3 BSplineSurface::SampleNormal(const SurfaceSample& sample)
+{
+    glm::vec3 normal = glm::cross(sample.du, sample.dv);
+    float length = glm::length(normal);
+    return length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+// Gausskrumning og middelkrumning fra frste og andre fundamentalform
+void BSplineSurface::SampleCurvature(const SurfaceSample& sample, float& gaussian, float& mean)
+{
+    glm::vec3 normal = SampleNormal(sample);
+    float E = glm::dot(sample.du, sample.du);
+    float F = glm::dot(sample.du, sample.dv);
+    float G = glm::dot(sample.dv, sample.dv);
+    float L = glm::dot(sample.duu, normal);
+    float M = glm::dot(sample.duv, normal);
+    float N = glm::dot(sample.dvv, normal);
+
+    float determinant = E * G - F * F;
+    if (determinant <= 0.0f)
+    {
+        gaussian = 0.0f;
+        mean = 0.0f;
+        return;
+    }
+    gaussian = (L * N - M * M) / determinant;
+    mean = (E * N - 2.0f * F * M + G * L) / (2.0f * determinant);
+}
+
+// Basisfunksjonene og frstederivatene for en grad som er kjent ved kompilering. Samme trekant
+// som BasisFunctions, og derivatet kommer fra siste rad som i BatchBasisFunctions
+template <int P>
+static inline void fixedBasisFunctions(int span, float t, const float* knots, float (&basis)[P + 1], float (&derivatives)[P + 1])
+{
+    float left[P + 1];
+    float right[P + 1];
+    float temps[P + 1];
+
+    basis[0] = 1.0f;
+    for (int j = 1; j <= P; ++j)
+    {
+        left[j] = t - knots[span + 1 - j];
+        right[j] = knots[span + j] - t;
+        float saved = 0.0f;
+        for (int r = 0; r < j; ++r)
+        {
+            float temp = basis[r] / (right[r + 1] + left[j - r]);
+            temps[r] = temp;
+            basis[r] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+        }
+        basis[j] = saved;
+    }
+
+    derivatives[0] = -P * temps[0];
+    for (int r = 1; r < P; ++r)
+    {
+        derivatives[r] = P * (temps[r - 1] - temps[r]);
+    }
+    derivatives[P] = P * temps[P - 1];
+}
+
+template <int P, int Q, typename Point>
+static inline SurfaceSample sumFixed(const Point* first, int rowStride, const float (&Bu)[P + 1], const float (&BuPrime)[P + 1],
+    const float (&Bv)[Q + 1], const float (&BvPrime)[Q + 1])
+{
+    Point sums[6];
+    std::fill(sums, sums + 6, Point(0.0f));
+    for (int l = 0; l <= Q; ++l)
+    {
+        const Point* row = first + l * rowStride;
+        Point row0(0.0f), row1(0.0f);
+        for (int k = 0; k <= P; ++k)
+        {
+            row0 += Bu[k] * row[k];
+            row1 += BuPrime[k] * row[k];
+        }
+
+        sums[0] += Bv[l] * row0;
+        sums[1] += Bv[l] * row1;
+        sums[2] += BvPrime[l] * row0;
+    }
+    return netSample(sums);
+}
+
+template <int P, int Q>
+SurfaceSample BSplineSurface::EvaluateFixed(float u, float v) const
+{
+    int uSpan = FindKnotSpan(P, uSize, u, uKnots);
+    int vSpan = FindKnotSpan(Q, vSize, v, vKnots);
+    float Bu[P + 1], BuPrime[P + 1];
+    float Bv[Q + 1], BvPrime[Q + 1];
+    fixedBasisFunctions<P>(uSpan, u, uKnots.data(), Bu, BuPrime);
+    fixedBasisFunctions<Q>(vSpan, v, vKnots.data(), Bv, BvPrime);
+
+    size_t first = static_cast<size_t>(vSpan - Q) * uSize + uSpan - P;
+    if (rational)
+    {
+        return sumFixed<P, Q>(&weightedPoints[first], uSize, Bu, BuPrime, Bv, BvPrime);
+    }
+    return sumFixed<P, Q>(&controlPoints[first], uSize, Bu, BuPrime, Bv, BvPrime);
+}
+
+void BSplineSurface::SetSpecializedEvaluation(bool enabled)
+{
+    specializedEvaluation = enabled;
+}
+
+glm::vec3 BSplineSurface::EvaluateSurface(float u, float v) const {
+    glm::vec3 point(0.0f);
+
+    // Bare (uDegree + 1) x (vDegree + 1) kontrollpunkter pvirker punktet, resten av basisfunksjonene er null
+    int uSpan = FindKnotSpan(uDegree, uSize, u, uKnots);
+    int vSpan = FindKnotSpan(vDegree, vSize, v, vKnots);
+    float Bu[MaxDegree + 1]; // Basisfunksjonene i u retning
+    float Bv[MaxDegree + 1]; // Basisfunksjonene i v retning
+    BasisFunctions(uSpan, uDegree, u, uKnots, Bu);
+    BasisFunctions(vSpan, vDegree, v, vKnots, Bv);
+
+    if (rational)
+    {
+        glm::vec4 weighted(0.0f);
+        for (int l = 0; l <= vDegree; ++l) {
+            const glm::vec4* row = &weightedPoints[(vSpan - vDegree + l) * uSize + uSpan - uDegree];
+            glm::vec4 rowPoint(0.0f);
+            for (int k = 0; k <= uDegree; ++k) {
+                rowPoint += Bu[k] * row[k];
+            }
+            weighted += Bv[l] * rowPoint;
+        }
+        return netPosition(weighted); // Deler p vekten
+    }
+
+    for (int l = 0; l <= vDegree; ++l) {
+        const glm::vec3* row = &controlPoints[(vSpan - vDegree + l) * uSize + uSpan - uDegree];
+        glm::vec3 rowPoint(0.0f);
+        for (int k = 0; k <= uDegree; ++k) {
+            rowPoint += Bu[k] * row[k];
+        }
+        point += Bv[l] * rowPoint; // Beregner punktet p overflaten
+    }
+
+    return point; // Evaluerte punktet
+}
+
+// res + 1 jevnt fordelte parametere fra minimum til maximum
+static std::vector<float> gridParameters(int res, float minimum, float maximum)
+{
+    std::vector<float> parameters(res + 1);
+    for (int i = 0; i <= res; ++i)
+    {
+        parameters[i] = glm::clamp(static_cast<float>(i) / res * (maximum - minimum) + minimum, minimum, maximum);
+    }
+    return parameters;
+}
+
+void BSplineSurface::GenerateSurface(int uRes, int vRes) 
+{
+    surfacePoints.clear();
+    indices.clear();
+    normals.clear();
+
+    TessellateGrid(uRes, vRes, surfacePoints, normals);
+
+    std::vector<float> uParameters = gridParameters(uRes, GetUMin(), GetUMax());
+    std::vector<float> vParameters = gridParameters(vRes, GetVMin(), GetVMax());
+    gridRowLength = vParameters.size();
+    meshParameters.resize(surfacePoints.size());
+    for (size_t i = 0; i < uParameters.size(); ++i)
+    {
+        for (size_t j = 0; j < vParameters.size(); ++j)
+        {
+            meshParameters[i * gridRowLength + j] = glm::vec2(uParameters[i], vParameters[j]);
+        }
+    }
+
+    // Setter opp indekser for flaten
+    indices.reserve(static_cast<size_t>(uRes) * vRes * 6);
+    for (int i = 0; i < uRes; ++i) 
+    {
+        for (int j = 0; j < vRes; ++j) 
+        {
+            unsigned int topLeft = i * (vRes + 1) + j;
+            unsigned int topRight = topLeft + 1;
+            unsigned int bottomLeft = (i + 1) * (vRes + 1) + j;
+            unsigned int bottomRight = bottomLeft + 1;
+
+            indices.push_back(topLeft);
+            indices.push_back(bottomLeft);
+            indices.push_back(bottomRight);
+
+            indices.push_back(topLeft);
+            indices.push_back(bottomRight);
+            indices.push_back(topRight);
+        }
+    }
+    SetupMesh();
+}
+
+void BSplineSurface::GenerateAdaptiveSurface(float tolerance, int maxDepth)
+{
+    surfacePoints.clear();
+    indices.clear();
+    normals.clear();
+
+    TessellateAdaptive(tolerance, maxDepth, surfacePoints, normals, indices, &meshParameters);
+    gridRowLength = 0;
+    SetupMesh();
+}
+
+// Ulike skjteverdier innenfor parameteromrdet, flaten er et polynom mellom hvert par
+static std::vector<float> knotBreaks(const std::vector<float>& knots, int degree, int controlCount)
+{
+    std::vector<float> breaks;
+    for (int i = degree; i <= controlCount; ++i)
+    {
+        if (breaks.empty() || knots[i] > breaks.back())
+        {
+            breaks.push_back(knots[i]);
+        }
+    }
+    return breaks;
+}
+
+// Parameteren til gitterkoordinaten X nr hver startcelle er cellSize enheter bred
+static float latticeParameter(double X, int cellSize, const std::vector<float>& breaks)
+{
+    int cell = std::min(static_cast<int>(X / cellSize), static_cast<int>(breaks.size()) - 2);
+    double local = (X - static_cast<double>(cell) * cellSize) / cellSize;
+    return static_cast<float>(breaks[cell] + local * (breaks[cell + 1] - breaks[cell]));
+}
+
+void BSplineSurface::TessellateAdaptive(float tolerance, int maxDepth, std::vector<glm::vec3>& points, std::vector<glm::vec3>& pointNormals,
+    std::vector<unsigned int>& triangles, std::vector<glm::vec2>* parameters) const
+{
+    points.clear();
+    pointNormals.clear();
+    triangles.clear();
+
+    // Rutene ligger i et heltallsgitter med cellSize enheter per startcelle, s hjrner som deles av flere ruter
+    // fr nyaktig samme koordinater
+    maxDepth = glm::clamp(maxDepth, 0, 12);
+    const int cellSize = 1 << maxDepth;
+    std::vector<float> uBreaks = knotBreaks(uKnots, uDegree, uSize);
+    std::vector<float> vBreaks = knotBreaks(vKnots, vDegree, vSize);
+    int uCells = static_cast<int>(uBreaks.size()) - 1;
+    int vCells = static_cast<int>(vBreaks.size()) - 1;
+    auto evaluate = [&](double X, double Y)
+    {
+        return EvaluateSurface(latticeParameter(X, cellSize, uBreaks), latticeParameter(Y, cellSize, vBreaks));
+    };
+
+    struct Quad
+    {
+        int x, y, size;
+        glm::vec3 corners[4]; // (x, y), (x + size, y), (x, y + size), (x + size, y + size)
+    };
+
+    // Deler startcellene hver for seg, i parallell
+    std::vector<std::vector<Quad>> chunkLeaves(threadCount());
+    parallelFor(static_cast<size_t>(uCells) * vCells, static_cast<unsigned int>(chunkLeaves.size()), [&](size_t begin, size_t end, unsigned int chunk)
+    {
+        std::vector<Quad> stack;
+        for (size_t cell = begin; cell < end; ++cell)
+        {
+            Quad root;
+            root.x = static_cast<int>(cell % uCells) * cellSize;
+            root.y = static_cast<int>(cell / uCells) * cellSize;
+            root.size = cellSize;
+            for (int c = 0; c < 4; ++c)
+            {
+                root.corners[c] = evaluate(root.x + (c & 1) * cellSize, root.y + (c >> 1) * cellSize);
+            }
+            stack.push_back(root);
+
+            while (!stack.empty())
+            {
+                Quad quad = stack.back();
+                stack.pop_back();
+                if (quad.size == 1)
+                {
+                    chunkLeaves[chunk].push_back(quad);
+                    continue;
+                }
+
+                // Flaten i et 5 x 5 rutenett over ruten mot det bilinere planet mellom hjrnene. Punktene p
+                // halvveis-linjene blir hjrner i barna
+                glm::vec3 samples[5][5];
+                float deviation = 0.0f;
+                for (int b = 0; b <= 4; ++b)
+                {
+                    for (int a = 0; a <= 4; ++a)
+                    {
+                        bool corner = (a == 0 || a == 4) && (b == 0 || b == 4);
+                        if (corner || ((a & 1) && (b & 1) == 0 && (b == 0 || b == 4)) || ((b & 1) && (a & 1) == 0 && (a == 0 || a == 4)))
+                        {
+                            continue; // Hjrnene er kjent, og kvartpunktene langs kantene blir testet av barna
+                        }
+                        float s = a * 0.25f;
+                        float t = b * 0.25f;
+                        glm::vec3 bilinear = (1.0f - t) * ((1.0f - s) * quad.corners[0] + s * quad.corners[1])
+                            + t * ((1.0f - s) * quad.corners[2] + s * quad.corners[3]);
+                        samples[a][b] = evaluate(quad.x + quad.size * static_cast<double>(s), quad.y + quad.size * static_cast<double>(t));
+                        deviation = std::max(deviation, glm::length(samples[a][b] - bilinear));
+                    }
+                }
+
+                if (deviation <= tolerance)
+                {
+                    chunkLeaves[chunk].push_back(quad);
+                    continue;
+                }
+
+                int half = quad.size / 2;
+                samples[0][0] = quad.corners[0];
+                samples[4][0] = quad.corners[1];
+                samples[0][4] = quad.corners[2];
+                samples[4][4] = quad.corners[3];
+                for (int c = 0; c < 4; ++c)
+                {
+                    int a = (c & 1) * 2;
+                    int b = (c >> 1) * 2;
+                    Quad child;
+                    child.x = quad.x + (c & 1) * half;
+                    child.y = quad.y + (c >> 1) * half;
+                    child.size = half;
+                    child.corners[0] = samples[a][b];
+                    child.corners[1] = samples[a + 2][b];
+                    child.corners[2] = samples[a][b + 2];
+                    child.corners[3] = samples[a + 2][b + 2];
+                    stack.push_back(child);
+                }
+            }
+        }
+    });
+
+    std::vector<Quad> leaves;
+    for (const auto& list : chunkLeaves)
+    {
+        leaves.insert(leaves.end(), list.begin(), list.end());
+    }
+
+    // Alle hjrnene sortert langs linjer med fast v (rows) og fast u (columns), s hjrnene langs en kant er et
+    // sammenhengende omrde i listene. Et hjrne inne p en kant kan bare komme fra en mindre nabo
+    std::vector<std::pair<int, int>> rows; // (Y, X), indeksen i lista er indeksen til hjrnet
+    rows.reserve(leaves.size() * 4);
+    for (const Quad& quad : leaves)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            rows.push_back(std::make_pair(quad.y + (c >> 1) * quad.size, quad.x + (c & 1) * quad.size));
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    std::vector<std::pair<std::pair<int, int>, unsigned int>> columns(rows.size()); // ((X, Y), indeks)
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        columns[i] = std::make_pair(std::make_pair(rows[i].second, rows[i].first), static_cast<unsigned int>(i));
+    }
+    std::sort(columns.begin(), columns.end());
+
+    std::vector<float> uParameters(rows.size()), vParameters(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        uParameters[i] = latticeParameter(rows[i].second, cellSize, uBreaks);
+        vParameters[i] = latticeParameter(rows[i].first, cellSize, vBreaks);
+    }
+
+    // Omkretsen til hver rute mot klokka i (u, v): langs v = y, u = x + size, v = y + size og u = x
+    std::vector<unsigned int> outline;
+    for (const Quad& quad : leaves)
+    {
+        int x0 = quad.x, y0 = quad.y, x1 = quad.x + quad.size, y1 = quad.y + quad.size;
+        auto rowRange = [&](int y, int from, int to, bool reverse)
+        {
+            size_t first = std::lower_bound(rows.begin(), rows.end(), std::make_pair(y, from)) - rows.begin();
+            size_t last = std::upper_bound(rows.begin(), rows.end(), std::make_pair(y, to)) - rows.begin();
+            size_t start = outline.size();
+            for (size_t i = first; i < last; ++i)
+            {
+                outline.push_back(static_cast<unsigned int>(i));
+            }
+            if (reverse)
+            {
+                std::reverse(outline.begin() + start, outline.end());
+            }
+        };
+        auto columnRange = [&](int x, int from, int to, bool reverse)
+        {
+            auto first = std::lower_bound(columns.begin(), columns.end(), std::make_pair(std::make_pair(x, from), 0u));
+            auto last = std::upper_bound(columns.begin(), columns.end(), std::make_pair(std::make_pair(x, to), ~0u));
+            size_t start = outline.size();
+            for (auto it = first; it != last; ++it)
+            {
+                outline.push_back(it->second);
+            }
+            if (reverse)
+            {
+                std::reverse(outline.begin() + start, outline.end());
+            }
+        };
+
+        // Hvert hjrne kommer med n gang, s siste punkt p hver kant blir tatt bort
+        outline.clear();
+        rowRange(y0, x0, x1, false);
+        outline.pop_back();
+        columnRange(x1, y0, y1, false);
+        outline.pop_back();
+        rowRange(y1, x0, x1, true);
+        outline.pop_back();
+        columnRange(x0, y0, y1, true);
+        outline.pop_back();
+
+        if (outline.size() == 4)
+        {
+            triangles.insert(triangles.end(), { outline[0], outline[1], outline[2], outline[0], outline[2], outline[3] });
+            continue;
+        }
+
+        unsigned int center = static_cast<unsigned int>(uParameters.size());
+        uParameters.push_back(latticeParameter(x0 + quad.size * 0.5, cellSize, uBreaks));
+        vParameters.push_back(latticeParameter(y0 + quad.size * 0.5, cellSize, vBreaks));
+        for (size_t i = 0; i < outline.size(); ++i)
+        {
+            triangles.insert(triangles.end(), { center, outline[i], outline[(i + 1) % outline.size()] });
+        }
+    }
+
+    SurfaceBatch batch;
+    EvaluateBatch(uParameters.data(), vParameters.data(), uParameters.size(), batch, true);
+    points.resize(uParameters.size());
+    pointNormals.resize(uParameters.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        SurfaceSample sample;
+        sample.position = glm::vec3(batch.x[i], batch.y[i], batch.z[i]);
+        sample.du = glm::vec3(batch.dux[i], batch.duy[i], batch.duz[i]);
+        sample.dv = glm::vec3(batch.dvx[i], batch.dvy[i], batch.dvz[i]);
+        points[i] = sample.position;
+        pointNormals[i] = SampleNormal(sample);
+    }
+
+    if (parameters != nullptr)
+    {
+        parameters->resize(uParameters.size());
+        for (size_t i = 0; i < uParameters.size(); ++i)
+        {
+            (*parameters)[i] = glm::vec2(uParameters[i], vParameters[i]);
+        }
+    }
+}
+
+// Setter inn u n gang i kurven med Boehms algoritme. Punktene span - degree + 1 til span blir erstattet av
+// punkter p linjene mellom nabopunktene, og resten blir flyttet n plass
+static void insertKnot(std::vector<float>& knots, int degree, std::vector<glm::vec4>& points, float u)
+{
+    // knots[span] <= u < knots[span + 1], eller det siste spennet foran u nr u er slutten av parameteromrdet
+    int span = static_cast<int>(std::upper_bound(knots.begin(), knots.end(), u) - knots.begin()) - 1;
+    if (span > static_cast<int>(points.size()) - 1)
+    {
+        span = static_cast<int>(std::lower_bound(knots.begin(), knots.end(), u) - knots.begin()) - 1;
+    }
+
+    std::vector<glm::vec4> refined(points.size() + 1);
+    for (int i = 0; i <= span - degree; ++i)
+    {
+        refined[i] = points[i];
+    }
+    for (int i = span - degree + 1; i <= span; ++i)
+    {
+        float alpha = (u - knots[i]) / (knots[i + degree] - knots[i]);
+        refined[i] = alpha * points[i] + (1.0f - alpha) * points[i - 1];
+    }
+    for (int i = span + 1; i < static_cast<int>(refined.size()); ++i)
+    {
+        refined[i] = points[i - 1];
+    }
+
+    knots.insert(knots.begin() + span + 1, u);
+    points.swap(refined);
+}
+
+// Setter inn hver grense mellom bitene til den har multiplisitet degree, og plukker ut de degree + 1 punktene
+// til hver Bzierbit etter hverandre
+static std::vector<glm::vec4> bezierCurves(std::vector<float> knots, int degree, std::vector<glm::vec4> points, const std::vector<float>& breaks)
+{
+    for (float knot : breaks)
+    {
+        while (std::upper_bound(knots.begin(), knots.end(), knot) - std::lower_bound(knots.begin(), knots.end(), knot) < degree)
+        {
+            insertKnot(knots, degree, points, knot);
+        }
+    }
+
+    std::vector<glm::vec4> curves;
+    curves.reserve((breaks.size() - 1) * (degree + 1));
+    for (size_t segment = 0; segment + 1 < breaks.size(); ++segment)
+    {
+        // Spennet som starter i grensen, de degree + 1 basisfunksjonene der er Bernsteinpolynomene
+        int span = static_cast<int>(std::upper_bound(knots.begin(), knots.end(), breaks[segment]) - knots.begin()) - 1;
+        curves.insert(curves.end(), points.begin() + span - degree, points.begin() + span + 1);
+    }
+    return curves;
+}
+
+void BSplineSurface::BuildBezierPatches()
+{
+    bezierUBreaks = knotBreaks(uKnots, uDegree, uSize);
+    bezierVBreaks = knotBreaks(vKnots, vDegree, vSize);
+    int uPatches = static_cast<int>(bezierUBreaks.size()) - 1;
+    int vPatches = static_cast<int>(bezierVBreaks.size()) - 1;
+    int uCount = uDegree + 1;
+    int vCount = vDegree + 1;
+
+    // Frst hver rad i u, s hver kolonne av resultatet i v
+    std::vector<std::vector<glm::vec4>> rows(vSize);
+    parallelFor(rows.size(), [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t row = begin; row < end; ++row)
+        {
+            std::vector<glm::vec4> curve(uSize);
+            for (int i = 0; i < uSize; ++i)
+            {
+                size_t index = row * uSize + i;
+                curve[i] = rational ? weightedPoints[index] : glm::vec4(controlPoints[index], 1.0f);
+            }
+            rows[row] = bezierCurves(uKnots, uDegree, curve, bezierUBreaks);
+        }
+    });
+
+    size_t rowLength = static_cast<size_t>(uPatches) * uCount;
+    std::vector<std::vector<glm::vec4>> columns(rowLength);
+    parallelFor(columns.size(), [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t column = begin; column < end; ++column)
+        {
+            std::vector<glm::vec4> curve(vSize);
+            for (int j = 0; j < vSize; ++j)
+            {
+                curve[j] = rows[j][column];
+            }
+            columns[column] = bezierCurves(vKnots, vDegree, curve, bezierVBreaks);
+        }
+    });
+
+    bezierPatches.resize(static_cast<size_t>(uPatches) * vPatches);
+    for (int b = 0; b < vPatches; ++b)
+    {
+        for (int a = 0; a < uPatches; ++a)
+        {
+            BezierPatch& patch = bezierPatches[static_cast<size_t>(b) * uPatches + a];
+            patch.uMin = bezierUBreaks[a];
+            patch.uMax = bezierUBreaks[a + 1];
+            patch.vMin = bezierVBreaks[b];
+            patch.vMax = bezierVBreaks[b + 1];
+            patch.points.resize(static_cast<size_t>(uCount) * vCount);
+            for (int l = 0; l < vCount; ++l)
+            {
+                for (int k = 0; k < uCount; ++k)
+                {
+                    patch.points[l * uCount + k] = columns[a * uCount + k][b * vCount + l];
+                }
+            }
+
+            // Med positive vekter ligger biten i den konvekse innhyllingen av kontrollpunktene
+            patch.boundsMin = glm::vec3(patch.points[0]) / patch.points[0].w;
+            patch.boundsMax = patch.boundsMin;
+            for (const glm::vec4& point : patch.points)
+            {
+                glm::vec3 position = glm::vec3(point) / point.w;
+                patch.boundsMin = glm::min(patch.boundsMin, position);
+                patch.boundsMax = glm::max(patch.boundsMax, position);
+            }
+        }
+    }
+}
+
+const std::vector<BezierPatch>& BSplineSurface::GetBezierPatches()
+{
+    if (bezierPatches.empty())
+    {
+        BuildBezierPatches();
+    }
+    return bezierPatches;
+}
+
+// Bitene er alltid homogene, men for polynomiske flater er w = 1 og kvotientregelen undvendig
+static SurfaceSample bezierSample(const glm::vec4* sums, bool rational)
+{
+    if (rational)
+    {
+        return netSample(sums);
+    }
+    SurfaceSample sample;
+    sample.position = glm::vec3(sums[0]);
+    sample.du = glm::vec3(sums[1]);
+    sample.dv = glm::vec3(sums[2]);
+    sample.duu = sample.duv = sample.dvv = glm::vec3(0.0f);
+    return sample;
 }
 
-float BSplineSurface::BasisFunction(int i, int degree, float t, const std::vector<float>& knots) {
-    if (i + degree >= knots.size() || i + degree + 1 >= knots.size()) 
+// Bernsteinpolynomene av grad degree i s, og derivatene degree * (B(k - 1, degree - 1) - B(k, degree - 1))
+static void bernstein(int degree, float s, float* basis, float* derivatives)
+{
+    float lower[BSplineSurface::MaxDegree + 1];
+    basis[0] = 1.0f;
+    for (int j = 1; j <= degree; ++j)
+    {
+        if (j == degree)
+        {
+            std::copy(basis, basis + degree, lower);
+        }
+        float saved = 0.0f;
+        for (int k = 0; k < j; ++k)
+        {
+            float temp = basis[k];
+            basis[k] = saved + (1.0f - s) * temp;
+            saved = s * temp;
+        }
+        basis[j] = saved;
+    }
+
+    for (int k = 0; k <= degree; ++k)
     {
-        return 0.0f;
+        derivatives[k] = degree * ((k > 0 ? lower[k - 1] : 0.0f) - (k < degree ? lower[k] : 0.0f));
     }
+}
+
+SurfaceSample BSplineSurface::EvaluateBezier(float u, float v)
+{
+    const std::vector<BezierPatch>& patches = GetBezierPatches();
+    int uPatches = static_cast<int>(bezierUBreaks.size()) - 1;
+    int vPatches = static_cast<int>(bezierVBreaks.size()) - 1;
+    u = glm::clamp(u, GetUMin(), GetUMax());
+    v = glm::clamp(v, GetVMin(), GetVMax());
+    int a = std::min(static_cast<int>(std::upper_bound(bezierUBreaks.begin(), bezierUBreaks.end(), u) - bezierUBreaks.begin()) - 1, uPatches - 1);
+    int b = std::min(static_cast<int>(std::upper_bound(bezierVBreaks.begin(), bezierVBreaks.end(), v) - bezierVBreaks.begin()) - 1, vPatches - 1);
+    const BezierPatch& patch = patches[static_cast<size_t>(b) * uPatches + a];
+
+    // Lokale parametere fra 0 til 1 i biten, derivatene blir skalert tilbake til flatens parametere
+    float uScale = 1.0f / (patch.uMax - patch.uMin);
+    float vScale = 1.0f / (patch.vMax - patch.vMin);
+    float Bu[MaxDegree + 1], BuPrime[MaxDegree + 1];
+    float Bv[MaxDegree + 1], BvPrime[MaxDegree + 1];
+    bernstein(uDegree, (u - patch.uMin) * uScale, Bu, BuPrime);
+    bernstein(vDegree, (v - patch.vMin) * vScale, Bv, BvPrime);
 
-    if (degree == 0) {
-        return (t >= knots[i] && t < knots[i + 1]) ? 1.0f : 0.0f; // Verdien 1.0 hvis t ligger mellom knots[i] og knots [i+1]
+    glm::vec4 sums[6];
+    std::fill(sums, sums + 6, glm::vec4(0.0f));
+    int uCount = uDegree + 1;
+    for (int l = 0; l <= vDegree; ++l)
+    {
+        const glm::vec4* row = &patch.points[l * uCount];
+        glm::vec4 row0(0.0f), row1(0.0f);
+        for (int k = 0; k <= uDegree; ++k)
+        {
+            row0 += Bu[k] * row[k];
+            row1 += BuPrime[k] * row[k];
+        }
+        sums[0] += Bv[l] * row0;
+        sums[1] += Bv[l] * row1 * uScale;
+        sums[2] += BvPrime[l] * row0 * vScale;
     }
+    return bezierSample(sums, rational);
+}
+
+void BSplineSurface::TessellateBezier(int patchRes, std::vector<glm::vec3>& points, std::vector<glm::vec3>& pointNormals,
+    std::vector<unsigned int>& triangles, std::vector<glm::vec2>* parameters)
+{
+    const std::vector<BezierPatch>& patches = GetBezierPatches();
+    int uCount = uDegree + 1;
+    int vCount = vDegree + 1;
+    size_t rowLength = static_cast<size_t>(patchRes) + 1;
+    size_t patchVertices = rowLength * rowLength;
 
-    float left = 0.0f; // Venstre basisfunksjon
-    float right = 0.0f; // Hyre basisfunksjon
+    // Samme lokale parametere i alle bitene, s n tabell per retning holder
+    std::vector<float> local = gridParameters(patchRes, 0.0f, 1.0f);
+    std::vector<float> uTable(rowLength * 2 * uCount), vTable(rowLength * 2 * vCount);
+    for (size_t n = 0; n < rowLength; ++n)
+    {
+        bernstein(uDegree, local[n], &uTable[n * 2 * uCount], &uTable[n * 2 * uCount + uCount]);
+        bernstein(vDegree, local[n], &vTable[n * 2 * vCount], &vTable[n * 2 * vCount + vCount]);
+    }
 
-    //Venstre
-    // Denne finner hvor langt t har kommet inn i intervallet 
-    if (knots[i + degree] - knots[i] != 0.0f) {
-        left = (t - knots[i]) / (knots[i + degree] - knots[i]) * BasisFunction(i, degree - 1, t, knots);
+    points.resize(patches.size() * patchVertices);
+    pointNormals.resize(points.size());
+    if (parameters != nullptr)
+    {
+        parameters->resize(points.size());
     }
-    //Hyre
-    // Denne finner hvor langt t er fra slutten av intervalet
-    if (knots[i + degree + 1] - knots[i + 1] != 0.0f) {
-        right = (knots[i + degree + 1] - t) / (knots[i + degree + 1] - knots[i + 1]) * BasisFunction(i + 1, degree - 1, t, knots);
+    parallelFor(patches.size(), [&](size_t begin, size_t end, unsigned int)
+    {
+        std::vector<glm::vec4> column(vCount), columnU(vCount);
+        for (size_t p = begin; p < end; ++p)
+        {
+            const BezierPatch& patch = patches[p];
+            float uScale = 1.0f / (patch.uMax - patch.uMin);
+            float vScale = 1.0f / (patch.vMax - patch.vMin);
+            for (size_t i = 0; i < rowLength; ++i)
+            {
+                const float* Bu = &uTable[i * 2 * uCount];
+                const float* BuPrime = Bu + uCount;
+                for (int l = 0; l < vCount; ++l)
+                {
+                    const glm::vec4* row = &patch.points[l * uCount];
+                    glm::vec4 point(0.0f), derivative(0.0f);
+                    for (int k = 0; k < uCount; ++k)
+                    {
+                        point += Bu[k] * row[k];
+                        derivative += BuPrime[k] * row[k];
+                    }
+                    column[l] = point;
+                    columnU[l] = derivative * uScale;
+                }
+
+                for (size_t j = 0; j < rowLength; ++j)
+                {
+                    const float* Bv = &vTable[j * 2 * vCount];
+                    const float* BvPrime = Bv + vCount;
+                    glm::vec4 sums[6];
+                    std::fill(sums, sums + 6, glm::vec4(0.0f));
+                    for (int l = 0; l < vCount; ++l)
+                    {
+                        sums[0] += Bv[l] * column[l];
+                        sums[1] += Bv[l] * columnU[l];
+                        sums[2] += BvPrime[l] * column[l] * vScale;
+                    }
+                    SurfaceSample sample = bezierSample(sums, rational);
+                    size_t index = p * patchVertices + i * rowLength + j;
+                    points[index] = sample.position;
+                    pointNormals[index] = SampleNormal(sample);
+                    if (parameters != nullptr)
+                    {
+                        (*parameters)[index] = glm::vec2(patch.uMin + local[i] * (patch.uMax - patch.uMin),
+                            patch.vMin + local[j] * (patch.vMax - patch.vMin));
+                    }
+                }
+            }
+        }
+    });
+
+    // Samme omlpsretning som GenerateSurface
+    triangles.clear();
+    triangles.reserve(patches.size() * patchRes * patchRes * 6);
+    for (size_t p = 0; p < patches.size(); ++p)
+    {
+        unsigned int first = static_cast<unsigned int>(p * patchVertices);
+        for (int i = 0; i < patchRes; ++i)
+        {
+            for (int j = 0; j < patchRes; ++j)
+            {
+                unsigned int topLeft = first + i * static_cast<unsigned int>(rowLength) + j;
+                unsigned int topRight = topLeft + 1;
+                unsigned int bottomLeft = topLeft + static_cast<unsigned int>(rowLength);
+                unsigned int bottomRight = bottomLeft + 1;
+                triangles.insert(triangles.end(), { topLeft, bottomLeft, bottomRight, topLeft, bottomRight, topRight });
+            }
+        }
     }
+}
+
+void BSplineSurface::GenerateBezierSurface(int patchRes)
+{
+    surfacePoints.clear();
+    indices.clear();
+    normals.clear();
 
-    return left + right; // Slr dem sammen for  f jevnhet tilsammen
+    TessellateBezier(patchRes, surfacePoints, normals, indices, &meshParameters);
+    gridRowLength = 0;
+    SetupMesh();
 }
 
-float BSplineSurface::BasisFunctionDerivative(int i, int degree, float t, const std::vector<float>& knots)
+void BSplineSurface::BuildProjectionGrid()
 {
-    if (degree == 0) 
+    // Omtrent fire punkter per polynomisk stykke langs hver akse, rundet opp til hele ruter
+    auto resolution = [](int spans)
     {
-        return 0.0f;
+        int res = glm::clamp(4 * spans, 2 * ProjectionTile, 256);
+        return (res + ProjectionTile - 1) / ProjectionTile * ProjectionTile;
+    };
+    int uRes = resolution(uSize - uDegree);
+    int vRes = resolution(vSize - vDegree);
+
+    ProjectionGrid& grid = projectionGrid;
+    grid.u = gridParameters(uRes, GetUMin(), GetUMax());
+    grid.v = gridParameters(vRes, GetVMin(), GetVMax());
+    std::vector<glm::vec3> gridNormals;
+    TessellateGrid(uRes, vRes, grid.points, gridNormals);
+
+    // Nabo-ruter deler punktene langs kanten
+    grid.uTiles = uRes / ProjectionTile;
+    grid.vTiles = vRes / ProjectionTile;
+    grid.tileMin.assign(static_cast<size_t>(grid.uTiles) * grid.vTiles, glm::vec3(std::numeric_limits<float>::max()));
+    grid.tileMax.assign(grid.tileMin.size(), glm::vec3(-std::numeric_limits<float>::max()));
+    size_t rowLength = grid.v.size();
+    for (size_t i = 0; i < grid.u.size(); ++i)
+    {
+        for (size_t j = 0; j < rowLength; ++j)
+        {
+            const glm::vec3& point = grid.points[i * rowLength + j];
+            int aFirst = std::max(static_cast<int>(i) - 1, 0) / ProjectionTile;
+            int aLast = std::min(static_cast<int>(i) / ProjectionTile, grid.uTiles - 1);
+            int bFirst = std::max(static_cast<int>(j) - 1, 0) / ProjectionTile;
+            int bLast = std::min(static_cast<int>(j) / ProjectionTile, grid.vTiles - 1);
+            for (int a = aFirst; a <= aLast; ++a)
+            {
+                for (int b = bFirst; b <= bLast; ++b)
+                {
+                    size_t tile = static_cast<size_t>(a) * grid.vTiles + b;
+                    grid.tileMin[tile] = glm::min(grid.tileMin[tile], point);
+                    grid.tileMax[tile] = glm::max(grid.tileMax[tile], point);
+                }
+            }
+        }
     }
+}
+
+glm::vec2 BSplineSurface::ProjectionSeed(const glm::vec3& point) const
+{
+    const ProjectionGrid& grid = projectionGrid;
+    size_t rowLength = grid.v.size();
+    size_t tileCount = grid.tileMin.size();
+    auto boxDistance = [&](size_t tile)
+    {
+        glm::vec3 outside = glm::max(glm::max(grid.tileMin[tile] - point, point - grid.tileMax[tile]), glm::vec3(0.0f));
+        return glm::dot(outside, outside);
+    };
 
-    float left = 0.0f;
-    float right = 0.0f;
+    float best = std::numeric_limits<float>::max();
+    size_t bestIndex = 0;
+    auto searchTile = [&](size_t tile)
+    {
+        size_t iFirst = tile / grid.vTiles * ProjectionTile;
+        size_t jFirst = tile % grid.vTiles * ProjectionTile;
+        for (size_t i = iFirst; i <= iFirst + ProjectionTile; ++i)
+        {
+            const glm::vec3* row = &grid.points[i * rowLength];
+            for (size_t j = jFirst; j <= jFirst + ProjectionTile; ++j)
+            {
+                glm::vec3 difference = row[j] - point;
+                float distance = glm::dot(difference, difference);
+                if (distance < best)
+                {
+                    best = distance;
+                    bestIndex = i * rowLength + j;
+                }
+            }
+        }
+    };
 
-    // Bergner venstre delen av derivatet
-    if (knots[i + degree] - knots[i] != 0.0f) 
+    // Ruta med nrmest boks frst, s blir de fleste andre hoppet over
+    size_t nearest = 0;
+    float nearestDistance = std::numeric_limits<float>::max();
+    for (size_t tile = 0; tile < tileCount; ++tile)
     {
-        left = degree / (knots[i + degree] - knots[i]) * BasisFunction(i, degree - 1, t, knots); // Venstre del ker nr t gr inn i intervallet
+        float distance = boxDistance(tile);
+        if (distance < nearestDistance)
+        {
+            nearestDistance = distance;
+            nearest = tile;
+        }
     }
-    // Beregner hyre deleb av derivatet
-    if (knots[i + degree + 1] - knots[i + 1] != 0.0f) 
+    searchTile(nearest);
+    for (size_t tile = 0; tile < tileCount; ++tile)
     {
-        right = degree / (knots[i + degree + 1] - knots[i + 1]) * BasisFunction(i + 1, degree - 1, t, knots); // Hyre minker nr t gr ut av intervallet
+        if (tile != nearest && boxDistance(tile) < best)
+        {
+            searchTile(tile);
+        }
     }
-
-    return left - right; // Finne forskjellen mellom venstre og hyre
+    return glm::vec2(grid.u[bestIndex / rowLength], grid.v[bestIndex % rowLength]);
 }
 
-glm::vec3 BSplineSurface::PartialDerivativeU(float u, float v)
+bool BSplineSurface::RefineProjection(const glm::vec3& point, glm::vec2& parameter, float tolerance) const
 {
-    glm::vec3 derivative(0.0f);
-    int uDegree = 2; // Graden for u retning
-    int vDegree = 2; // Graden for v retning
-    int uSize = 4; // Antall kontrollpunkter i u retning
-    int vSize = 3; // Antall kontrollpunkter i v retning
+    const int maxIterations = 12;
+    glm::vec2 minimum(GetUMin(), GetVMin());
+    glm::vec2 maximum(GetUMax(), GetVMax());
+    parameter = glm::clamp(parameter, minimum, maximum);
 
-    for (int i = 0; i < uSize; ++i) // Beregner summen for alle kontrollpunkter
+    // Et steg som gjr avstanden strre blir halvert, s Newton ikke hopper over til en annen del av flaten
+    glm::vec2 previous = parameter;
+    glm::vec2 step(0.0f);
+    float previousDistance = std::numeric_limits<float>::max();
+    for (int iteration = 0; iteration < maxIterations; ++iteration)
     {
-        for (int j = 0; j < vSize; ++j) 
+        // Nullpunkt for gradienten til |S(u, v) - point|^2 / 2: (S_u . r, S_v . r) med r = S - point
+        SurfaceSample sample = EvaluateDerivatives(parameter.x, parameter.y, true);
+        glm::vec3 r = sample.position - point;
+        float distance = glm::dot(r, r);
+        if (distance > previousDistance)
+        {
+            step *= 0.5f;
+            parameter = previous + step;
+            if (glm::length(step.x * sample.du + step.y * sample.dv) <= tolerance)
+            {
+                parameter = previous;
+                return true;
+            }
+            continue;
+        }
+
+        float fu = glm::dot(sample.du, r);
+        float fv = glm::dot(sample.dv, r);
+        float uu = glm::dot(sample.du, sample.du);
+        float uv = glm::dot(sample.du, sample.dv);
+        float vv = glm::dot(sample.dv, sample.dv);
+        float a = uu + glm::dot(sample.duu, r);
+        float b = uv + glm::dot(sample.duv, r);
+        float c = vv + glm::dot(sample.dvv, r);
+        float determinant = a * c - b * b;
+
+        // Langt fra en flate som krummer er ikke Hessematrisen positiv definitt, da blir det et Gauss-Newton-steg
+        if (a <= 0.0f || determinant <= 1e-6f * uu * vv)
+        {
+            a = uu;
+            b = uv;
+            c = vv;
+            determinant = a * c - b * b;
+        }
+        if (!(determinant > 0.0f))
         {
-            int index = j * uSize + i;
-            float BuPrime = BasisFunctionDerivative(i, uDegree, u, uKnots); // Derivert basisfunksjon for u retning
-            float Bv = BasisFunction(j, vDegree, v, vKnots); // Basisfunkson for v retning
-            derivative += BuPrime * Bv * controlPoints[index]; //summerer verdiene av funksjonene og kontrollpunktet
+            return false; // Degenerert punkt der du og dv er parallelle
         }
+
+        // P kanten av parameteromrdet, med gradienten ut av flaten, blir den parameteren holdt fast og
+        // Newton gjort langs kanten
+        bool uFixed = (parameter.x <= minimum.x && fu > 0.0f) || (parameter.x >= maximum.x && fu < 0.0f);
+        bool vFixed = (parameter.y <= minimum.y && fv > 0.0f) || (parameter.y >= maximum.y && fv < 0.0f);
+        glm::vec2 delta;
+        if (uFixed && vFixed)
+        {
+            return true; // Hjrnet er nrmest
+        }
+        else if (uFixed)
+        {
+            delta = glm::vec2(0.0f, fv / (c > 0.0f ? c : vv));
+        }
+        else if (vFixed)
+        {
+            delta = glm::vec2(fu / (a > 0.0f ? a : uu), 0.0f);
+        }
+        else
+        {
+            delta = glm::vec2(c * fu - b * fv, a * fv - b * fu) / determinant;
+        }
+
+        previous = parameter;
+        previousDistance = distance;
+        parameter = glm::clamp(parameter - delta, minimum, maximum);
+        step = parameter - previous;
+        if (glm::length(step.x * sample.du + step.y * sample.dv) <= tolerance)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void BSplineSurface::ProjectPoints(const glm::vec3* points, size_t count, SurfaceProjection* projections, bool warmStart, float tolerance)
+{
+    if (projectionGrid.points.empty())
+    {
+        BuildProjectionGrid();
     }
 
-    return derivative;
+    // Sm batcher er ikke verdt  starte trder for
+    unsigned int chunks = count >= 4096 ? threadCount() : 1;
+    parallelFor(count, chunks, [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t n = begin; n < end; ++n)
+        {
+            SurfaceProjection& projection = projections[n];
+            glm::vec2 parameter = projection.parameter;
+            if (!warmStart || !RefineProjection(points[n], parameter, tolerance))
+            {
+                parameter = ProjectionSeed(points[n]);
+                RefineProjection(points[n], parameter, tolerance);
+            }
+
+            SurfaceSample sample = EvaluateDerivatives(parameter.x, parameter.y);
+            projection.parameter = parameter;
+            projection.position = sample.position;
+            projection.normal = SampleNormal(sample);
+            projection.distance = glm::dot(points[n] - sample.position, projection.normal);
+        }
+    });
+}
+
+SurfaceProjection BSplineSurface::ProjectPoint(const glm::vec3& point)
+{
+    SurfaceProjection projection;
+    ProjectPoints(&point, 1, &projection);
+    return projection;
 }
 
-glm::vec3 BSplineSurface::PartialDerivativeV(float u, float v)
+
+// Hvor nr den bilinere flaten mellom hjrnene kontrollpunktene til en bit m ligge, relativt til strrelsen p biten,
+// fr Newton fra midten av biten finner treffet. maxRaySubdivisions er hyeste antall delinger av hver Bzierbit
+static const float rayFlatness = 0.05f;
+static const int maxRaySubdivisions = 12;
+
+// Deler en Bzierbit (homogene punkter som i BezierPatch) i to med de Casteljau til den er flat nok, og legger
+// parameteromrdet og boksen rundt kontrollpunktene til hver bit i leaves, leafMin og leafMax
+template <typename Leaf>
+static void subdivideForRays(const std::vector<glm::vec4>& points, int uDegree, int vDegree, float uMin, float uMax, float vMin, float vMax,
+    int depth, std::vector<Leaf>& leaves, std::vector<glm::vec3>& leafMin, std::vector<glm::vec3>& leafMax)
 {
-    glm::vec3 derivative(0.0f);
-    int uDegree = 2; // Graden for u retning
-    int vDegree = 2; // Graden for v retning
-    int uSize = 4; // Antall kontrollpunkter i u retning
-    int vSize = 3; // Antall kontrollpunkter i v retning
+    int uCount = uDegree + 1;
+    int vCount = vDegree + 1;
+    glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+    for (const glm::vec4& point : points)
+    {
+        glm::vec3 position = glm::vec3(point) / point.w;
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
 
-    for (int i = 0; i < uSize; ++i) // Beregner summen for alle kontrollpunkter
+    glm::vec3 c00 = glm::vec3(points[0]) / points[0].w;
+    glm::vec3 c10 = glm::vec3(points[uDegree]) / points[uDegree].w;
+    glm::vec3 c01 = glm::vec3(points[vDegree * uCount]) / points[vDegree * uCount].w;
+    glm::vec3 c11 = glm::vec3(points[vDegree * uCount + uDegree]) / points[vDegree * uCount + uDegree].w;
+    float deviation = 0.0f;
+    for (int l = 0; l < vCount; ++l)
     {
-        for (int j = 0; j < vSize; ++j) 
+        for (int k = 0; k < uCount; ++k)
         {
-            int index = j * uSize + i;
-            float Bu = BasisFunction(i, uDegree, u, uKnots);
-            float BvPrime = BasisFunctionDerivative(j, vDegree, v, vKnots);
-            derivative += Bu * BvPrime * controlPoints[index];
+            float s = static_cast<float>(k) / uDegree;
+            float t = static_cast<float>(l) / vDegree;
+            glm::vec3 bilinear = glm::mix(glm::mix(c00, c10, s), glm::mix(c01, c11, s), t);
+            const glm::vec4& point = points[l * uCount + k];
+            deviation = std::max(deviation, glm::length(glm::vec3(point) / point.w - bilinear));
         }
     }
 
-    return derivative;
-}
+    float size = glm::length(boundsMax - boundsMin);
+    if (depth == 0 || deviation <= rayFlatness * size)
+    {
+        // Litt strre boks, s avrundingsfeil ikke gir hull mellom bitene
+        glm::vec3 padding(1e-5f * size);
+        leaves.push_back({ uMin, uMax, vMin, vMax, { c00, c10, c01, c11 } });
+        leafMin.push_back(boundsMin - padding);
+        leafMax.push_back(boundsMax + padding);
+        return;
+    }
 
-glm::vec3 BSplineSurface::EvaluateSurface(float u, float v) {
-    glm::vec3 point(0.0f);
+    // Deler i den retningen biten er lengst
+    bool splitU = glm::length(c10 - c00) + glm::length(c11 - c01) >= glm::length(c01 - c00) + glm::length(c11 - c10);
+    int count = splitU ? uCount : vCount;
+    int stride = splitU ? 1 : uCount;
+    int lines = splitU ? vCount : uCount;
+    int lineStride = splitU ? uCount : 1;
+    std::vector<glm::vec4> low(points.size()), high(points.size());
+    std::vector<glm::vec4> curve(count);
+    for (int line = 0; line < lines; ++line)
+    {
+        for (int k = 0; k < count; ++k)
+        {
+            curve[k] = points[line * lineStride + k * stride];
+        }
+        low[line * lineStride] = curve[0];
+        high[line * lineStride + (count - 1) * stride] = curve[count - 1];
+        for (int level = 1; level < count; ++level)
+        {
+            for (int k = 0; k < count - level; ++k)
+            {
+                curve[k] = (curve[k] + curve[k + 1]) * 0.5f;
+            }
+            low[line * lineStride + level * stride] = curve[0];
+            high[line * lineStride + (count - 1 - level) * stride] = curve[count - 1 - level];
+        }
+    }
+
+    if (splitU)
+    {
+        float uMiddle = (uMin + uMax) * 0.5f;
+        subdivideForRays(low, uDegree, vDegree, uMin, uMiddle, vMin, vMax, depth - 1, leaves, leafMin, leafMax);
+        subdivideForRays(high, uDegree, vDegree, uMiddle, uMax, vMin, vMax, depth - 1, leaves, leafMin, leafMax);
+    }
+    else
+    {
+        float vMiddle = (vMin + vMax) * 0.5f;
+        subdivideForRays(low, uDegree, vDegree, uMin, uMax, vMin, vMiddle, depth - 1, leaves, leafMin, leafMax);
+        subdivideForRays(high, uDegree, vDegree, uMin, uMax, vMiddle, vMax, depth - 1, leaves, leafMin, leafMax);
+    }
+}
 
-    int uDegree = 2; 
-    int vDegree = 2; 
-    int uSize = 4; 
-    int vSize = 3;
+void BSplineSurface::BuildRayBvh()
+{
+    const std::vector<BezierPatch>& patches = GetBezierPatches();
 
-    for (int i = 0; i < uSize; ++i) {
-        for (int j = 0; j < vSize; ++j) {
-            int index = j * uSize + i;
-            float Bu = BasisFunction(i, uDegree, u, uKnots); // Basisfunksjonen i u retning
-            float Bv = BasisFunction(j, vDegree, v, vKnots); // Basisfunksjonen i v retning
-            point += Bu * Bv * controlPoints[index]; // Beregner punktet p overflaten
+    // Hver trd deler sine Bzierbiter, og bitene blir sltt sammen etterp
+    unsigned int chunks = threadCount();
+    std::vector<std::vector<RayLeaf>> chunkLeaves(chunks);
+    std::vector<std::vector<glm::vec3>> chunkMin(chunks), chunkMax(chunks);
+    parallelFor(patches.size(), chunks, [&](size_t begin, size_t end, unsigned int chunk)
+    {
+        for (size_t p = begin; p < end; ++p)
+        {
+            const BezierPatch& patch = patches[p];
+            subdivideForRays(patch.points, uDegree, vDegree, patch.uMin, patch.uMax, patch.vMin, patch.vMax, maxRaySubdivisions,
+                chunkLeaves[chunk], chunkMin[chunk], chunkMax[chunk]);
         }
+    });
+
+    rayLeaves.clear();
+    std::vector<glm::vec3> leafMin, leafMax;
+    for (unsigned int c = 0; c < chunks; ++c)
+    {
+        rayLeaves.insert(rayLeaves.end(), chunkLeaves[c].begin(), chunkLeaves[c].end());
+        leafMin.insert(leafMin.end(), chunkMin[c].begin(), chunkMin[c].end());
+        leafMax.insert(leafMax.end(), chunkMax[c].begin(), chunkMax[c].end());
     }
 
-    return point; // Evaluerte punktet
+    rayNodes.clear();
+    if (rayLeaves.empty())
+    {
+        return;
+    }
+
+    std::vector<unsigned int> order(rayLeaves.size());
+    for (size_t n = 0; n < order.size(); ++n)
+    {
+        order[n] = static_cast<unsigned int>(n);
+    }
+    rayNodes.reserve(rayLeaves.size() * 2);
+    rayNodes.push_back(RayNode());
+    BuildRayNode(0, 0, order.size(), order, leafMin, leafMax);
 }
 
-void BSplineSurface::GenerateSurface(int uRes, int vRes) 
+void BSplineSurface::BuildRayNode(unsigned int index, size_t begin, size_t end, std::vector<unsigned int>& order,
+    const std::vector<glm::vec3>& leafMin, const std::vector<glm::vec3>& leafMax)
 {
-    surfacePoints.clear();
-    indices.clear();
-    normals.clear();
+    glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+    glm::vec3 centerMin(FLT_MAX), centerMax(-FLT_MAX);
+    for (size_t i = begin; i < end; ++i)
+    {
+        unsigned int leaf = order[i];
+        boundsMin = glm::min(boundsMin, leafMin[leaf]);
+        boundsMax = glm::max(boundsMax, leafMax[leaf]);
+        glm::vec3 center = (leafMin[leaf] + leafMax[leaf]) * 0.5f;
+        centerMin = glm::min(centerMin, center);
+        centerMax = glm::max(centerMax, center);
+    }
+    rayNodes[index].boundsMin = boundsMin;
+    rayNodes[index].boundsMax = boundsMax;
+
+    if (end - begin == 1)
+    {
+        rayNodes[index].first = order[begin];
+        rayNodes[index].leaf = 1;
+        return;
+    }
+
+    // Deler ved medianen langs aksen der midtpunktene er mest spredt
+    glm::vec3 extent = centerMax - centerMin;
+    int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+    size_t middle = (begin + end) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+        [&](unsigned int a, unsigned int b) { return leafMin[a][axis] + leafMax[a][axis] < leafMin[b][axis] + leafMax[b][axis]; });
+
+    unsigned int first = static_cast<unsigned int>(rayNodes.size());
+    rayNodes[index].first = first;
+    rayNodes[index].leaf = 0;
+    rayNodes.push_back(RayNode());
+    rayNodes.push_back(RayNode());
+    BuildRayNode(first, begin, middle, order, leafMin, leafMax);
+    BuildRayNode(first + 1, middle, end, order, leafMin, leafMax);
+}
+
+// Avstanden der strlen gr inn i boksen, FLT_MAX nr den bommer eller boksen ligger lenger unna enn best
+static inline float rayBoxEntry(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::vec3& origin, const glm::vec3& inverse, float best)
+{
+    glm::vec3 t1 = (boundsMin - origin) * inverse;
+    glm::vec3 t2 = (boundsMax - origin) * inverse;
+    glm::vec3 entries = glm::min(t1, t2);
+    glm::vec3 exits = glm::max(t1, t2);
+    float entry = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+    float exit = std::min(std::min(exits.x, exits.y), exits.z);
+    return (entry <= exit && entry < best) ? entry : FLT_MAX;
+}
+
+bool BSplineSurface::TraceRay(const glm::vec3& origin, const glm::vec3& direction, SurfaceHit& hit, float maxDistance) const
+{
+    hit.distance = FLT_MAX;
+    if (rayNodes.empty())
+    {
+        return false;
+    }
+
+    // Strlen er snittet av to plan n1 . x = d1 og n2 . x = d2 som begge inneholder den
+    glm::vec3 axis = (std::abs(direction.x) > std::abs(direction.y) && std::abs(direction.x) > std::abs(direction.z))
+        ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 n1 = glm::normalize(glm::cross(direction, axis));
+    glm::vec3 n2 = glm::normalize(glm::cross(direction, n1));
+    float d1 = glm::dot(n1, origin);
+    float d2 = glm::dot(n2, origin);
+    float directionLength2 = glm::dot(direction, direction);
+    float tolerance = 1e-5f * glm::length(rayNodes[0].boundsMax - rayNodes[0].boundsMin);
+    glm::vec2 minimum(GetUMin(), GetVMin());
+    glm::vec2 maximum(GetUMax(), GetVMax());
+
+    glm::vec3 inverse = 1.0f / direction;
+    float best = maxDistance;
+    bool found = false;
 
-    for (int i = 0; i <= uRes; ++i) 
+    struct Entry
     {
-        float u = glm::clamp( // Holder u verdien innenfor
-            static_cast<float>(i) / uRes * (uKnots.back() - uKnots.front()) + uKnots.front(),
-            uKnots.front(),
-            uKnots.back() - 1e-4f); // Clamper for  unng overskridelse
-        for (int j = 0; j <= vRes; ++j) 
+        unsigned int node;
+        float distance;
+    };
+    Entry stack[64];
+    int stackSize = 0;
+    float rootEntry = rayBoxEntry(rayNodes[0].boundsMin, rayNodes[0].boundsMax, origin, inverse, best);
+    if (rootEntry != FLT_MAX)
+    {
+        stack[stackSize++] = { 0, rootEntry };
+    }
+
+    while (stackSize > 0)
+    {
+        Entry entry = stack[--stackSize];
+        if (entry.distance >= best)
         {
-            float v = glm::clamp( // Holder v verdien innenfor
-                static_cast<float>(j) / vRes * (vKnots.back() - vKnots.front()) + vKnots.front(),
-                vKnots.front(),
-                vKnots.back() - 1e-4f); // Clamper for  unng overskridelse
-            glm::vec3 point = EvaluateSurface(u, v);
-            surfacePoints.push_back(point);
+            continue;
+        }
 
-            // Beregne normalvektoren til flaten ved  bruke U og V parameteret
-            glm::vec3 normal = ComputeNormal(u, v); 
-            if (glm::length(normal) > 0.0f) 
+        const RayNode& node = rayNodes[entry.node];
+        if (!node.leaf)
+        {
+            // Det nrmeste barnet blir lagt verst p stacken, s det blir testet frst
+            float left = rayBoxEntry(rayNodes[node.first].boundsMin, rayNodes[node.first].boundsMax, origin, inverse, best);
+            float right = rayBoxEntry(rayNodes[node.first + 1].boundsMin, rayNodes[node.first + 1].boundsMax, origin, inverse, best);
+            Entry nearest = { node.first, left };
+            Entry farthest = { node.first + 1, right };
+            if (right < left)
+            {
+                std::swap(nearest, farthest);
+            }
+            if (farthest.distance != FLT_MAX)
             {
-                normals.push_back(glm::normalize(normal));
+                stack[stackSize++] = farthest;
             }
-            else 
+            if (nearest.distance != FLT_MAX)
             {
-                normals.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+                stack[stackSize++] = nearest;
             }
+            continue;
+        }
 
-            // Setter opp indekser for flaten
-            if (i < uRes && j < vRes) 
+        // Startverdien er treffet med den bilinere flaten mellom hjrnene, som biten ligger nr. Det koster bare
+        // litt aritmetikk, og strler som gr langt utenfor biten blir hoppet over uten  evaluere flaten
+        const RayLeaf& leaf = rayLeaves[node.first];
+        glm::vec2 local(0.5f);
+        glm::vec4 p1(glm::dot(n1, leaf.corners[0]) - d1, glm::dot(n1, leaf.corners[1]) - d1, glm::dot(n1, leaf.corners[2]) - d1, glm::dot(n1, leaf.corners[3]) - d1);
+        glm::vec4 p2(glm::dot(n2, leaf.corners[0]) - d2, glm::dot(n2, leaf.corners[1]) - d2, glm::dot(n2, leaf.corners[2]) - d2, glm::dot(n2, leaf.corners[3]) - d2);
+        for (int iteration = 0; iteration < 4; ++iteration)
+        {
+            float s = local.x, t = local.y;
+            float f1 = (1 - t) * ((1 - s) * p1.x + s * p1.y) + t * ((1 - s) * p1.z + s * p1.w);
+            float f2 = (1 - t) * ((1 - s) * p2.x + s * p2.y) + t * ((1 - s) * p2.z + s * p2.w);
+            float a = (1 - t) * (p1.y - p1.x) + t * (p1.w - p1.z), b = (1 - s) * (p1.z - p1.x) + s * (p1.w - p1.y);
+            float c = (1 - t) * (p2.y - p2.x) + t * (p2.w - p2.z), d = (1 - s) * (p2.z - p2.x) + s * (p2.w - p2.y);
+            float determinant = a * d - b * c;
+            if (determinant == 0.0f)
             {
-                unsigned int topLeft = j * (uRes + 1) + i;
-                unsigned int topRight = topLeft + 1;
-                unsigned int bottomLeft = (j + 1) * (uRes + 1) + i;
-                unsigned int bottomRight = bottomLeft + 1;
+                break;
+            }
+            local -= glm::vec2(d * f1 - b * f2, a * f2 - c * f1) / determinant;
+        }
+        if (!(local.x > -0.5f && local.x < 1.5f && local.y > -0.5f && local.y < 1.5f))
+        {
+            continue;
+        }
 
-                indices.push_back(topLeft);
-                indices.push_back(bottomLeft);
-                indices.push_back(bottomRight);
+        // Newton p (n1 . S(u, v) - d1, n2 . S(u, v) - d2) = 0
+        glm::vec2 parameter = glm::clamp(glm::vec2(leaf.uMin, leaf.vMin) + local * glm::vec2(leaf.uMax - leaf.uMin, leaf.vMax - leaf.vMin), minimum, maximum);
+        SurfaceSample sample;
+        bool converged = false;
+        for (int iteration = 0; iteration < 8; ++iteration)
+        {
+            sample = EvaluateDerivatives(parameter.x, parameter.y);
+            float f1 = glm::dot(n1, sample.position) - d1;
+            float f2 = glm::dot(n2, sample.position) - d2;
+            if (f1 * f1 + f2 * f2 <= tolerance * tolerance)
+            {
+                converged = true;
+                break;
+            }
 
-                indices.push_back(topLeft);
-                indices.push_back(bottomRight);
-                indices.push_back(topRight);
+            float a = glm::dot(n1, sample.du), b = glm::dot(n1, sample.dv);
+            float c = glm::dot(n2, sample.du), d = glm::dot(n2, sample.dv);
+            float determinant = a * d - b * c;
+            if (determinant == 0.0f)
+            {
+                break;
             }
+            parameter = glm::clamp(parameter - glm::vec2(d * f1 - b * f2, a * f2 - c * f1) / determinant, minimum, maximum);
+        }
+
+        // Treff utenfor biten blir funnet fra naboen, s bare treff inni (med litt slingringsmonn) teller her
+        float uMargin = 1e-3f * (leaf.uMax - leaf.uMin);
+        float vMargin = 1e-3f * (leaf.vMax - leaf.vMin);
+        if (!converged || parameter.x < leaf.uMin - uMargin || parameter.x > leaf.uMax + uMargin ||
+            parameter.y < leaf.vMin - vMargin || parameter.y > leaf.vMax + vMargin)
+        {
+            continue;
+        }
+
+        float distance = glm::dot(sample.position - origin, direction) / directionLength2;
+        if (distance >= 0.0f && distance < best)
+        {
+            best = distance;
+            hit.distance = distance;
+            hit.parameter = parameter;
+            hit.position = sample.position;
+            hit.normal = SampleNormal(sample);
+            found = true;
         }
     }
-    SetupMesh();
+    return found;
+}
+
+bool BSplineSurface::IntersectRay(const glm::vec3& origin, const glm::vec3& direction, SurfaceHit& hit, float maxDistance)
+{
+    if (rayNodes.empty())
+    {
+        BuildRayBvh();
+    }
+    return TraceRay(origin, direction, hit, maxDistance);
+}
+
+void BSplineSurface::IntersectRays(const glm::vec3* origins, const glm::vec3* directions, size_t count, SurfaceHit* hits, float maxDistance)
+{
+    if (rayNodes.empty())
+    {
+        BuildRayBvh();
+    }
+
+    // Sm batcher er ikke verdt  starte trder for
+    unsigned int chunks = count >= 4096 ? threadCount() : 1;
+    parallelFor(count, chunks, [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t n = begin; n < end; ++n)
+        {
+            TraceRay(origins[n], directions[n], hits[n], maxDistance);
+        }
+    });
+}
+bool BSplineSurface::BakeHeightField(int columns, int rows, const glm::mat4& model)
+{
+    bakedModel = model;
+    bakedDirty = false;
+    bakedRegionMin = glm::vec2(FLT_MAX);
+    bakedRegionMax = glm::vec2(-FLT_MAX);
+    bakedRegionMoved = false;
+    return bakedHeights.Bake(*this, columns, rows, model);
+}
+
+const BakedHeightField& BSplineSurface::GetBakedHeightField()
+{
+    if (bakedHeights.IsEmpty())
+    {
+        return bakedHeights;
+    }
+
+    // Hvis flaten kan ha vokst ut over boksen til feltet, blir alt bakt p nytt med en ny boks
+    glm::vec2 fieldMin = bakedHeights.GetOrigin();
+    glm::vec2 fieldMax = fieldMin + bakedHeights.GetSpacing() * glm::vec2(static_cast<float>(bakedHeights.GetColumns() - 1),
+        static_cast<float>(bakedHeights.GetRows() - 1));
+    bool outside = bakedRegionMoved && (bakedRegionMin.x < fieldMin.x || bakedRegionMin.y < fieldMin.y
+        || bakedRegionMax.x > fieldMax.x || bakedRegionMax.y > fieldMax.y);
+    if (bakedDirty || outside)
+    {
+        BakeHeightField(bakedHeights.GetColumns(), bakedHeights.GetRows(), bakedModel);
+    }
+    else if (bakedRegionMin.x <= bakedRegionMax.x)
+    {
+        bakedHeights.BakeRegion(*this, bakedRegionMin, bakedRegionMax, bakedModel, bakedRegionMoved);
+        bakedRegionMin = glm::vec2(FLT_MAX);
+        bakedRegionMax = glm::vec2(-FLT_MAX);
+        bakedRegionMoved = false;
+    }
+    return bakedHeights;
+}
+
+void BSplineSurface::BasisTable(int degree, int controlCount, const std::vector<float>& knots, const std::vector<float>& parameters,
+    std::vector<int>& spans, std::vector<float>& table) const
+{
+    spans.resize(parameters.size());
+    table.resize(parameters.size() * 2 * (degree + 1));
+    for (size_t n = 0; n < parameters.size(); ++n)
+    {
+        float derivatives[2][MaxDegree + 1];
+        spans[n] = FindKnotSpan(degree, controlCount, parameters[n], knots);
+        BasisFunctionDerivatives(spans[n], degree, 1, parameters[n], knots, derivatives);
+        std::copy(derivatives[0], derivatives[0] + degree + 1, &table[(n * 2) * (degree + 1)]);
+        std::copy(derivatives[1], derivatives[1] + degree + 1, &table[(n * 2 + 1) * (degree + 1)]);
+    }
+}
+
+// For hver u blir kontrollpunktene frst sltt sammen langs u til n kolonne av punkter (og en for derivatet i u).
+// Alle v-punktene p den linjen er da bare en B-spline kurve med de punktene som kontrollpolygon.
+// Basisfunksjonene for alle u og alle v er regnet ut p forhnd, s hvert punkt blir et lite prikkprodukt
+void BSplineSurface::TessellateGrid(int uRes, int vRes, std::vector<glm::vec3>& points, std::vector<glm::vec3>& gridNormals) const
+{
+    std::vector<float> uParameters = gridParameters(uRes, GetUMin(), GetUMax());
+    std::vector<float> vParameters = gridParameters(vRes, GetVMin(), GetVMax());
+
+    std::vector<int> uSpans, vSpans;
+    std::vector<float> uTable, vTable;
+    BasisTable(uDegree, uSize, uKnots, uParameters, uSpans, uTable);
+    BasisTable(vDegree, vSize, vKnots, vParameters, vSpans, vTable);
+
+    size_t rowLength = static_cast<size_t>(vRes) + 1;
+    points.resize((static_cast<size_t>(uRes) + 1) * rowLength);
+    gridNormals.resize(points.size());
+
+    parallelFor(uParameters.size(), [&](size_t begin, size_t end, unsigned int)
+    {
+        if (rational)
+        {
+            TessellateLines(weightedPoints, uSpans, vSpans, uTable, vTable, begin, end, points, gridNormals);
+        }
+        else
+        {
+            TessellateLines(controlPoints, uSpans, vSpans, uTable, vTable, begin, end, points, gridNormals);
+        }
+    });
 }
 
-// Beregner normalvektorer ved  bruke kryssproduktet av partiellderivater:
-// Normal(u, v) = du x dv
-glm::vec3 BSplineSurface::ComputeNormal(float u, float v)
+template <typename Point>
+void BSplineSurface::TessellateLines(const std::vector<Point>& net, const std::vector<int>& uSpans, const std::vector<int>& vSpans,
+    const std::vector<float>& uTable, const std::vector<float>& vTable, size_t begin, size_t end,
+    std::vector<glm::vec3>& points, std::vector<glm::vec3>& gridNormals) const
 {
-    glm::vec3 du = PartialDerivativeU(u, v);
-    glm::vec3 dv = PartialDerivativeV(u, v);
-    return glm::normalize(glm::cross(du, dv));
+    size_t rowLength = vSpans.size();
+    int uCount = uDegree + 1;
+    int vCount = vDegree + 1;
+    std::vector<Point> column(vSize); // Kontrollpunktene til kurven langs v
+    std::vector<Point> columnU(vSize); // Og derivatet deres i u
+    for (size_t i = begin; i < end; ++i)
+    {
+        const float* Bu = &uTable[i * 2 * uCount];
+        const float* BuPrime = Bu + uCount;
+        int first = uSpans[i] - uDegree;
+        for (int row = 0; row < vSize; ++row)
+        {
+            const Point* control = &net[static_cast<size_t>(row) * uSize + first];
+            Point point(0.0f), derivative(0.0f);
+            for (int k = 0; k < uCount; ++k)
+            {
+                point += Bu[k] * control[k];
+                derivative += BuPrime[k] * control[k];
+            }
+            column[row] = point;
+            columnU[row] = derivative;
+        }
+
+        for (size_t j = 0; j < rowLength; ++j)
+        {
+            const float* Bv = &vTable[j * 2 * vCount];
+            const float* BvPrime = Bv + vCount;
+            int firstRow = vSpans[j] - vDegree;
+            Point sums[6];
+            std::fill(sums, sums + 6, Point(0.0f));
+            for (int l = 0; l < vCount; ++l)
+            {
+                sums[0] += Bv[l] * column[firstRow + l];
+                sums[1] += Bv[l] * columnU[firstRow + l];
+                sums[2] += BvPrime[l] * column[firstRow + l];
+            }
+            SurfaceSample sample = netSample(sums);
+            points[i * rowLength + j] = sample.position;
+            gridNormals[i * rowLength + j] = SampleNormal(sample);
+        }
+    }
 }
 
+static const float normalLineLength = 0.2f; // Lengden p normalvektorene i DrawNormals
+
+// Bufferne blir laget frste gang og gjenbrukt etterp, s en ny tessellering ikke lekker VAO-er og VBO-er
 void BSplineSurface::SetupMesh() 
 {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+    if (VAO == 0)
+    {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glGenVertexArrays(1, &normalVAO);
+        glGenBuffers(1, &normalVBO);
+    }
 
     glBindVertexArray(VAO);
 
@@ -219,11 +2396,12 @@ void BSplineSurface::SetupMesh()
         vertexData.push_back(normals[i]);      
     }
 
+    // Dynamisk siden SetControlPoint oppdaterer deler av bufferet
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(glm::vec3), &vertexData[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(glm::vec3), vertexData.data(), GL_DYNAMIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
 
     // Vertex positions
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), (void*)0);
@@ -235,15 +2413,11 @@ void BSplineSurface::SetupMesh()
 
     glBindVertexArray(0);
 
-    
-    glGenVertexArrays(1, &normalVAO);
-    glGenBuffers(1, &normalVBO);
-
     std::vector<glm::vec3> normalLines;
     for (size_t i = 0; i < surfacePoints.size(); ++i) 
     {
         glm::vec3 start = surfacePoints[i];
-        glm::vec3 end = start + normals[i] * 0.2f; 
+        glm::vec3 end = start + normals[i] * normalLineLength; 
         normalLines.push_back(start);
         normalLines.push_back(end);
     }
@@ -251,7 +2425,7 @@ void BSplineSurface::SetupMesh()
     glBindVertexArray(normalVAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
-    glBufferData(GL_ARRAY_BUFFER, normalLines.size() * sizeof(glm::vec3), &normalLines[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, normalLines.size() * sizeof(glm::vec3), normalLines.data(), GL_DYNAMIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
     glEnableVertexAttribArray(0);
@@ -259,6 +2433,33 @@ void BSplineSurface::SetupMesh()
     glBindVertexArray(0);
 }
 
+// Begge bufferne har to vec3 per punkt: posisjon og normal i VBO, start og slutt p normallinjen i normalVBO
+void BSplineSurface::UploadVertices(size_t first, size_t count)
+{
+    if (VAO == 0 || count == 0)
+    {
+        return;
+    }
+
+    std::vector<glm::vec3> vertexData(count * 2);
+    std::vector<glm::vec3> normalLines(count * 2);
+    for (size_t n = 0; n < count; ++n)
+    {
+        vertexData[n * 2] = surfacePoints[first + n];
+        vertexData[n * 2 + 1] = normals[first + n];
+        normalLines[n * 2] = surfacePoints[first + n];
+        normalLines[n * 2 + 1] = surfacePoints[first + n] + normals[first + n] * normalLineLength;
+    }
+
+    GLintptr offset = static_cast<GLintptr>(first * 2 * sizeof(glm::vec3));
+    GLsizeiptr size = static_cast<GLsizeiptr>(vertexData.size() * sizeof(glm::vec3));
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, offset, size, vertexData.data());
+    glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, offset, size, normalLines.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 void BSplineSurface::DrawBSpline(Shader& shaderProgram) {
     glBindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
@@ -5,7 +5,54 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <vector>
+#include <string>
+#include <float.h>
 #include "shaderClass.h"
+#include "Parallel.h"
+#include "SimdFloat.h"
+#include "BakedHeightField.h"
+
+// Punkt p flaten med partiellderivater fra n evaluering
+struct SurfaceSample
+{
+    glm::vec3 position;
+    glm::vec3 du, dv; // Frste derivater i u og v retning
+    glm::vec3 duu, duv, dvv; // Andre derivater, bare regnet ut nr de blir bedt om (ellers null)
+};
+
+// Resultatet av EvaluateBatch, med hver komponent i sin egen array (structure of arrays)
+struct SurfaceBatch
+{
+    std::vector<float> x, y, z;
+    std::vector<float> dux, duy, duz; // Bare fylt ut nr derivatene blir bedt om
+    std::vector<float> dvx, dvy, dvz;
+};
+
+// n Bzierbit av flaten, mellom to nabo-skjteverdier i hver retning
+struct BezierPatch
+{
+    float uMin, uMax, vMin, vMax; // Parameteromrdet biten dekker i flaten
+    std::vector<glm::vec4> points; // (uDegree + 1) x (vDegree + 1) homogene punkter (w x, w y, w z, w), index = l * (uDegree + 1) + k
+    glm::vec3 boundsMin, boundsMax; // Boksen rundt kontrollpunktene, hele biten ligger inni den
+};
+
+// Nrmeste punkt p flaten til et punkt, fra ProjectPoints
+struct SurfaceProjection
+{
+    glm::vec2 parameter; // (u, v) til punktet p flaten, og startverdien neste gang med warmStart
+    glm::vec3 position; // Punktet p flaten
+    glm::vec3 normal; // Normalen i punktet, som SampleNormal
+    float distance; // Avstanden langs normalen, negativ nr punktet ligger under flaten
+};
+
+// Frste treff langs en strle, fra IntersectRays
+struct SurfaceHit
+{
+    float distance; // Treffpunktet er origin + distance * direction, FLT_MAX nr strlen ikke treffer flaten
+    glm::vec2 parameter; // (u, v) til treffpunktet
+    glm::vec3 position;
+    glm::vec3 normal; // Som SampleNormal
+};
 
 class BSplineSurface 
 {
@@ -14,27 +61,188 @@ public:
     ~BSplineSurface();
 
     void GenerateSurface(int uRes, int vRes); // Genererer flaten basert p u og v opplsning
+    void GenerateAdaptiveSurface(float tolerance, int maxDepth = 8); // Som GenerateSurface, men med TessellateAdaptive
+
+    // Punkter og normaler i et jevnt (uRes + 1) x (vRes + 1) rutenett over hele parameteromrdet, lagret med
+    // index = i * (vRes + 1) + j der i gr langs u. Basisfunksjonene blir regnet ut n gang per kolonne og rad
+    void TessellateGrid(int uRes, int vRes, std::vector<glm::vec3>& points, std::vector<glm::vec3>& gridNormals) const;
+    // Adaptiv tessellering der ingen rute avviker mer enn tolerance fra flaten (kordeavvik). Hvert polynomisk stykke
+    // mellom skjteverdiene blir delt i fire s lenge flaten buler ut fra den bilinere ruten mellom hjrnene, hyst
+    // maxDepth ganger. Ruter ved siden av mindre ruter blir tegnet som en vifte fra midten gjennom alle hjrnene
+    // langs kantene, s det ikke blir T-kryss med sprekker
+    void TessellateAdaptive(float tolerance, int maxDepth, std::vector<glm::vec3>& points, std::vector<glm::vec3>& pointNormals,
+        std::vector<unsigned int>& triangles, std::vector<glm::vec2>* parameters = nullptr) const;
+    void GenerateBezierSurface(int patchRes); // Som GenerateSurface, men med TessellateBezier
+    // patchRes x patchRes ruter per Bzierbit. Alle bitene har samme grad, s Bernsteinpolynomene blir regnet ut n gang
+    // for alle. Punktene til hver bit ligger etter hverandre med index = i * (patchRes + 1) + j der i gr langs u
+    void TessellateBezier(int patchRes, std::vector<glm::vec3>& points, std::vector<glm::vec3>& pointNormals,
+        std::vector<unsigned int>& triangles, std::vector<glm::vec2>* parameters = nullptr);
     void DrawBSpline(Shader& shaderProgram); // Rendrer flaten
     void DrawNormals(Shader& shaderProgram); // Rendrer normalvektorer p overflaten for  se at flaten har normaler
 
-    glm::vec3 EvaluateSurface(float u, float v); // Evaluerer en punktverdi p flaten basert p u og v parametere
+    glm::vec3 EvaluateSurface(float u, float v) const; // Evaluerer en punktverdi p flaten basert p u og v parametere
+
+    // Punktet og derivatene fra samme tabell av basisfunksjoner og deres derivater, s normalen og krumningen
+    // koster nesten ingenting ekstra. Andre derivater blir bare regnet ut med secondDerivatives
+    SurfaceSample EvaluateDerivatives(float u, float v, bool secondDerivatives = false) const;
+    // Evaluerer count parameterpar med SIMD, SimdFloat::Width punkter om gangen, og i parallell for store batcher
+    void EvaluateBatch(const float* u, const float* v, size_t count, SurfaceBatch& output, bool derivatives = false) const;
+    // Flaten delt i Bzierbiter med knutepunktinnsetting (Boehm) til hver skjteverdi har multiplisitet lik graden.
+    // Bitene blir laget frste gang de trengs og gjenbrukt til kontrollnettet endres. index = b * uBiter + a
+    const std::vector<BezierPatch>& GetBezierPatches();
+    SurfaceSample EvaluateBezier(float u, float v); // Punkt og frstederivater fra Bernsteinformen til biten (u, v) ligger i
+    // Nrmeste punkt p flaten for count punkter (point inversion). Startverdien er det nrmeste punktet i et jevnt
+    // gitter over flaten, der ruter med boks lenger unna enn det beste punktet s langt blir hoppet over, og blir
+    // forbedret med Newtoniterasjoner med frste- og andrederivatene fra n evaluering til steget er under tolerance.
+    // Med warmStart er parameter i projections startverdien (fra forrige bilde), og gitteret blir bare brukt nr
+    // Newton ikke konvergerer derfra. Gitteret blir laget frste gang og gjenbrukt til kontrollnettet endres
+    void ProjectPoints(const glm::vec3* points, size_t count, SurfaceProjection* projections, bool warmStart = false, float tolerance = 1e-5f);
+    SurfaceProjection ProjectPoint(const glm::vec3& point);
+    // Frste treff mellom strlen og flaten. Bzierbitene blir delt med de Casteljau til kontrollpunktene ligger nr
+    // en biliner flate, og boksene rundt kontrollpunktene til de sm bitene (som alltid inneholder flaten der) blir satt
+    // i et BVH. Strlen blir skrevet som snittet av to plan, og i hver boks den treffer blir (u, v) der flaten ligger i
+    // begge planene funnet med Newton fra midten av biten. BVH-en blir bygd frste gang og gjenbrukt til kontrollnettet endres
+    bool IntersectRay(const glm::vec3& origin, const glm::vec3& direction, SurfaceHit& hit, float maxDistance = FLT_MAX);
+    void IntersectRays(const glm::vec3* origins, const glm::vec3* directions, size_t count, SurfaceHit* hits, float maxDistance = FLT_MAX);
+    // Baker flaten til et BakedHeightField med model (se BakedHeightField::Bake). Frste gang GetBakedHeightField blir
+    // kalt etter at kontrollnettet er endret, blir feltet bakt p nytt med samme opplsning og model. Etter SetControlPoint
+    // blir bare punktene under omrdet kontrollpunktet pvirker bakt p nytt, som for meshet
+    bool BakeHeightField(int columns, int rows, const glm::mat4& model = glm::mat4(1.0f));
+    const BakedHeightField& GetBakedHeightField(); // Tomt til BakeHeightField er kalt
+    void SetSpecializedEvaluation(bool enabled); // Slr av og p evaluatorene for faste grader i EvaluateDerivatives, for sammenligning (tasten B i Main)
+    static glm::vec3 SampleNormal(const SurfaceSample& sample); // Normalisert du x dv, rett opp hvis flaten er degenerert
+    static void SampleCurvature(const SurfaceSample& sample, float& gaussian, float& mean); // Trenger andre derivater
+
+    static const int MaxDegree = 15; // Hyeste grad basisfunksjonene har plass til
+
+    // Setter et nytt kontrollnett med uSize x vSize punkter, lagret rad for rad (index = j * uSize + i).
+    // Tomme skjtevektorer blir uniforme og klemt i endene, s flaten gr gjennom hjrnepunktene.
+    // Med vekter (n per punkt, strre enn null) blir flaten en NURBS-flate, og uten blir alle vektene 1.
+    // Gir false og beholder det gamle nettet hvis strrelsene ikke stemmer
+    bool SetControlNet(int uSize, int vSize, int uDegree, int vDegree, const std::vector<glm::vec3>& points,
+        const std::vector<float>& uKnots = std::vector<float>(), const std::vector<float>& vKnots = std::vector<float>(),
+        const std::vector<float>& weights = std::vector<float>());
+
+    // Flytter kontrollpunktet (i, j) (i langs u). Bare punktene i meshet som ligger i parameteromrdet punktet
+    // pvirker, [uKnots[i], uKnots[i + uDegree + 1]] x [vKnots[j], vKnots[j + vDegree + 1]], blir regnet ut p nytt
+    // og lastet opp med glBufferSubData. Trekantene blir ikke endret, s en adaptiv tessellering beholder rutene sine
+    bool SetControlPoint(int i, int j, const glm::vec3& position);
+
+    // Leser et kontrollnett fra en tekstfil:
+    //   uSize vSize uDegree vDegree
+    //   uSize * vSize linjer med x y z, rad for rad
+    //   valgfritt: uSize + uDegree + 1 skjteverdier for u, s vSize + vDegree + 1 for v
+    //   valgfritt etter skjtevektorene: uSize * vSize vekter i samme rekkeflge som punktene.
+    //   Vekter krever skjtevektorene foran seg, og ethvert annet antall tall etter punktene er en feil
+    bool LoadControlNet(const std::string& filename);
+    bool SaveControlNet(const std::string& filename) const; // Skriver nettet i samme format, med skjtevektorer og vekter
+
+    int FindKnotSpan(int degree, int controlCount, float t, const std::vector<float>& knots) const; // Finner intervallet [knots[span], knots[span + 1]) som t ligger i med binrsk
+    void BasisFunctions(int span, int degree, float t, const std::vector<float>& knots, float* basis) const; // Regner ut de degree + 1 basisfunksjonene som ikke er null i intervallet
+
+    // Uniform skjtevektor fra 0 til 1 med degree + 1 like verdier i hver ende
+    static std::vector<float> ClampedKnots(int controlCount, int degree);
+
+    int GetUDegree() const;
+    int GetVDegree() const;
+    int GetUSize() const;
+    int GetVSize() const;
+    const std::vector<glm::vec3>& GetControlPoints() const;
+    const std::vector<float>& GetUKnots() const;
+    const std::vector<float>& GetVKnots() const;
+    const std::vector<float>& GetWeights() const; // Tom nr flaten ikke er rasjonal
+    bool IsRational() const; // Minst n vekt er ulik 1
+    float GetUMin() const; // Parameteromrdet til flaten: knots[degree] til knots[size]
+    float GetUMax() const;
+    float GetVMin() const;
+    float GetVMax() const;
 
 private:
     std::vector<glm::vec3> controlPoints; // Kontrollpunktene
     std::vector<float> uKnots; // Skjtevektor u
     std::vector<float> vKnots; // Skjtevektor v
+    std::vector<float> weights; // Vektene til kontrollpunktene, tom nr alle er 1
+    std::vector<glm::vec4> weightedPoints; // (w x, w y, w z, w) for hvert kontrollpunkt, bare for rasjonale flater
+    bool rational;
+    int uDegree, vDegree; // Graden i u og v retning
+    int uSize, vSize; // Antall kontrollpunkter i u og v retning
+    bool specializedEvaluation; // EvaluateDerivatives bruker EvaluateFixed for grad 1 til 3
     std::vector<glm::vec3> surfacePoints; // Punktdata for flaten
     std::vector<unsigned int> indices; // Rendre trekanter p flaten
     std::vector<glm::vec3> normals; // Normalvekotren for flaten
+    std::vector<glm::vec2> meshParameters; // (u, v) for hvert punkt i meshet
+    size_t gridRowLength; // vRes + 1 nr meshet er et jevnt rutenett fra GenerateSurface, ellers 0
+    std::vector<BezierPatch> bezierPatches; // Tom til GetBezierPatches bygger den
+    std::vector<float> bezierUBreaks, bezierVBreaks; // Grensene mellom bitene
+
+    // Punktgitter for startverdiene i ProjectPoints, delt i ruter p ProjectionTile x ProjectionTile punkter med hver sin boks
+    struct ProjectionGrid
+    {
+        std::vector<float> u, v; // Parameterne langs hver akse
+        std::vector<glm::vec3> points; // index = i * v.size() + j, som TessellateGrid
+        std::vector<glm::vec3> tileMin, tileMax; // index = a * vTiles + b
+        int uTiles, vTiles;
+    };
+    static const int ProjectionTile = 8;
+    ProjectionGrid projectionGrid; // Tomt til ProjectPoints trenger det
+
+    // BVH for IntersectRay. Hvert blad er et parameteromrde der flaten er nesten biliner
+    struct RayNode
+    {
+        glm::vec3 boundsMin;
+        unsigned int first; // Frste barn (det andre er first + 1), eller indeksen i rayLeaves for et blad
+        glm::vec3 boundsMax;
+        unsigned int leaf; // 1 for blader, 0 for noder med barn
+    };
+    struct RayLeaf
+    {
+        float uMin, uMax, vMin, vMax;
+        glm::vec3 corners[4]; // Flaten i (uMin, vMin), (uMax, vMin), (uMin, vMax) og (uMax, vMax), for startverdien til Newton
+    };
+    std::vector<RayNode> rayNodes; // Tom til IntersectRay trenger den, rayNodes[0] er roten
+    std::vector<RayLeaf> rayLeaves;
+
+    BakedHeightField bakedHeights;
+    glm::mat4 bakedModel; // model fra siste BakeHeightField
+    bool bakedDirty; // Kontrollnettet er byttet siden bakedHeights ble bakt
+    glm::vec2 bakedRegionMin, bakedRegionMax; // Omrdet i x og z som SetControlPoint har endret, tomt nr min > max
+    bool bakedRegionMoved; // Et kontrollpunkt er flyttet i x eller z, s flaten kan dekke nye punkter
+
+    // Basisfunksjonene og derivatene deres opp til derivativeCount: derivatives[k][j] er k-te derivat av funksjon span - degree + j
+    void BasisFunctionDerivatives(int span, int degree, int derivativeCount, float t, const std::vector<float>& knots, float (*derivatives)[MaxDegree + 1]) const;
+
+    // Basisfunksjonene (og frstederivatene hvis derivatives ikke er null) for SimdFloat::Width parametere med hvert sitt span
+    void BatchBasisFunctions(const int* spans, int degree, const SimdFloat& t, const std::vector<float>& knots,
+        SimdFloat* basis, SimdFloat* derivatives) const;
+    void EvaluateBatchBlock(const float* u, const float* v, size_t count, SurfaceBatch& output, size_t offset, bool derivatives) const;
+
+    // Punktet og frstederivatene med graden kjent ved kompilering, s lkkene over basisfunksjonene blir rullet
+    // helt ut og tabellene fr fast strrelse. EvaluateDerivatives velger en av disse med en switch for grad 1 til 3
+    // i hver retning, andre grader og andrederivater bruker de generelle lkkene
+    template <int P, int Q>
+    SurfaceSample EvaluateFixed(float u, float v) const;
+
+    // Summerer punktene fra et kontrollnett (vanlige eller homogene) langs hver linje i u for TessellateGrid
+    template <typename Point>
+    void TessellateLines(const std::vector<Point>& net, const std::vector<int>& uSpans, const std::vector<int>& vSpans,
+        const std::vector<float>& uTable, const std::vector<float>& vTable, size_t begin, size_t end,
+        std::vector<glm::vec3>& points, std::vector<glm::vec3>& gridNormals) const;
 
-    float BasisFunction(int i, int degree, float t, const std::vector<float>& knots); // Beregner basisfunksjonen for et gitt indeks, grad og parameter t
-    float BasisFunctionDerivative(int i, int degree, float t, const std::vector<float>& knots); // Beregner derivatet av basisfunksjonen for et gitt indeks, grad og parameter t
+    // Spans og basisfunksjoner med frstederivat for alle parameterne: table[(n * 2 + order) * (degree + 1) + k]
+    void BasisTable(int degree, int controlCount, const std::vector<float>& knots, const std::vector<float>& parameters,
+        std::vector<int>& spans, std::vector<float>& table) const;
 
-    glm::vec3 PartialDerivativeU(float u, float v); // Beregner partielt derivat i u-retningen p flaten
-    glm::vec3 PartialDerivativeV(float u, float v); // Beregner partielt derivat i v-retningen p flaten
-    glm::vec3 ComputeNormal(float u, float v);  // Beregner normalvektoren p et punkt p flaten
+    void BuildBezierPatches();
+    void BuildProjectionGrid();
+    glm::vec2 ProjectionSeed(const glm::vec3& point) const; // Parameteren til det nrmeste punktet i gitteret
+    bool RefineProjection(const glm::vec3& point, glm::vec2& parameter, float tolerance) const; // false hvis Newton ikke konvergerer
+    void BuildRayBvh();
+    void BuildRayNode(unsigned int index, size_t begin, size_t end, std::vector<unsigned int>& order,
+        const std::vector<glm::vec3>& leafMin, const std::vector<glm::vec3>& leafMax);
+    bool TraceRay(const glm::vec3& origin, const glm::vec3& direction, SurfaceHit& hit, float maxDistance) const; // IntersectRay nr BVH-en er bygd
 
     void SetupMesh();
+    void UploadVertices(size_t first, size_t count); // Oppdaterer punktene first til first + count i bufferne
 
     GLuint VAO, VBO, EBO;
     GLuint normalVAO, normalVBO;
@@ -0,0 +1,404 @@
+#ifndef BAKEDGRID_H
+#define BAKEDGRID_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include "SimdFloat.h"
+#include "Parallel.h"
+
+enum HeightInterpolation
+{
+    BILINEAR_INTERPOLATION, // Fra de fire nrmeste punktene
+    BICUBIC_INTERPOLATION // Catmull-Rom fra de 16 nrmeste, gr gjennom punktene og er glatt over kantene mellom rutene
+};
+
+// Verdier samplet i et jevnt rutenett over x og z, felles for BakedHeightField i 3DTerreng og BSpline.
+// Punktene er lagret i blokker p TileSize x TileSize etter hverandre i minnet, s naboene til et punkt nesten alltid
+// ligger i de samme cache-linjene, og hver kanal har sin egen array s et oppslag bare leser kanalene det trenger.
+// Utenfor rutenettet blir kanten brukt, og punkter som ikke er satt er NaN
+class BakedGrid
+{
+public:
+    static const int TileSize = 8; // Punkter langs hver side av en blokk
+    static const int MaxChannels = 8;
+
+    BakedGrid();
+
+    // columns x rows punkter der punkt (0, 0) ligger i gridOrigin, med channelCount kanaler som alle er NaN
+    void Reset(const glm::vec2& gridOrigin, const glm::vec2& gridSpacing, int columnCount, int rowCount, int channelCount);
+    void Clear();
+
+    // Plassen til punktet i kanalene er RowOffset(row) + ColumnOffset(column), s delene kan regnes ut n gang
+    // per rad og kolonne
+    size_t Index(int column, int row) const;
+    size_t ColumnOffset(int column) const;
+    size_t RowOffset(int row) const;
+    glm::vec2 Position(int column, int row) const; // x og z til punktet
+    std::vector<float>& Channel(int channel);
+    const std::vector<float>& Channel(int channel) const;
+
+    float Sample(int channel, float x, float z, HeightInterpolation interpolation) const;
+
+    // Interpolerer kanalene i channelList for count punkter, SimdFloat::Width om gangen og i parallell for store
+    // batcher. store(offset, lanes, values) fr values[c][k] for kanal channelList[c] i punkt offset + k
+    template <typename Store>
+    void SampleBatch(const float* x, const float* z, size_t count, const int* channelList, int channelCount,
+        HeightInterpolation interpolation, Store store) const;
+
+    bool IsEmpty() const;
+    int GetColumns() const;
+    int GetRows() const;
+    const glm::vec2& GetOrigin() const; // x og z til punkt (0, 0)
+    const glm::vec2& GetSpacing() const; // Avstanden mellom punktene i x og z
+
+private:
+    // Interpolerer channelCount kanaler for punktene [offset, offset + SimdFloat::Width), eller frre p slutten.
+    // Indeksene og vektene blir regnet ut n gang og brukt for alle kanalene
+    void sampleBlock(const float* x, const float* z, size_t count, size_t offset, const int* channelList,
+        int channelCount, float* const* outputs, HeightInterpolation interpolation) const;
+
+    int columns, rows;
+    int tileColumns; // Antall blokker langs x
+    glm::vec2 origin, spacing;
+    std::vector<std::vector<float>> channels;
+};
+
+// Catmull-Rom vektene for punktene -1, 0, 1 og 2 rundt t i [0, 1]
+inline void catmullRomWeights(float t, float* weights)
+{
+    float t2 = t * t;
+    float t3 = t2 * t;
+    weights[0] = 0.5f * (-t3 + 2.0f * t2 - t);
+    weights[1] = 0.5f * (3.0f * t3 - 5.0f * t2 + 2.0f);
+    weights[2] = 0.5f * (-3.0f * t3 + 4.0f * t2 + t);
+    weights[3] = 0.5f * (t3 - t2);
+}
+
+inline void catmullRomWeights(SimdFloat t, SimdFloat* weights)
+{
+    SimdFloat half(0.5f);
+    SimdFloat t2 = t * t;
+    SimdFloat t3 = t2 * t;
+    weights[0] = half * (SimdFloat(2.0f) * t2 - t3 - t);
+    weights[1] = half * (SimdFloat(3.0f) * t3 - SimdFloat(5.0f) * t2 + SimdFloat(2.0f));
+    weights[2] = half * (SimdFloat(4.0f) * t2 - SimdFloat(3.0f) * t3 + t);
+    weights[3] = half * (t3 - t2);
+}
+
+// Ved kanten blir punktet utenfor rutenettet forlenget linert fra de to innenfor, 2 p0 - p1, s rette
+// flater blir gjengitt nyaktig. first er den frste av de fire punktene, count antall punkter i retningen
+inline void extrapolateEdgeWeights(int first, int count, float* weights)
+{
+    if (first < 0)
+    {
+        weights[1] += 2.0f * weights[0];
+        weights[2] -= weights[0];
+        weights[0] = 0.0f;
+    }
+    if (first + 3 > count - 1)
+    {
+        weights[2] += 2.0f * weights[3];
+        weights[1] -= weights[3];
+        weights[3] = 0.0f;
+    }
+}
+
+inline BakedGrid::BakedGrid()
+    : columns(0), rows(0), tileColumns(0), origin(0.0f), spacing(0.0f)
+{
+}
+
+inline void BakedGrid::Reset(const glm::vec2& gridOrigin, const glm::vec2& gridSpacing, int columnCount, int rowCount, int channelCount)
+{
+    columns = columnCount;
+    rows = rowCount;
+    tileColumns = (columns + TileSize - 1) / TileSize;
+    int tileRows = (rows + TileSize - 1) / TileSize;
+    origin = gridOrigin;
+    spacing = gridSpacing;
+
+    size_t sampleCount = static_cast<size_t>(tileColumns) * tileRows * TileSize * TileSize;
+    channels.resize(channelCount);
+    for (std::vector<float>& channel : channels)
+    {
+        channel.assign(sampleCount, std::numeric_limits<float>::quiet_NaN());
+    }
+}
+
+inline void BakedGrid::Clear()
+{
+    columns = rows = tileColumns = 0;
+    channels.clear();
+}
+
+inline size_t BakedGrid::Index(int column, int row) const
+{
+    return RowOffset(row) + ColumnOffset(column);
+}
+
+inline size_t BakedGrid::ColumnOffset(int column) const
+{
+    unsigned int c = static_cast<unsigned int>(column);
+    return static_cast<size_t>(c / TileSize) * TileSize * TileSize + c % TileSize;
+}
+
+inline size_t BakedGrid::RowOffset(int row) const
+{
+    unsigned int r = static_cast<unsigned int>(row);
+    return (static_cast<size_t>(r / TileSize) * tileColumns * TileSize + r % TileSize) * TileSize;
+}
+
+inline glm::vec2 BakedGrid::Position(int column, int row) const
+{
+    return origin + spacing * glm::vec2(static_cast<float>(column), static_cast<float>(row));
+}
+
+inline std::vector<float>& BakedGrid::Channel(int channel)
+{
+    return channels[channel];
+}
+
+inline const std::vector<float>& BakedGrid::Channel(int channel) const
+{
+    return channels[channel];
+}
+
+inline float BakedGrid::Sample(int channel, float x, float z, HeightInterpolation interpolation) const
+{
+    if (channels.empty())
+    {
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+    const std::vector<float>& values = channels[channel];
+
+    float fx = glm::clamp((x - origin.x) / spacing.x, 0.0f, static_cast<float>(columns - 1));
+    float fz = glm::clamp((z - origin.y) / spacing.y, 0.0f, static_cast<float>(rows - 1));
+    int column = std::min(static_cast<int>(fx), columns - 2);
+    int row = std::min(static_cast<int>(fz), rows - 2);
+    float s = fx - column;
+    float t = fz - row;
+
+    if (interpolation == BILINEAR_INTERPOLATION)
+    {
+        size_t column0 = ColumnOffset(column), column1 = ColumnOffset(column + 1);
+        size_t row0 = RowOffset(row), row1 = RowOffset(row + 1);
+        float h00 = values[row0 + column0];
+        float h10 = values[row0 + column1];
+        float h01 = values[row1 + column0];
+        float h11 = values[row1 + column1];
+        return (h00 * (1.0f - s) + h10 * s) * (1.0f - t) + (h01 * (1.0f - s) + h11 * s) * t;
+    }
+
+    float sWeights[4], tWeights[4];
+    catmullRomWeights(s, sWeights);
+    catmullRomWeights(t, tWeights);
+    extrapolateEdgeWeights(column - 1, columns, sWeights);
+    extrapolateEdgeWeights(row - 1, rows, tWeights);
+    size_t columnOffsets[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        columnOffsets[i] = ColumnOffset(glm::clamp(column + i - 1, 0, columns - 1));
+    }
+    float value = 0.0f;
+    for (int j = 0; j < 4; ++j)
+    {
+        const float* line = &values[RowOffset(glm::clamp(row + j - 1, 0, rows - 1))];
+        value += tWeights[j] * (sWeights[0] * line[columnOffsets[0]] + sWeights[1] * line[columnOffsets[1]] +
+            sWeights[2] * line[columnOffsets[2]] + sWeights[3] * line[columnOffsets[3]]);
+    }
+    return value;
+}
+
+inline void BakedGrid::sampleBlock(const float* x, const float* z, size_t count, size_t offset, const int* channelList,
+    int channelCount, float* const* outputs, HeightInterpolation interpolation) const
+{
+    const int W = SimdFloat::Width;
+    int lanes = static_cast<int>(std::min(count - offset, static_cast<size_t>(W)));
+
+    // Den siste blokken blir fylt opp med det siste punktet
+    float xs[SimdFloat::Width], zs[SimdFloat::Width];
+    const float* xBlock = x + offset;
+    const float* zBlock = z + offset;
+    if (lanes < W)
+    {
+        for (int k = 0; k < W; ++k)
+        {
+            xs[k] = x[offset + std::min(k, lanes - 1)];
+            zs[k] = z[offset + std::min(k, lanes - 1)];
+        }
+        xBlock = xs;
+        zBlock = zs;
+    }
+
+    SimdFloat zero(0.0f);
+    SimdFloat fx = Min(Max((SimdFloat::Load(xBlock) - SimdFloat(origin.x)) * SimdFloat(1.0f / spacing.x), zero), SimdFloat(static_cast<float>(columns - 1)));
+    SimdFloat fz = Min(Max((SimdFloat::Load(zBlock) - SimdFloat(origin.y)) * SimdFloat(1.0f / spacing.y), zero), SimdFloat(static_cast<float>(rows - 1)));
+    float fxs[SimdFloat::Width], fzs[SimdFloat::Width];
+    fx.Store(fxs);
+    fz.Store(fzs);
+
+    int blockColumns[SimdFloat::Width], blockRows[SimdFloat::Width];
+    float ss[SimdFloat::Width], ts[SimdFloat::Width];
+    for (int k = 0; k < W; ++k)
+    {
+        blockColumns[k] = std::min(static_cast<int>(fxs[k]), columns - 2);
+        blockRows[k] = std::min(static_cast<int>(fzs[k]), rows - 2);
+        ss[k] = fxs[k] - blockColumns[k];
+        ts[k] = fzs[k] - blockRows[k];
+    }
+    SimdFloat s = SimdFloat::Load(ss);
+    SimdFloat t = SimdFloat::Load(ts);
+
+    if (interpolation == BILINEAR_INTERPOLATION)
+    {
+        int indices[4][SimdFloat::Width];
+        for (int k = 0; k < W; ++k)
+        {
+            int column0 = static_cast<int>(ColumnOffset(blockColumns[k])), column1 = static_cast<int>(ColumnOffset(blockColumns[k] + 1));
+            int row0 = static_cast<int>(RowOffset(blockRows[k])), row1 = static_cast<int>(RowOffset(blockRows[k] + 1));
+            indices[0][k] = row0 + column0;
+            indices[1][k] = row0 + column1;
+            indices[2][k] = row1 + column0;
+            indices[3][k] = row1 + column1;
+        }
+
+        SimdFloat one(1.0f);
+        SimdFloat weights[4] = { (one - s) * (one - t), s * (one - t), (one - s) * t, s * t };
+        for (int c = 0; c < channelCount; ++c)
+        {
+            const float* channel = channels[channelList[c]].data();
+            SimdFloat value = zero;
+            for (int n = 0; n < 4; ++n)
+            {
+                value = value + weights[n] * SimdFloat::Gather(channel, indices[n]);
+            }
+            value.Store(outputs[c]);
+        }
+        return;
+    }
+
+    int indices[16][SimdFloat::Width];
+    for (int k = 0; k < W; ++k)
+    {
+        int columnOffsets[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            columnOffsets[i] = static_cast<int>(ColumnOffset(glm::clamp(blockColumns[k] + i - 1, 0, columns - 1)));
+        }
+        for (int j = 0; j < 4; ++j)
+        {
+            int row = static_cast<int>(RowOffset(glm::clamp(blockRows[k] + j - 1, 0, rows - 1)));
+            for (int i = 0; i < 4; ++i)
+            {
+                indices[j * 4 + i][k] = row + columnOffsets[i];
+            }
+        }
+    }
+
+    SimdFloat sWeights[4], tWeights[4];
+    catmullRomWeights(s, sWeights);
+    catmullRomWeights(t, tWeights);
+    bool edge = false;
+    for (int k = 0; k < W; ++k)
+    {
+        edge |= blockColumns[k] == 0 || blockColumns[k] == columns - 2 || blockRows[k] == 0 || blockRows[k] == rows - 2;
+    }
+    if (edge)
+    {
+        // Vektene for punktene langs kanten blir rettet en om gangen
+        float laneWeights[2][4][SimdFloat::Width];
+        for (int i = 0; i < 4; ++i)
+        {
+            sWeights[i].Store(laneWeights[0][i]);
+            tWeights[i].Store(laneWeights[1][i]);
+        }
+        for (int k = 0; k < W; ++k)
+        {
+            float sLane[4] = { laneWeights[0][0][k], laneWeights[0][1][k], laneWeights[0][2][k], laneWeights[0][3][k] };
+            float tLane[4] = { laneWeights[1][0][k], laneWeights[1][1][k], laneWeights[1][2][k], laneWeights[1][3][k] };
+            extrapolateEdgeWeights(blockColumns[k] - 1, columns, sLane);
+            extrapolateEdgeWeights(blockRows[k] - 1, rows, tLane);
+            for (int i = 0; i < 4; ++i)
+            {
+                laneWeights[0][i][k] = sLane[i];
+                laneWeights[1][i][k] = tLane[i];
+            }
+        }
+        for (int i = 0; i < 4; ++i)
+        {
+            sWeights[i] = SimdFloat::Load(laneWeights[0][i]);
+            tWeights[i] = SimdFloat::Load(laneWeights[1][i]);
+        }
+    }
+
+    for (int c = 0; c < channelCount; ++c)
+    {
+        const float* channel = channels[channelList[c]].data();
+        SimdFloat value = zero;
+        for (int j = 0; j < 4; ++j)
+        {
+            SimdFloat line = zero;
+            for (int i = 0; i < 4; ++i)
+            {
+                line = line + sWeights[i] * SimdFloat::Gather(channel, indices[j * 4 + i]);
+            }
+            value = value + tWeights[j] * line;
+        }
+        value.Store(outputs[c]);
+    }
+}
+
+template <typename Store>
+void BakedGrid::SampleBatch(const float* x, const float* z, size_t count, const int* channelList, int channelCount,
+    HeightInterpolation interpolation, Store store) const
+{
+    // Sm batcher er ikke verdt  starte trder for
+    const size_t W = SimdFloat::Width;
+    size_t blocks = (count + W - 1) / W;
+    unsigned int chunks = count >= 16384 ? threadCount() : 1;
+    parallelFor(blocks, chunks, [&](size_t begin, size_t end, unsigned int)
+    {
+        float values[MaxChannels][SimdFloat::Width];
+        float* outputs[MaxChannels];
+        for (int c = 0; c < channelCount; ++c)
+        {
+            outputs[c] = values[c];
+        }
+        for (size_t block = begin; block < end; ++block)
+        {
+            size_t offset = block * W;
+            sampleBlock(x, z, count, offset, channelList, channelCount, outputs, interpolation);
+            store(offset, std::min(W, count - offset), outputs);
+        }
+    });
+}
+
+inline bool BakedGrid::IsEmpty() const
+{
+    return channels.empty();
+}
+
+inline int BakedGrid::GetColumns() const
+{
+    return columns;
+}
+
+inline int BakedGrid::GetRows() const
+{
+    return rows;
+}
+
+inline const glm::vec2& BakedGrid::GetOrigin() const
+{
+    return origin;
+}
+
+inline const glm::vec2& BakedGrid::GetSpacing() const
+{
+    return spacing;
+}
+
+#endif // !BAKEDGRID_H
@@ -0,0 +1,303 @@
+#include "BakedHeightField.h"
+#include "BSplineSurface.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+BakedHeightField::BakedHeightField()
+{
+}
+
+void BakedHeightField::Clear()
+{
+    grid.Clear();
+}
+
+// Opplsningen til den grove tesselleringen som gir boksen og startverdiene til Newton
+static const int seedResolution = 64;
+
+// Tessellerer flaten grovt og gjr punktene om med model
+static std::vector<glm::vec3> seedPointsOf(const BSplineSurface& surface, const glm::mat4& model)
+{
+    std::vector<glm::vec3> seedPoints, seedNormals;
+    surface.TessellateGrid(seedResolution, seedResolution, seedPoints, seedNormals);
+    for (glm::vec3& point : seedPoints)
+    {
+        point = glm::vec3(model * glm::vec4(point, 1.0f));
+    }
+    return seedPoints;
+}
+
+bool BakedHeightField::Bake(const BSplineSurface& surface, int columns, int rows, const glm::mat4& model)
+{
+    if (columns < 2 || rows < 2)
+    {
+        std::cerr << "Error: A baked height field needs at least 2 x 2 samples" << std::endl;
+        return false;
+    }
+
+    std::vector<glm::vec3> seedPoints = seedPointsOf(surface, model);
+    glm::vec2 boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max());
+    for (const glm::vec3& point : seedPoints)
+    {
+        boundsMin = glm::min(boundsMin, glm::vec2(point.x, point.z));
+        boundsMax = glm::max(boundsMax, glm::vec2(point.x, point.z));
+    }
+    glm::vec2 extent = boundsMax - boundsMin;
+    if (!(extent.x > 0.0f && extent.y > 0.0f))
+    {
+        std::cerr << "Error: The surface must span an area in x and z to be baked" << std::endl;
+        return false;
+    }
+
+    grid.Reset(boundsMin, extent / glm::vec2(static_cast<float>(columns - 1), static_cast<float>(rows - 1)), columns, rows, CHANNEL_COUNT);
+    if (bakeCells(surface, model, seedPoints, 0, columns - 1, 0, rows - 1, false) == 0)
+    {
+        std::cerr << "Error: The surface is not a height field over x and z" << std::endl;
+        Clear();
+        return false;
+    }
+    return true;
+}
+
+bool BakedHeightField::BakeRegion(const BSplineSurface& surface, const glm::vec2& regionMin, const glm::vec2& regionMax,
+    const glm::mat4& model, bool retryEmpty)
+{
+    if (grid.IsEmpty())
+    {
+        return false;
+    }
+
+    // Punktene som ligger i omrdet, og de nrmeste utenfor s kantene blir med
+    const glm::vec2& origin = grid.GetOrigin();
+    const glm::vec2& spacing = grid.GetSpacing();
+    int column0 = std::max(static_cast<int>(std::floor((regionMin.x - origin.x) / spacing.x)), 0);
+    int column1 = std::min(static_cast<int>(std::ceil((regionMax.x - origin.x) / spacing.x)), grid.GetColumns() - 1);
+    int row0 = std::max(static_cast<int>(std::floor((regionMin.y - origin.y) / spacing.y)), 0);
+    int row1 = std::min(static_cast<int>(std::ceil((regionMax.y - origin.y) / spacing.y)), grid.GetRows() - 1);
+    if (column0 > column1 || row0 > row1)
+    {
+        return true;
+    }
+
+    std::vector<glm::vec3> seedPoints;
+    if (retryEmpty)
+    {
+        seedPoints = seedPointsOf(surface, model);
+    }
+    bakeCells(surface, model, seedPoints, column0, column1, row0, row1, !retryEmpty);
+    return true;
+}
+
+size_t BakedHeightField::bakeCells(const BSplineSurface& surface, const glm::mat4& model, const std::vector<glm::vec3>& seedPoints,
+    int column0, int column1, int row0, int row1, bool skipEmpty)
+{
+    // Posisjoner blir gjort om med hele model og derivater med bare den linere delen. Kryssproduktet av de
+    // omgjorte derivatene str da vinkelrett p den omgjorte flaten, ogs nr model skalerer ulikt i hver retning
+    glm::mat3 linear(model);
+
+    float uMin = surface.GetUMin(), uMax = surface.GetUMax();
+    float vMin = surface.GetVMin(), vMax = surface.GetVMax();
+    glm::vec2 extent = grid.GetSpacing() * glm::vec2(static_cast<float>(grid.GetColumns() - 1), static_cast<float>(grid.GetRows() - 1));
+    float tolerance = 1e-5f * std::max(extent.x, extent.y);
+
+    // Lser (model * flaten(u, v)).xz = target. sample blir gjort om med model. Gir false nr Newton ikke
+    // kommer nr nok, som utenfor flaten
+    auto solve = [&](const glm::vec2& target, glm::vec2& parameter, SurfaceSample& sample) -> bool
+    {
+        for (int iteration = 0; iteration < 12; ++iteration)
+        {
+            sample = surface.EvaluateDerivatives(parameter.x, parameter.y);
+            sample.position = glm::vec3(model * glm::vec4(sample.position, 1.0f));
+            sample.du = linear * sample.du;
+            sample.dv = linear * sample.dv;
+            glm::vec2 error(sample.position.x - target.x, sample.position.z - target.y);
+            if (std::abs(error.x) < tolerance && std::abs(error.y) < tolerance)
+            {
+                return true;
+            }
+            float determinant = sample.du.x * sample.dv.z - sample.dv.x * sample.du.z;
+            if (std::abs(determinant) < 1e-12f)
+            {
+                return false;
+            }
+            parameter.x = glm::clamp(parameter.x + (sample.dv.x * error.y - sample.dv.z * error.x) / determinant, uMin, uMax);
+            parameter.y = glm::clamp(parameter.y + (sample.du.z * error.x - sample.du.x * error.y) / determinant, vMin, vMax);
+        }
+        return false;
+    };
+
+    // Det nrmeste punktet i x og z i den grove tesselleringen, index = i * (seedResolution + 1) + j der i gr langs u
+    auto seed = [&](const glm::vec2& target) -> glm::vec2
+    {
+        size_t nearest = 0;
+        float nearestDistance = std::numeric_limits<float>::max();
+        for (size_t n = 0; n < seedPoints.size(); ++n)
+        {
+            float dx = seedPoints[n].x - target.x;
+            float dz = seedPoints[n].z - target.y;
+            float distance = dx * dx + dz * dz;
+            if (distance < nearestDistance)
+            {
+                nearestDistance = distance;
+                nearest = n;
+            }
+        }
+        float i = static_cast<float>(nearest / (seedResolution + 1));
+        float j = static_cast<float>(nearest % (seedResolution + 1));
+        return glm::vec2(uMin + (uMax - uMin) * i / seedResolution, vMin + (vMax - vMin) * j / seedResolution);
+    };
+
+    std::vector<float>& heights = grid.Channel(HEIGHT);
+    std::vector<float>& normalX = grid.Channel(NORMAL_X);
+    std::vector<float>& normalY = grid.Channel(NORMAL_Y);
+    std::vector<float>& normalZ = grid.Channel(NORMAL_Z);
+    std::vector<float>& parameterU = grid.Channel(PARAMETER_U);
+    std::vector<float>& parameterV = grid.Channel(PARAMETER_V);
+
+    // Hvert punkt prver frst (u, v) fra forrige baking, s lsningen til punktet fr i raden, og til slutt
+    // det nrmeste punktet i den grove tesselleringen hvis den er laget
+    std::vector<size_t> solvedCounts(threadCount(), 0);
+    parallelFor(static_cast<size_t>(row1 - row0 + 1), [&](size_t begin, size_t end, unsigned int chunk)
+    {
+        for (int row = row0 + static_cast<int>(begin); row < row0 + static_cast<int>(end); ++row)
+        {
+            bool previous = false;
+            glm::vec2 previousParameter(0.0f);
+            for (int column = column0; column <= column1; ++column)
+            {
+                size_t index = grid.Index(column, row);
+                glm::vec2 stored(parameterU[index], parameterV[index]);
+                bool empty = std::isnan(stored.x);
+                if (empty && skipEmpty)
+                {
+                    previous = false;
+                    continue;
+                }
+
+                glm::vec2 target = grid.Position(column, row);
+                glm::vec2 parameter = stored;
+                SurfaceSample sample;
+                bool solved = !empty && solve(target, parameter, sample);
+                if (!solved && previous)
+                {
+                    parameter = previousParameter;
+                    solved = solve(target, parameter, sample);
+                }
+                if (!solved && !seedPoints.empty())
+                {
+                    parameter = seed(target);
+                    solved = solve(target, parameter, sample);
+                }
+                previous = solved;
+                previousParameter = parameter;
+                if (!solved)
+                {
+                    heights[index] = normalX[index] = normalY[index] = normalZ[index] = std::numeric_limits<float>::quiet_NaN();
+                    parameterU[index] = parameterV[index] = std::numeric_limits<float>::quiet_NaN();
+                    continue;
+                }
+
+                glm::vec3 normal = BSplineSurface::SampleNormal(sample);
+                if (normal.y < 0.0f)
+                {
+                    normal = -normal;
+                }
+                heights[index] = sample.position.y;
+                normalX[index] = normal.x;
+                normalY[index] = normal.y;
+                normalZ[index] = normal.z;
+                parameterU[index] = parameter.x;
+                parameterV[index] = parameter.y;
+                ++solvedCounts[chunk];
+            }
+        }
+    });
+
+    size_t solved = 0;
+    for (size_t count : solvedCounts)
+    {
+        solved += count;
+    }
+    return solved;
+}
+
+float BakedHeightField::HeightAt(float x, float z, HeightInterpolation interpolation) const
+{
+    return grid.Sample(HEIGHT, x, z, interpolation);
+}
+
+glm::vec3 BakedHeightField::NormalAt(float x, float z, HeightInterpolation interpolation) const
+{
+    glm::vec3 normal(grid.Sample(NORMAL_X, x, z, interpolation), grid.Sample(NORMAL_Y, x, z, interpolation),
+        grid.Sample(NORMAL_Z, x, z, interpolation));
+    float length = glm::length(normal);
+    return length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+glm::vec2 BakedHeightField::ParameterAt(float x, float z, HeightInterpolation interpolation) const
+{
+    return glm::vec2(grid.Sample(PARAMETER_U, x, z, interpolation), grid.Sample(PARAMETER_V, x, z, interpolation));
+}
+
+void BakedHeightField::HeightsAt(const float* x, const float* z, size_t count, float* output, HeightInterpolation interpolation) const
+{
+    if (grid.IsEmpty())
+    {
+        std::fill(output, output + count, std::numeric_limits<float>::quiet_NaN());
+        return;
+    }
+
+    const int channels[1] = { HEIGHT };
+    grid.SampleBatch(x, z, count, channels, 1, interpolation, [output](size_t offset, size_t lanes, float* const* values)
+    {
+        std::copy(values[0], values[0] + lanes, output + offset);
+    });
+}
+
+void BakedHeightField::NormalsAt(const float* x, const float* z, size_t count, glm::vec3* output, HeightInterpolation interpolation) const
+{
+    if (grid.IsEmpty())
+    {
+        std::fill(output, output + count, glm::vec3(0.0f, 1.0f, 0.0f));
+        return;
+    }
+
+    const int channels[3] = { NORMAL_X, NORMAL_Y, NORMAL_Z };
+    grid.SampleBatch(x, z, count, channels, 3, interpolation, [output](size_t offset, size_t lanes, float* const* values)
+    {
+        for (size_t k = 0; k < lanes; ++k)
+        {
+            glm::vec3 normal(values[0][k], values[1][k], values[2][k]);
+            float length = glm::length(normal);
+            output[offset + k] = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    });
+}
+
+bool BakedHeightField::IsEmpty() const
+{
+    return grid.IsEmpty();
+}
+
+int BakedHeightField::GetColumns() const
+{
+    return grid.GetColumns();
+}
+
+int BakedHeightField::GetRows() const
+{
+    return grid.GetRows();
+}
+
+const glm::vec2& BakedHeightField::GetOrigin() const
+{
+    return grid.GetOrigin();
+}
+
+const glm::vec2& BakedHeightField::GetSpacing() const
+{
+    return grid.GetSpacing();
+}
@@ -0,0 +1,71 @@
+#ifndef BAKEDHEIGHTFIELD_H
+#define BAKEDHEIGHTFIELD_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "BakedGrid.h"
+
+class BSplineSurface;
+
+// Hyde, normal og (u, v) for en flate samplet i et BakedGrid over x og z, s et oppslag under simuleringen
+// bare er noen f minnelesinger i stedet for en evaluering av flaten. Flaten m vre et hydefelt etter at
+// model har gjort den om til koordinater med y opp. Punkter der Newton ikke fant flaten er NaN, og oppslag
+// utenfor boksen gir verdiene p kanten
+class BakedHeightField
+{
+public:
+    BakedHeightField();
+
+    // columns x rows punkter over boksen til model * flaten i x og z. model gjr flaten om til koordinatene
+    // hydefeltet er i, med y opp: identiteten for flater fra SurfaceFit, og rotasjonen Main tegner standardflaten
+    // med nr den har z opp. For hvert punkt blir (u, v) der flaten ligger over punktet funnet med Newton p x og z,
+    // med startverdi fra punktet fr i samme rad eller det nrmeste punktet i en grov tessellering.
+    // Radene blir bakt i parallell. BSplineSurface::BakeHeightField holder feltet oppdatert nr kontrollnettet endres
+    bool Bake(const BSplineSurface& surface, int columns, int rows, const glm::mat4& model = glm::mat4(1.0f));
+    // Baker bare punktene i [regionMin, regionMax] i x og z p nytt, med (u, v) fra forrige baking som startverdi, s
+    // en flate som bare har endret hyde trenger n evaluering per punkt. Punkter uten verdi blir bare prvd p nytt
+    // med retryEmpty, for nr flaten kan ha flyttet seg i x og z. Boksen og opplsningen blir beholdt.
+    // Gir false nr feltet ikke er bakt
+    bool BakeRegion(const BSplineSurface& surface, const glm::vec2& regionMin, const glm::vec2& regionMax,
+        const glm::mat4& model, bool retryEmpty);
+    void Clear();
+
+    float HeightAt(float x, float z, HeightInterpolation interpolation = BILINEAR_INTERPOLATION) const;
+    glm::vec3 NormalAt(float x, float z, HeightInterpolation interpolation = BILINEAR_INTERPOLATION) const; // Normalisert, peker opp
+    glm::vec2 ParameterAt(float x, float z, HeightInterpolation interpolation = BILINEAR_INTERPOLATION) const; // (u, v) p flaten
+
+    // Som over for count punkter, SimdFloat::Width om gangen og i parallell for store batcher
+    void HeightsAt(const float* x, const float* z, size_t count, float* heights,
+        HeightInterpolation interpolation = BILINEAR_INTERPOLATION) const;
+    void NormalsAt(const float* x, const float* z, size_t count, glm::vec3* normals,
+        HeightInterpolation interpolation = BILINEAR_INTERPOLATION) const;
+
+    bool IsEmpty() const;
+    int GetColumns() const;
+    int GetRows() const;
+    const glm::vec2& GetOrigin() const; // x og z til punkt (0, 0)
+    const glm::vec2& GetSpacing() const; // Avstanden mellom punktene i x og z
+
+private:
+    enum Channel
+    {
+        HEIGHT,
+        NORMAL_X,
+        NORMAL_Y,
+        NORMAL_Z,
+        PARAMETER_U,
+        PARAMETER_V,
+        CHANNEL_COUNT
+    };
+
+    BakedGrid grid;
+
+    // Lser punktene i kolonnene [column0, column1] og radene [row0, row1] og gir antall punkter som fikk verdi.
+    // seedPoints er en grov tessellering gjort om med model, eller tom nr punktene bare skal startes fra (u, v) de har.
+    // Med skipEmpty blir punkter uten verdi stende
+    size_t bakeCells(const BSplineSurface& surface, const glm::mat4& model, const std::vector<glm::vec3>& seedPoints,
+        int column0, int column1, int row0, int row1, bool skipEmpty);
+};
+
+#endif // !BAKEDHEIGHTFIELD_H
@@ -51,3 +51,9 @@ void Collision::responseBallCollision(glm::vec3& pos1, glm::vec3& pos2, glm::vec
 // Direction: beregner den normaliserte retningsvektoren fra ball 2 to ball 1.
 // Overlap: beregner hvor mye de to ballene overlapper.
 
+void Collision::responseSurfaceContact(glm::vec3& position, glm::vec3& velocity, const glm::vec3& contactPoint, const glm::vec3& contactNormal, float radius)
+{
+    position = contactPoint + contactNormal * radius; // Ballen ligger opp flaten, radius ut fra nrmeste punkt
+    velocity -= contactNormal * glm::dot(velocity, contactNormal); // Fjerner farten inn i og ut av flaten, s ballen ruller langs den
+}
+// contactPoint og contactNormal er nrmeste punkt p flaten til sentrum av ballen og normalen der, fra BSplineSurface::ProjectPoints.
@@ -10,6 +10,14 @@
 #include "BSplineSurface.h"
 #include "Ball.h"
 #include "Collision.h"
+#include "SurfaceFit.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <chrono>
 
 using namespace std;
 
@@ -24,6 +32,8 @@ Camera camera(glm::vec3(1.5f, 1.0f, 6.0f));
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
+bool pickKeyPressed = false; // P var nede forrige bilde
+bool benchmarkKeyPressed = false; // B var nede forrige bilde
 
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
@@ -33,11 +43,114 @@ float ballRadius = 0.05; // Radius til ballene
 // Lys
 glm::vec3 lightPos(10.0f, 10.0f, 20.0f);
 
-// Konstant grenser
-const float minX = 0.05f;
-const float maxX = 2.95f;
-const float minZ = -1.95f;
-const float maxZ = -0.05f;
+// Grensene ballene spretter mot, like innenfor kanten av flaten. Satt av setWalls
+float minX = 0.05f;
+float maxX = 2.95f;
+float minZ = -1.95f;
+float maxZ = -0.05f;
+
+// Skalerer punktene likt i alle retninger s de fr plass i x [0, 3] og z [-2, 0] som standardflaten,
+// med det laveste punktet i y = 0
+void fitToScene(std::vector<glm::vec3>& points)
+{
+	glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+	for (const glm::vec3& point : points)
+	{
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+	float scale = std::min(3.0f / std::max(max.x - min.x, 1e-6f), 2.0f / std::max(max.z - min.z, 1e-6f));
+	glm::vec3 offset(-min.x, -min.y, -max.z);
+	for (glm::vec3& point : points)
+		point = (point + offset) * scale;
+}
+
+// Leser flaten fra filename. En .net-fil er et kontrollnett fra SaveControlNet, alt annet er punkter fra 3DTerreng
+// som blir skalert inn i scenen og tilpasset med SurfaceFit, med minste kvadrater eller med multilevel.
+// Kontrollnettet blir lagret som filename + ".net", s tilpasningen kan hoppes over neste gang
+bool loadSurface(const std::string& filename, bool multilevel, BSplineSurface& surface)
+{
+	if (filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".net") == 0)
+		return surface.LoadControlNet(filename);
+
+	std::vector<glm::vec3> points;
+	if (!SurfaceFit::LoadPoints(filename, points))
+		return false;
+	fitToScene(points);
+
+	// Omtrent 16 punkter per kontrollpunkt, og aldri mer enn 64 x 64 kontrollpunkter. Multilevel dobler rutene
+	// for hvert niv, s den korteste siden fr hyst side - 3 ruter
+	int side = std::clamp(static_cast<int>(std::sqrt(points.size() / 16.0)), 4, 64);
+	SurfaceFitResult result;
+	if (multilevel)
+	{
+		int levels = 1 + static_cast<int>(std::log2(side - 3));
+		if (!SurfaceFit::FitMultilevel(points, levels, surface, &result))
+			return false;
+	}
+	else if (!SurfaceFit::FitHeightField(points, side, side, 3, 3, 0.05f, surface, &result))
+		return false;
+	std::cout << "Flaten er tilpasset " << points.size() << " punkter med " << surface.GetUSize() << " x " << surface.GetVSize()
+		<< " kontrollpunkter, RMS-avvik " << result.rmsError << ", strste avvik " << result.maxError << std::endl;
+
+	surface.SaveControlNet(filename + ".net");
+	return true;
+}
+
+// Veggene blir lagt like innenfor kanten av flaten slik den er tegnet. Flatene er hydefelt over et rektangel,
+// s hjrnene av parameteromrdet gir kanten (kontrollnettet fra FitMultilevel gr litt utenfor flaten)
+void setWalls(const BSplineSurface& surface, const glm::mat4& model)
+{
+	glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+	float us[2] = { surface.GetUMin(), surface.GetUMax() };
+	float vs[2] = { surface.GetVMin(), surface.GetVMax() };
+	for (float u : us)
+	{
+		for (float v : vs)
+		{
+			glm::vec3 position = glm::vec3(model * glm::vec4(surface.EvaluateSurface(u, v), 1.0f));
+			min = glm::min(min, position);
+			max = glm::max(max, position);
+		}
+	}
+	minX = min.x + 0.05f;
+	maxX = max.x - 0.05f;
+	minZ = min.z + 0.05f;
+	maxZ = max.z - 0.05f;
+}
+
+// Tar tiden p EvaluateDerivatives over et rutenett med og uten evaluatorene for faste grader, og skriver ut
+// tidene og det strste avviket mellom dem. Flaten bruker evaluatorene igjen etterp
+void benchmarkEvaluation(BSplineSurface& surface)
+{
+	const int resolution = 512;
+	std::vector<glm::vec3> positions[2];
+	double milliseconds[2];
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		surface.SetSpecializedEvaluation(pass == 0);
+		positions[pass].resize(static_cast<size_t>(resolution) * resolution);
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < resolution; ++i)
+		{
+			float u = surface.GetUMin() + (surface.GetUMax() - surface.GetUMin()) * i / (resolution - 1);
+			for (int j = 0; j < resolution; ++j)
+			{
+				float v = surface.GetVMin() + (surface.GetVMax() - surface.GetVMin()) * j / (resolution - 1);
+				SurfaceSample sample = surface.EvaluateDerivatives(u, v);
+				positions[pass][i * resolution + j] = sample.position + sample.du + sample.dv;
+			}
+		}
+		milliseconds[pass] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+	surface.SetSpecializedEvaluation(true);
+
+	float maxDifference = 0.0f;
+	for (size_t n = 0; n < positions[0].size(); ++n)
+		maxDifference = std::max(maxDifference, glm::length(positions[0][n] - positions[1][n]));
+	std::cout << resolution * resolution << " evalueringer av grad " << surface.GetUDegree() << " x " << surface.GetVDegree()
+		<< ": faste grader " << milliseconds[0] << " ms, generell " << milliseconds[1] << " ms, strste avvik " << maxDifference << std::endl;
+}
 
 glm::vec3 input(float minX, float maxX, float minZ, float maxZ, float radius) {
 	glm::vec3 position;
@@ -60,7 +173,7 @@ glm::vec3 input(float minX, float maxX, float minZ, float maxZ, float radius) {
 	return position;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
 	glfwInit();
 
@@ -88,9 +201,18 @@ int main()
 
 	Shader shaderProgram("default.vert", "default.frag");
 
-	// Flaten
+	// Flaten. Uten argument er det standardflaten med z opp, tegnet rotert fra (x, y, z) til (x, z, -y).
+	// Med en punktfil fra 3DTerreng (tasten E der) eller en .net-fil blir flaten lest med loadSurface,
+	// og med "multilevel" etter punktfilen blir den tilpasset med FitMultilevel.
+	// De flatene har y opp og ligger allerede i scenen, s model blir identiteten
 	BSplineSurface bsplineSurface;
-	bsplineSurface.GenerateSurface(30, 30);
+	glm::mat4 model = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(0.5f, 0.0f, 0.0f));
+	if (argc > 1 && loadSurface(argv[1], argc > 2 && std::string(argv[2]) == "multilevel", bsplineSurface))
+		model = glm::mat4(1.0f);
+	glm::mat4 inverseModel = glm::inverse(model); // For strlen fra kameraet til P
+	bsplineSurface.GenerateAdaptiveSurface(0.01f); // Flere trekanter der flaten krummer, maks 0.01 avvik
+	setWalls(bsplineSurface, model);
+	bsplineSurface.BakeHeightField(256, 256, model); // (u, v) under hvert punkt i scenen, med y opp ogs for standardflaten
 
 	// Ball
 	Ball ball1(ballRadius, 36, 18, glm::vec3(0.8f, 0.0f, 0.0f)); // Rd
@@ -112,6 +234,13 @@ int main()
 	ball2.velocity = glm::vec3(0.3f, 0.0f, -0.4f);
 	ball3.velocity = glm::vec3(-0.2f, 0.0f, 0.1f); 
 
+	// Nrmeste punkt p flaten for hver ball, og startverdien for neste bilde. Det frste bildet starter fra (u, v)
+	// rett under ballen i det bakte feltet, s gitteret i ProjectPoints bare trengs der feltet ikke har en verdi
+	Ball* balls[3] = { &ball1, &ball2, &ball3 };
+	SurfaceProjection contacts[3];
+	for (int n = 0; n < 3; ++n)
+		contacts[n].parameter = bsplineSurface.GetBakedHeightField().ParameterAt(balls[n]->position.x, balls[n]->position.z);
+
 	glPointSize(5.0f);
 
 	glEnable(GL_DEPTH_TEST);
@@ -128,19 +257,34 @@ int main()
 
 		// Ball bevegelse og kollisjon for at ballene ikke gr utenfor flaten.
 		ball1.position += ball1.velocity * deltaTime * speedFactor;
-		Collision::checkWallCollision(ball1.position, ball1.velocity, 0.05f, 2.95f, -1.95f, -0.05f, ballRadius);
+		Collision::checkWallCollision(ball1.position, ball1.velocity, minX, maxX, minZ, maxZ, ballRadius);
 	
 		ball2.position += ball2.velocity * deltaTime * speedFactor;
-		Collision::checkWallCollision(ball2.position, ball2.velocity, 0.05f, 2.95f, -1.95f, -0.05f, ballRadius);
+		Collision::checkWallCollision(ball2.position, ball2.velocity, minX, maxX, minZ, maxZ, ballRadius);
 
 		ball3.position += ball3.velocity * deltaTime * speedFactor;
-		Collision::checkWallCollision(ball3.position, ball3.velocity, 0.05f, 2.95f, -1.95f, -0.05f, ballRadius);
+		Collision::checkWallCollision(ball3.position, ball3.velocity, minX, maxX, minZ, maxZ, ballRadius);
 
 		// Ball-til-ball kollisjon
 		Collision::responseBallCollision(ball1.position, ball2.position, ball1.velocity, ball2.velocity, ballRadius);
 		Collision::responseBallCollision(ball1.position, ball3.position, ball1.velocity, ball3.velocity, ballRadius);
 		Collision::responseBallCollision(ball2.position, ball3.position, ball2.velocity, ball3.velocity, ballRadius);
 
+		// Ballene ligger p flaten. Sentrene blir gjort om til flatens koordinater med model fr nrmeste punkt
+		// blir funnet, med forrige bildes (u, v) som startverdi. model er bare en rotasjon, s normalene blir rotert likt
+		glm::vec3 centers[3];
+		for (int n = 0; n < 3; ++n)
+		{
+			centers[n] = glm::vec3(inverseModel * glm::vec4(balls[n]->position, 1.0f));
+		}
+		bsplineSurface.ProjectPoints(centers, 3, contacts, true);
+		for (int n = 0; n < 3; ++n)
+		{
+			glm::vec3 point = glm::vec3(model * glm::vec4(contacts[n].position, 1.0f));
+			glm::vec3 normal = glm::mat3(model) * contacts[n].normal;
+			Collision::responseSurfaceContact(balls[n]->position, balls[n]->velocity, point, normal, ballRadius);
+		}
+
 		// Render
 		glClearColor(0.5f, 0.3f, 0.8f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -159,10 +303,25 @@ int main()
 		glm::mat4 view = camera.GetViewMatrix();
 		shaderProgram.setMat4("view", view);
 
-		glm::mat4 model = glm::mat4(1.0f);
-		model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.5f, 0.0f, 0.0f)); 
-		model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f)); 
 		shaderProgram.setMat4("model", model);
+
+		// P skriver ut punktet p flaten midt p skjermen. Strlen fra kameraet blir gjort om til flatens koordinater
+		bool pickKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+		if (pickKey && !pickKeyPressed)
+		{
+			SurfaceHit hit;
+			if (bsplineSurface.IntersectRay(glm::vec3(inverseModel * glm::vec4(camera.Position, 1.0f)), glm::vec3(inverseModel * glm::vec4(camera.Front, 0.0f)), hit))
+				std::cout << "Punkt p flaten: (u, v) = (" << hit.parameter.x << ", " << hit.parameter.y << "), " << hit.position.x << ", " << hit.position.y << ", " << hit.position.z << std::endl;
+			else
+				std::cout << "Ingen treff p flaten" << std::endl;
+		}
+		pickKeyPressed = pickKey;
+
+		// B sammenligner evaluatorene for faste grader med de generelle lkkene p denne flaten
+		bool benchmarkKey = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
+		if (benchmarkKey && !benchmarkKeyPressed)
+			benchmarkEvaluation(bsplineSurface);
+		benchmarkKeyPressed = benchmarkKey;
 	
 		// BSplineSurface
 		bsplineSurface.DrawBSpline(shaderProgram);
@@ -0,0 +1,51 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+// Antall trder maskinen har, minst 1
+inline unsigned int threadCount()
+{
+    unsigned int count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+// Deler [0, count) i chunks like store biter og kjrer func(begin, end, chunkIndex) for hver bit p sin egen trd.
+// Den frste biten kjres p trden som kaller, og funksjonen returnerer nr alle bitene er ferdige.
+template <typename Func>
+void parallelFor(size_t count, unsigned int chunks, Func func)
+{
+    if (chunks == 0 || count == 0)
+    {
+        return;
+    }
+
+    chunks = static_cast<unsigned int>(std::min<size_t>(chunks, count));
+
+    std::vector<std::thread> threads;
+    threads.reserve(chunks - 1);
+    for (unsigned int c = 1; c < chunks; ++c)
+    {
+        size_t begin = count * c / chunks;
+        size_t end = count * (c + 1) / chunks;
+        threads.emplace_back(func, begin, end, c);
+    }
+
+    func(size_t(0), count / chunks, 0u);
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+// Samme som over, med n bit per trd
+template <typename Func>
+void parallelFor(size_t count, Func func)
+{
+    parallelFor(count, threadCount(), func);
+}
+
+#endif // !PARALLEL_H
@@ -0,0 +1,658 @@
+#include "SurfaceFit.h"
+#include "Parallel.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+
+// Symmetrisk bndmatrise for kontrollnettet: rad n = j * uSize + i har bare naboer (i + di, j + dj) med
+// |di| <= uReach og |dj| <= vReach, lagret i en fast stencil per rad
+struct StencilMatrix
+{
+    int uSize, vSize;
+    int uReach, vReach;
+    int width; // (2 uReach + 1) * (2 vReach + 1)
+    std::vector<double> values;
+
+    double& at(size_t row, int di, int dj)
+    {
+        return values[row * width + (dj + vReach) * (2 * uReach + 1) + di + uReach];
+    }
+
+    // output = A x, i parallell over radene
+    void multiply(const std::vector<double>& x, std::vector<double>& output) const
+    {
+        parallelFor(output.size(), [&](size_t begin, size_t end, unsigned int)
+        {
+            for (size_t row = begin; row < end; ++row)
+            {
+                int i = static_cast<int>(row % uSize);
+                int j = static_cast<int>(row / uSize);
+                const double* stencil = &values[row * width];
+                double sum = 0.0;
+                for (int dj = std::max(-vReach, -j); dj <= std::min(vReach, vSize - 1 - j); ++dj)
+                {
+                    const double* line = stencil + (dj + vReach) * (2 * uReach + 1) + uReach;
+                    size_t column = static_cast<size_t>(j + dj) * uSize + i;
+                    for (int di = std::max(-uReach, -i); di <= std::min(uReach, uSize - 1 - i); ++di)
+                    {
+                        sum += line[di] * x[column + di];
+                    }
+                }
+                output[row] = sum;
+            }
+        });
+    }
+};
+
+static double parallelDot(const std::vector<double>& a, const std::vector<double>& b)
+{
+    std::vector<double> partial(threadCount(), 0.0);
+    parallelFor(a.size(), static_cast<unsigned int>(partial.size()), [&](size_t begin, size_t end, unsigned int chunk)
+    {
+        double sum = 0.0;
+        for (size_t n = begin; n < end; ++n)
+        {
+            sum += a[n] * b[n];
+        }
+        partial[chunk] = sum;
+    });
+
+    double sum = 0.0;
+    for (double value : partial)
+    {
+        sum += value;
+    }
+    return sum;
+}
+
+// Greville-punktene (snittet av degree skjteverdier) er der en B-spline med linere kontrollpunkter er liner,
+// s x og z p flaten blir nyaktig en skalering av u og v
+static std::vector<float> grevilleAbscissae(const std::vector<float>& knots, int controlCount, int degree)
+{
+    std::vector<float> abscissae(controlCount);
+    for (int i = 0; i < controlCount; ++i)
+    {
+        float sum = 0.0f;
+        for (int k = 1; k <= degree; ++k)
+        {
+            sum += knots[i + k];
+        }
+        abscissae[i] = sum / degree;
+    }
+    return abscissae;
+}
+
+bool SurfaceFit::LoadPoints(const std::string& filename, std::vector<glm::vec3>& points)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return false;
+    }
+
+    size_t count = 0;
+    if (!(file >> count))
+    {
+        std::cerr << "Error: Missing point count in " << filename << std::endl;
+        return false;
+    }
+
+    points.clear();
+    points.reserve(count);
+    glm::vec3 point;
+    while (points.size() < count && file >> point.x >> point.z >> point.y)
+    {
+        points.push_back(point);
+    }
+    if (points.size() < count)
+    {
+        std::cerr << "Error: Expected " << count << " points in " << filename << ", found " << points.size() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SurfaceFit::FitHeightField(const std::vector<glm::vec3>& points, int uSize, int vSize, int uDegree, int vDegree,
+    float smoothness, BSplineSurface& surface, SurfaceFitResult* result, int maxIterations, float tolerance)
+{
+    if (points.empty())
+    {
+        std::cerr << "Error: No points to fit a surface to" << std::endl;
+        return false;
+    }
+    if (uDegree < 1 || vDegree < 1 || uDegree > BSplineSurface::MaxDegree || vDegree > BSplineSurface::MaxDegree
+        || uSize <= uDegree || vSize <= vDegree)
+    {
+        std::cerr << "Error: Need at least degree + 1 control points in each direction" << std::endl;
+        return false;
+    }
+
+    glm::vec3 minimum = points[0], maximum = points[0];
+    double heightSum = 0.0;
+    for (const glm::vec3& point : points)
+    {
+        minimum = glm::min(minimum, point);
+        maximum = glm::max(maximum, point);
+        heightSum += point.y;
+    }
+    if (maximum.x <= minimum.x || maximum.z <= minimum.z)
+    {
+        std::cerr << "Error: The points must span an area in x and z" << std::endl;
+        return false;
+    }
+    double meanHeight = heightSum / points.size();
+
+    std::vector<float> uKnots = BSplineSurface::ClampedKnots(uSize, uDegree);
+    std::vector<float> vKnots = BSplineSurface::ClampedKnots(vSize, vDegree);
+    auto parameterU = [&](const glm::vec3& point) { return glm::clamp((point.z - minimum.z) / (maximum.z - minimum.z), 0.0f, 1.0f); };
+    auto parameterV = [&](const glm::vec3& point) { return glm::clamp((point.x - minimum.x) / (maximum.x - minimum.x), 0.0f, 1.0f); };
+
+    // Andredifferansene i glattingen trenger to naboer, selv for grad 1
+    size_t controlCount = static_cast<size_t>(uSize) * vSize;
+    StencilMatrix matrix;
+    matrix.uSize = uSize;
+    matrix.vSize = vSize;
+    matrix.uReach = std::max(uDegree, 2);
+    matrix.vReach = std::max(vDegree, 2);
+    matrix.width = (2 * matrix.uReach + 1) * (2 * matrix.vReach + 1);
+    matrix.values.assign(controlCount * matrix.width, 0.0);
+    std::vector<double> rhs(controlCount, 0.0);
+
+    // Punktene sortert etter span i v. Et punkt i span s pvirker radene s - vDegree til s i nettet, s spans som
+    // ligger vDegree + 1 fra hverandre kan legges til samtidig uten  skrive til de samme radene
+    int vSpans = vSize - vDegree;
+    std::vector<size_t> spanStart(vSpans + 1, 0);
+    std::vector<int> pointSpan(points.size());
+    for (size_t n = 0; n < points.size(); ++n)
+    {
+        pointSpan[n] = surface.FindKnotSpan(vDegree, vSize, parameterV(points[n]), vKnots) - vDegree;
+        ++spanStart[pointSpan[n] + 1];
+    }
+    for (int s = 0; s < vSpans; ++s)
+    {
+        spanStart[s + 1] += spanStart[s];
+    }
+    std::vector<size_t> order(points.size());
+    std::vector<size_t> fill(spanStart.begin(), spanStart.end() - 1);
+    for (size_t n = 0; n < points.size(); ++n)
+    {
+        order[fill[pointSpan[n]]++] = n;
+    }
+
+    // Plassen i stencilen for hvert par av de (uDegree + 1) x (vDegree + 1) basisfunksjonene til et punkt
+    int uCount = uDegree + 1;
+    int vCount = vDegree + 1;
+    int pairCount = uCount * vCount;
+    std::vector<int> pairOffsets(static_cast<size_t>(pairCount) * pairCount);
+    for (int a = 0; a < pairCount; ++a)
+    {
+        for (int b = 0; b < pairCount; ++b)
+        {
+            int di = b % uCount - a % uCount;
+            int dj = b / uCount - a / uCount;
+            pairOffsets[a * pairCount + b] = (dj + matrix.vReach) * (2 * matrix.uReach + 1) + di + matrix.uReach;
+        }
+    }
+
+    for (int color = 0; color < vCount; ++color)
+    {
+        std::vector<int> spans;
+        for (int s = color; s < vSpans; s += vCount)
+        {
+            spans.push_back(s);
+        }
+
+        parallelFor(spans.size(), [&](size_t begin, size_t end, unsigned int)
+        {
+            std::vector<double> coefficients(static_cast<size_t>(uCount) * vCount);
+            std::vector<size_t> rows(coefficients.size());
+            for (size_t s = begin; s < end; ++s)
+            {
+                for (size_t k = spanStart[spans[s]]; k < spanStart[spans[s] + 1]; ++k)
+                {
+                    const glm::vec3& point = points[order[k]];
+                    float u = parameterU(point);
+                    float v = parameterV(point);
+                    int uSpan = surface.FindKnotSpan(uDegree, uSize, u, uKnots);
+                    int vSpan = surface.FindKnotSpan(vDegree, vSize, v, vKnots);
+                    float Bu[BSplineSurface::MaxDegree + 1];
+                    float Bv[BSplineSurface::MaxDegree + 1];
+                    surface.BasisFunctions(uSpan, uDegree, u, uKnots, Bu);
+                    surface.BasisFunctions(vSpan, vDegree, v, vKnots, Bv);
+
+                    for (int l = 0; l < vCount; ++l)
+                    {
+                        for (int c = 0; c < uCount; ++c)
+                        {
+                            coefficients[l * uCount + c] = static_cast<double>(Bu[c]) * Bv[l];
+                            rows[l * uCount + c] = static_cast<size_t>(vSpan - vDegree + l) * uSize + uSpan - uDegree + c;
+                        }
+                    }
+
+                    for (int a = 0; a < pairCount; ++a)
+                    {
+                        rhs[rows[a]] += coefficients[a] * point.y;
+                        double* stencil = &matrix.values[rows[a] * matrix.width];
+                        const int* offsets = &pairOffsets[a * pairCount];
+                        for (int b = 0; b < pairCount; ++b)
+                        {
+                            stencil[offsets[b]] += coefficients[a] * coefficients[b];
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    // Glatting: summen av andredifferansene i u og v i annen, pluss to ganger den blandede
+    double lambda = static_cast<double>(smoothness) * points.size() / controlCount;
+    auto addTerm = [&](const int (*offsets)[2], const double* weights, int count, int i, int j, double scale)
+    {
+        for (int a = 0; a < count; ++a)
+        {
+            size_t row = static_cast<size_t>(j + offsets[a][1]) * uSize + i + offsets[a][0];
+            for (int b = 0; b < count; ++b)
+            {
+                matrix.at(row, offsets[b][0] - offsets[a][0], offsets[b][1] - offsets[a][1]) += scale * weights[a] * weights[b];
+            }
+        }
+    };
+    const int uOffsets[3][2] = { { -1, 0 }, { 0, 0 }, { 1, 0 } };
+    const int vOffsets[3][2] = { { 0, -1 }, { 0, 0 }, { 0, 1 } };
+    const int mixedOffsets[4][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
+    const double secondWeights[3] = { 1.0, -2.0, 1.0 };
+    const double mixedWeights[4] = { 1.0, -1.0, -1.0, 1.0 };
+    if (lambda > 0.0)
+    {
+        for (int j = 0; j < vSize; ++j)
+        {
+            for (int i = 0; i < uSize; ++i)
+            {
+                if (i > 0 && i < uSize - 1)
+                {
+                    addTerm(uOffsets, secondWeights, 3, i, j, lambda);
+                }
+                if (j > 0 && j < vSize - 1)
+                {
+                    addTerm(vOffsets, secondWeights, 3, i, j, lambda);
+                }
+                if (i < uSize - 1 && j < vSize - 1)
+                {
+                    addTerm(mixedOffsets, mixedWeights, 4, i, j, 2.0 * lambda);
+                }
+            }
+        }
+    }
+
+    // Et lite ledd mot snitthyden gjr systemet positivt definitt ogs uten glatting og med tomme omrder
+    std::vector<double> diagonal(controlCount);
+    double diagonalSum = 0.0;
+    for (size_t n = 0; n < controlCount; ++n)
+    {
+        diagonalSum += matrix.at(n, 0, 0);
+    }
+    double ridge = std::max(diagonalSum / controlCount, 1.0) * 1e-8;
+    for (size_t n = 0; n < controlCount; ++n)
+    {
+        matrix.at(n, 0, 0) += ridge;
+        rhs[n] += ridge * meanHeight;
+        diagonal[n] = matrix.at(n, 0, 0);
+    }
+
+    // Konjugerte gradienter med diagonalen som prekondisjonering, fra snitthyden
+    std::vector<double> heights(controlCount, meanHeight);
+    std::vector<double> residual(controlCount), preconditioned(controlCount), direction(controlCount), product(controlCount);
+    matrix.multiply(heights, product);
+    for (size_t n = 0; n < controlCount; ++n)
+    {
+        residual[n] = rhs[n] - product[n];
+        preconditioned[n] = residual[n] / diagonal[n];
+    }
+    direction = preconditioned;
+    double rz = parallelDot(residual, preconditioned);
+    double rhsNorm = std::max(std::sqrt(parallelDot(rhs, rhs)), 1e-30);
+    double residualNorm = std::sqrt(parallelDot(residual, residual));
+
+    int iteration = 0;
+    while (iteration < maxIterations && residualNorm > tolerance * rhsNorm)
+    {
+        matrix.multiply(direction, product);
+        double alpha = rz / parallelDot(direction, product);
+        parallelFor(controlCount, [&](size_t begin, size_t end, unsigned int)
+        {
+            for (size_t n = begin; n < end; ++n)
+            {
+                heights[n] += alpha * direction[n];
+                residual[n] -= alpha * product[n];
+                preconditioned[n] = residual[n] / diagonal[n];
+            }
+        });
+        ++iteration;
+
+        double rzNext = parallelDot(residual, preconditioned);
+        double beta = rzNext / rz;
+        rz = rzNext;
+        for (size_t n = 0; n < controlCount; ++n)
+        {
+            direction[n] = preconditioned[n] + beta * direction[n];
+        }
+        residualNorm = std::sqrt(parallelDot(residual, residual));
+    }
+
+    // Kontrollpunktene str over Greville-punktene, med x langs v og z langs u
+    std::vector<float> uAbscissae = grevilleAbscissae(uKnots, uSize, uDegree);
+    std::vector<float> vAbscissae = grevilleAbscissae(vKnots, vSize, vDegree);
+    std::vector<glm::vec3> net(controlCount);
+    for (int j = 0; j < vSize; ++j)
+    {
+        for (int i = 0; i < uSize; ++i)
+        {
+            size_t n = static_cast<size_t>(j) * uSize + i;
+            net[n] = glm::vec3(minimum.x + vAbscissae[j] * (maximum.x - minimum.x), static_cast<float>(heights[n]),
+                minimum.z + uAbscissae[i] * (maximum.z - minimum.z));
+        }
+    }
+    if (!surface.SetControlNet(uSize, vSize, uDegree, vDegree, net, uKnots, vKnots))
+    {
+        return false;
+    }
+
+    if (result != nullptr)
+    {
+        std::vector<double> squared(threadCount(), 0.0);
+        std::vector<double> largest(squared.size(), 0.0);
+        parallelFor(points.size(), static_cast<unsigned int>(squared.size()), [&](size_t begin, size_t end, unsigned int chunk)
+        {
+            for (size_t n = begin; n < end; ++n)
+            {
+                double error = std::abs(surface.EvaluateSurface(parameterU(points[n]), parameterV(points[n])).y - points[n].y);
+                squared[chunk] += error * error;
+                largest[chunk] = std::max(largest[chunk], error);
+            }
+        });
+
+        double squaredSum = 0.0;
+        result->maxError = 0.0f;
+        for (size_t c = 0; c < squared.size(); ++c)
+        {
+            squaredSum += squared[c];
+            result->maxError = std::max(result->maxError, static_cast<float>(largest[c]));
+        }
+        result->iterations = iteration;
+        result->residual = static_cast<float>(residualNorm / rhsNorm);
+        result->rmsError = static_cast<float>(std::sqrt(squaredSum / points.size()));
+    }
+    return true;
+}
+
+// De fire uniforme kubiske basisfunksjonene som ikke er null i en rute, for t fra 0 til 1
+static inline void cubicBasis(float t, float* basis)
+{
+    float t2 = t * t;
+    float t3 = t2 * t;
+    float inverse = 1.0f - t;
+    basis[0] = inverse * inverse * inverse / 6.0f;
+    basis[1] = (3.0f * t3 - 6.0f * t2 + 4.0f) / 6.0f;
+    basis[2] = (-3.0f * t3 + 3.0f * t2 + 3.0f * t + 1.0f) / 6.0f;
+    basis[3] = t3 / 6.0f;
+}
+
+// Uniformt bikubisk gitter over [0, 1] x [0, 1] med (uCells + 3) x (vCells + 3) kontrollpunkter, index = j * (uCells + 3) + i
+struct Lattice
+{
+    int uCells, vCells;
+    std::vector<double> values;
+
+    int rowLength() const
+    {
+        return uCells + 3;
+    }
+
+    // Raden av ruter som v ligger i
+    int row(float v) const
+    {
+        return std::min(static_cast<int>(v * vCells), vCells - 1);
+    }
+
+    // Indeksen til det frste av de 4 x 4 kontrollpunktene rundt (u, v), og basisfunksjonene der
+    size_t cell(float u, float v, float* Bu, float* Bv) const
+    {
+        float x = u * uCells;
+        float y = v * vCells;
+        int i = std::min(static_cast<int>(x), uCells - 1);
+        int j = row(v);
+        cubicBasis(x - i, Bu);
+        cubicBasis(y - j, Bv);
+        return static_cast<size_t>(j) * rowLength() + i;
+    }
+
+    double evaluate(float u, float v) const
+    {
+        float Bu[4], Bv[4];
+        const double* first = &values[cell(u, v, Bu, Bv)];
+        double sum = 0.0;
+        for (int l = 0; l < 4; ++l)
+        {
+            const double* row = first + static_cast<size_t>(l) * rowLength();
+            sum += Bv[l] * (Bu[0] * row[0] + Bu[1] * row[1] + Bu[2] * row[2] + Bu[3] * row[3]);
+        }
+        return sum;
+    }
+};
+
+// B-spline subdivisjon til dobbelt s mange ruter, samme flate. Langs hver akse blir de nye punktene
+// (a[i] + 6 a[i + 1] + a[i + 2]) / 8 og (a[i + 1] + a[i + 2]) / 2 av de gamle
+static Lattice refineLattice(const Lattice& coarse)
+{
+    auto refine = [](const double* input, size_t inputStride, int cells, double* output, size_t outputStride)
+    {
+        for (int K = 0; K <= 2 * cells + 2; ++K)
+        {
+            int i = K / 2;
+            output[K * outputStride] = (K & 1)
+                ? (input[(i) * inputStride] + 6.0 * input[(i + 1) * inputStride] + input[(i + 2) * inputStride]) / 8.0
+                : (input[i * inputStride] + input[(i + 1) * inputStride]) / 2.0;
+        }
+    };
+
+    Lattice fine;
+    fine.uCells = coarse.uCells * 2;
+    fine.vCells = coarse.vCells * 2;
+    fine.values.resize(static_cast<size_t>(fine.rowLength()) * (fine.vCells + 3));
+
+    // Frst langs u for hver gammel rad, s langs v for hver ny kolonne
+    std::vector<double> rows(static_cast<size_t>(fine.rowLength()) * (coarse.vCells + 3));
+    for (int j = 0; j < coarse.vCells + 3; ++j)
+    {
+        refine(&coarse.values[static_cast<size_t>(j) * coarse.rowLength()], 1, coarse.uCells, &rows[static_cast<size_t>(j) * fine.rowLength()], 1);
+    }
+    for (int i = 0; i < fine.rowLength(); ++i)
+    {
+        refine(&rows[i], fine.rowLength(), coarse.vCells, &fine.values[i], fine.rowLength());
+    }
+    return fine;
+}
+
+bool SurfaceFit::FitMultilevel(const std::vector<glm::vec3>& points, int levels, BSplineSurface& surface, SurfaceFitResult* result)
+{
+    if (points.empty())
+    {
+        std::cerr << "Error: No points to fit a surface to" << std::endl;
+        return false;
+    }
+    if (levels < 1 || levels > 12)
+    {
+        std::cerr << "Error: Multilevel fitting needs between 1 and 12 levels" << std::endl;
+        return false;
+    }
+
+    unsigned int chunks = threadCount();
+    std::vector<glm::vec3> chunkMinimum(chunks, points[0]), chunkMaximum(chunks, points[0]);
+    parallelFor(points.size(), chunks, [&](size_t begin, size_t end, unsigned int chunk)
+    {
+        for (size_t n = begin; n < end; ++n)
+        {
+            chunkMinimum[chunk] = glm::min(chunkMinimum[chunk], points[n]);
+            chunkMaximum[chunk] = glm::max(chunkMaximum[chunk], points[n]);
+        }
+    });
+    glm::vec3 minimum = points[0], maximum = points[0];
+    for (unsigned int c = 0; c < chunks; ++c)
+    {
+        minimum = glm::min(minimum, chunkMinimum[c]);
+        maximum = glm::max(maximum, chunkMaximum[c]);
+    }
+    if (maximum.x <= minimum.x || maximum.z <= minimum.z)
+    {
+        std::cerr << "Error: The points must span an area in x and z" << std::endl;
+        return false;
+    }
+
+    // u gr langs z og v langs x som i FitHeightField
+    float uExtent = maximum.z - minimum.z;
+    float vExtent = maximum.x - minimum.x;
+    auto parameterU = [&](const glm::vec3& point) { return glm::clamp((point.z - minimum.z) / uExtent, 0.0f, 1.0f); };
+    auto parameterV = [&](const glm::vec3& point) { return glm::clamp((point.x - minimum.x) / vExtent, 0.0f, 1.0f); };
+
+    Lattice lattice;
+    lattice.uCells = std::max(1, static_cast<int>(std::round(uExtent / std::min(uExtent, vExtent))));
+    lattice.vCells = std::max(1, static_cast<int>(std::round(vExtent / std::min(uExtent, vExtent))));
+    lattice.values.assign(static_cast<size_t>(lattice.rowLength()) * (lattice.vCells + 3), 0.0);
+
+    // Tellerne og nevnerne for hvert kontrollpunkt, delt av alle trdene. Et punkt i rad j av ruter pvirker radene
+    // j til j + 3 i gitteret, og bidraget til rad j + l blir lagt i lag l. Hver trd eier en stripe av rader med ruter
+    // og gr gjennom alle punktene, men bruker bare de som ligger i stripen. Da skriver bare n trd til hvert
+    // kontrollpunkt i hvert lag, i samme rekkeflge som punktene, s summene blir de samme uansett antall trder
+    std::vector<double> deltas, omegas;
+    for (int level = 0; level < levels; ++level)
+    {
+        if (level > 0)
+        {
+            lattice = refineLattice(lattice);
+        }
+
+        size_t size = lattice.values.size();
+        int rowLength = lattice.rowLength();
+        deltas.assign(4 * size, 0.0);
+        omegas.assign(4 * size, 0.0);
+        parallelFor(lattice.vCells, [&](size_t begin, size_t end, unsigned int)
+        {
+            for (const glm::vec3& point : points)
+            {
+                float v = parameterV(point);
+                size_t row = static_cast<size_t>(lattice.row(v));
+                if (row < begin || row >= end)
+                {
+                    continue;
+                }
+
+                float Bu[4], Bv[4];
+                size_t first = lattice.cell(parameterU(point), v, Bu, Bv);
+
+                double current = 0.0;
+                double squareSum = 0.0;
+                double weights[16];
+                for (int l = 0; l < 4; ++l)
+                {
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        double weight = static_cast<double>(Bu[k]) * Bv[l];
+                        weights[l * 4 + k] = weight;
+                        current += weight * lattice.values[first + static_cast<size_t>(l) * rowLength + k];
+                        squareSum += weight * weight;
+                    }
+                }
+
+                // Kontrollpunktene som lser punktet alene med minst mulig endring er weight * residual / squareSum.
+                // Forslaget blir vektet med weight^2 i snittet
+                double residual = point.y - current;
+                for (int l = 0; l < 4; ++l)
+                {
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        double weight = weights[l * 4 + k];
+                        size_t index = l * size + first + static_cast<size_t>(l) * rowLength + k;
+                        deltas[index] += weight * weight * weight * residual / squareSum;
+                        omegas[index] += weight * weight;
+                    }
+                }
+            }
+        });
+
+        parallelFor(size, [&](size_t begin, size_t end, unsigned int)
+        {
+            for (size_t index = begin; index < end; ++index)
+            {
+                double delta = 0.0, omega = 0.0;
+                for (int l = 0; l < 4; ++l)
+                {
+                    delta += deltas[l * size + index];
+                    omega += omegas[l * size + index];
+                }
+                if (omega > 0.0)
+                {
+                    lattice.values[index] += delta / omega;
+                }
+            }
+        });
+    }
+
+    // Et uniformt, uklemt knutepunkt-sett gir samme basisfunksjoner som gitteret, og Greville-punktene ligger
+    // midt over hvert kontrollpunkt
+    int uSize = lattice.uCells + 3;
+    int vSize = lattice.vCells + 3;
+    std::vector<float> uKnots(uSize + 4), vKnots(vSize + 4);
+    for (int k = 0; k < uSize + 4; ++k)
+    {
+        uKnots[k] = static_cast<float>(k - 3) / lattice.uCells;
+    }
+    for (int k = 0; k < vSize + 4; ++k)
+    {
+        vKnots[k] = static_cast<float>(k - 3) / lattice.vCells;
+    }
+    std::vector<float> uAbscissae = grevilleAbscissae(uKnots, uSize, 3);
+    std::vector<float> vAbscissae = grevilleAbscissae(vKnots, vSize, 3);
+    std::vector<glm::vec3> net(lattice.values.size());
+    for (int j = 0; j < vSize; ++j)
+    {
+        for (int i = 0; i < uSize; ++i)
+        {
+            size_t n = static_cast<size_t>(j) * uSize + i;
+            net[n] = glm::vec3(minimum.x + vAbscissae[j] * vExtent, static_cast<float>(lattice.values[n]), minimum.z + uAbscissae[i] * uExtent);
+        }
+    }
+    if (!surface.SetControlNet(uSize, vSize, 3, 3, net, uKnots, vKnots))
+    {
+        return false;
+    }
+
+    if (result != nullptr)
+    {
+        std::vector<double> squared(chunks, 0.0);
+        std::vector<double> largest(chunks, 0.0);
+        parallelFor(points.size(), chunks, [&](size_t begin, size_t end, unsigned int chunk)
+        {
+            for (size_t n = begin; n < end; ++n)
+            {
+                double error = std::abs(lattice.evaluate(parameterU(points[n]), parameterV(points[n])) - points[n].y);
+                squared[chunk] += error * error;
+                largest[chunk] = std::max(largest[chunk], error);
+            }
+        });
+
+        double squaredSum = 0.0;
+        result->maxError = 0.0f;
+        for (unsigned int c = 0; c < chunks; ++c)
+        {
+            squaredSum += squared[c];
+            result->maxError = std::max(result->maxError, static_cast<float>(largest[c]));
+        }
+        result->iterations = levels;
+        result->residual = 0.0f;
+        result->rmsError = static_cast<float>(std::sqrt(squaredSum / points.size()));
+    }
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef SURFACEFIT_H
+#define SURFACEFIT_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+
+#include "BSplineSurface.h"
+
+// Resultatet av en tilpasning
+struct SurfaceFitResult
+{
+    int iterations; // Antall CG-iterasjoner, eller antall niver for FitMultilevel
+    float residual; // |b - Ax| / |b| etter siste iterasjon, 0 for FitMultilevel
+    float rmsError; // Hydeavvik mellom punktene og flaten
+    float maxError;
+};
+
+// Minste kvadraters tilpasning av en B-spline flate til en punktsky med y opp, som PunktSky::GetPoints().
+// Flaten blir et hydefelt: kontrollpunktene str i et jevnt rutenett over boksen til punktene i x og z
+// (u gr langs z og v langs x, s du x dv peker opp), og bare hydene blir lst for.
+// Normallikningene (B^T B + smoothness * R) h = B^T y er glisne, hver rad har bare naboer innenfor graden,
+// og blir satt sammen i parallell fr de blir lst med konjugerte gradienter og Jacobi-prekondisjonering.
+// R straffer andrederivatene til kontrollnettet, s flaten blir glatt og kontrollpunkter uten data fr en verdi
+class SurfaceFit
+{
+public:
+    // Leser punkter i tekstformatet til 3DTerreng (antall p frste linje, s "x z y" per linje), som
+    // PunktSky::ExportPoints skriver. Punktene fr y opp, klare for tilpasningene under
+    static bool LoadPoints(const std::string& filename, std::vector<glm::vec3>& points);
+
+    // uSize x vSize kontrollpunkter med grad uDegree og vDegree. smoothness er relativ til hvor mange punkter
+    // hvert kontrollpunkt har i snitt, s samme verdi gir omtrent samme glatthet for alle punktskyer
+    static bool FitHeightField(const std::vector<glm::vec3>& points, int uSize, int vSize, int uDegree, int vDegree,
+        float smoothness, BSplineSurface& surface, SurfaceFitResult* result = nullptr,
+        int maxIterations = 1000, float tolerance = 1e-6f);
+
+    // Multilevel B-spline approximation (Lee, Wolberg og Shin 1997). Hvert niv er et uniformt bikubisk gitter
+    // med dobbelt s mange ruter som det forrige. Hvert punkt foreslr verdier for de 16 kontrollpunktene rundt
+    // seg som akkurat treffer restavviket, og kontrollpunktene blir snittet av forslagene vektet med basisfunksjonene.
+    // Gitteret blir s delt til neste niv med B-spline subdivisjon og lagt sammen, s resultatet er n C2-flate.
+    // Restavviket blir regnet ut fra gitteret for hvert punkt. Hver trd eier en stripe av rader i gitteret og tar
+    // punktene som ligger der, s alle trdene deler ett sett tellere og nevnere: minnet er ni double per
+    // kontrollpunkt, uansett antall punkter og trder.
+    // Det frste nivet har n rute langs den korteste siden
+    static bool FitMultilevel(const std::vector<glm::vec3>& points, int levels, BSplineSurface& surface,
+        SurfaceFitResult* result = nullptr);
+};
+
+#endif // !SURFACEFIT_H